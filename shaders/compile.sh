@@ -1,2 +1,5 @@
 glslc shader.vert -o vert.spv
-glslc shader.frag -o frag.spv
\ No newline at end of file
+glslc shader.frag -o frag.spv
+glslc cull.comp -o cull.spv
+glslc hiz.comp -o hiz.spv
+glslc shader_bindless.vert -o vert_bindless.spv
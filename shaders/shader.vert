@@ -1,20 +1,36 @@
 #version 450
 
-layout(location = 0) out vec3 fragColor;
+layout(location = 0) in vec2 inPosition;
+layout(location = 1) in vec3 inColor;
+layout(location = 2) in vec3 inOffset;
+layout(location = 3) in float inScale;
+
+//Per frame, from the uniform ring at a dynamic offset
+layout(set = 0, binding = 0) uniform FrameData
+{
+    float time;
+    float pulse;
+} frame;
 
-vec2 positions[3] = vec2[](
-    vec2(0.0, -0.5),
-    vec2(0.5, 0.5),
-    vec2(-0.5, 0.5)
-);
+//The draw group's palette, a descriptor set per palette. shader_bindless.vert indexes them instead.
+layout(std430, set = 1, binding = 0) readonly buffer Palette
+{
+    vec4 colors[];
+} palette;
 
-vec3 colors[3] = vec3[](
-    vec3(1.0, 0.0, 0.0),
-    vec3(0.0, 1.0, 0.0),
-    vec3(0.0, 0.0, 1.0)
-);
+//Per draw group
+layout(push_constant) uniform DrawData
+{
+    float phase;
+    uint palette;
+} draw;
+
+layout(location = 0) out vec3 fragColor;
 
 void main() {
-    gl_Position = vec4(positions[gl_VertexIndex], 0.0, 1.0);
-    fragColor = colors[gl_VertexIndex];
-}
\ No newline at end of file
+    gl_Position = vec4(inPosition * inScale + inOffset.xy, inOffset.z, 1.0);
+    //A brightness wave across the grid, shifted for every draw group
+    float wave = 0.5 + 0.5 * sin(frame.time * 2.0 + inOffset.x * 4.0 + draw.phase);
+    vec3 tint = palette.colors[gl_InstanceIndex % palette.colors.length()].rgb;
+    fragColor = inColor * tint * (1.0 - frame.pulse * wave);
+}
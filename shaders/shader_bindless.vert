@@ -0,0 +1,37 @@
+#version 450
+#extension GL_EXT_nonuniform_qualifier : require
+
+layout(location = 0) in vec2 inPosition;
+layout(location = 1) in vec3 inColor;
+layout(location = 2) in vec3 inOffset;
+layout(location = 3) in float inScale;
+
+//Per frame, from the uniform ring at a dynamic offset
+layout(set = 0, binding = 0) uniform FrameData
+{
+    float time;
+    float pulse;
+} frame;
+
+//Every buffer in the bindless heap, palettes are picked by the slot in DrawData
+layout(std430, set = 1, binding = 1) readonly buffer Palette
+{
+    vec4 colors[];
+} buffers[];
+
+//Per draw group
+layout(push_constant) uniform DrawData
+{
+    float phase;
+    uint palette;
+} draw;
+
+layout(location = 0) out vec3 fragColor;
+
+void main() {
+    gl_Position = vec4(inPosition * inScale + inOffset.xy, inOffset.z, 1.0);
+    //A brightness wave across the grid, shifted for every draw group
+    float wave = 0.5 + 0.5 * sin(frame.time * 2.0 + inOffset.x * 4.0 + draw.phase);
+    vec3 tint = buffers[draw.palette].colors[gl_InstanceIndex % buffers[draw.palette].colors.length()].rgb;
+    fragColor = inColor * tint * (1.0 - frame.pulse * wave);
+}
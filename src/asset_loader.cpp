@@ -0,0 +1,207 @@
+#include "asset_loader.h"
+
+#include <iostream>
+#include <algorithm>
+#include <cstring>
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+AssetLoader::AssetLoader()
+{
+    stats = {};
+    archive = {};
+    archive_entries = nullptr;
+    archive_entry_count = 0;
+    loose_files = {};
+}
+
+AssetLoader::~AssetLoader()
+{
+    destroy();
+}
+
+bool AssetLoader::mountArchive(const std::string& path)
+{
+    MappedFile file = {};
+    if(!mapFile(path, &file))
+    {
+        return false;
+    }
+
+    //Check every offset once here, so lookups can trust the table of contents
+    ArchiveHeader header = {};
+    bool valid = file.size >= sizeof(header);
+    if(valid)
+    {
+        memcpy(&header, file.data, sizeof(header));
+        valid = memcmp(header.magic, "VKPK", 4) == 0 && header.version == archive_version
+            && header.toc_offset % alignof(ArchiveEntry) == 0 && header.toc_offset <= file.size
+            && (file.size - header.toc_offset) / sizeof(ArchiveEntry) >= header.entry_count;
+    }
+    const ArchiveEntry* entries = valid ? reinterpret_cast<const ArchiveEntry*>(file.data + header.toc_offset) : nullptr;
+    for(uint32_t i = 0; valid && i < header.entry_count; i++)
+    {
+        valid = entries[i].name[sizeof(entries[i].name) - 1] == '\0'
+            && entries[i].offset % archive_alignment == 0
+            && entries[i].offset <= header.toc_offset && entries[i].size <= header.toc_offset - entries[i].offset
+            && (i == 0 || strcmp(entries[i - 1].name, entries[i].name) < 0);
+    }
+    if(!valid)
+    {
+        std::cout << "Asset archive " << path << " is corrupt or from another version!" << std::endl;
+        unmapFile(file);
+        return false;
+    }
+
+    if(archive.data != nullptr)
+    {
+        unmapFile(archive);
+    }
+    archive = file;
+    archive_entries = entries;
+    archive_entry_count = header.entry_count;
+    return true;
+}
+
+bool AssetLoader::load(const std::string& name, AssetSpan* span)
+{
+    *span = {};
+    const ArchiveEntry* entry = findEntry(name);
+    if(entry != nullptr)
+    {
+        span->data = archive.data + entry->offset;
+        span->size = static_cast<size_t>(entry->size);
+        stats.archive_loads++;
+        return true;
+    }
+
+    auto found = loose_files.find(name);
+    if(found == loose_files.end())
+    {
+        MappedFile file = {};
+        if(!mapFile(name, &file))
+        {
+            return false;
+        }
+        found = loose_files.emplace(name, file).first;
+    }
+    span->data = found->second.data;
+    span->size = found->second.size;
+    stats.loose_loads++;
+    return true;
+}
+
+void AssetLoader::destroy()
+{
+    for(auto& loose_file : loose_files)
+    {
+        unmapFile(loose_file.second);
+    }
+    loose_files.clear();
+    if(archive.data != nullptr)
+    {
+        unmapFile(archive);
+    }
+    archive = {};
+    archive_entries = nullptr;
+    archive_entry_count = 0;
+}
+
+void AssetLoader::printStats() const
+{
+    std::cout << "Assets: " << stats.archive_loads << " loaded from the archive, " << stats.loose_loads
+        << " from loose files, " << stats.mapped_files << " files mapped (" << stats.mapped_bytes / 1024 << " KiB)" << std::endl;
+}
+
+const AssetLoader::ArchiveEntry* AssetLoader::findEntry(const std::string& name) const
+{
+    const ArchiveEntry* end = archive_entries + archive_entry_count;
+    const ArchiveEntry* entry = std::lower_bound(archive_entries, end, name.c_str(),
+        [](const ArchiveEntry& candidate, const char* key) { return strcmp(candidate.name, key) < 0; });
+    if(entry != end && strcmp(entry->name, name.c_str()) == 0)
+    {
+        return entry;
+    }
+    return nullptr;
+}
+
+bool AssetLoader::mapFile(const std::string& path, MappedFile* file)
+{
+    *file = {};
+#ifdef _WIN32
+    HANDLE handle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if(handle == INVALID_HANDLE_VALUE)
+    {
+        std::cout << "Failed to open file: " << path << std::endl;
+        return false;
+    }
+    LARGE_INTEGER size = {};
+    GetFileSizeEx(handle, &size);
+    //Empty files can't be mapped, but they are valid empty assets
+    if(size.QuadPart > 0)
+    {
+        HANDLE mapping = CreateFileMappingA(handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        void* address = mapping != nullptr ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+        if(mapping != nullptr)
+        {
+            CloseHandle(mapping);
+        }
+        if(address == nullptr)
+        {
+            std::cout << "Failed to map file: " << path << std::endl;
+            CloseHandle(handle);
+            return false;
+        }
+        file->data = static_cast<const char*>(address);
+        file->size = static_cast<size_t>(size.QuadPart);
+    }
+    CloseHandle(handle);
+#else
+    int descriptor = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if(descriptor < 0)
+    {
+        std::cout << "Failed to open file: " << path << std::endl;
+        return false;
+    }
+    struct stat status = {};
+    fstat(descriptor, &status);
+    //Empty files can't be mapped, but they are valid empty assets
+    if(status.st_size > 0)
+    {
+        void* address = mmap(nullptr, static_cast<size_t>(status.st_size), PROT_READ, MAP_PRIVATE, descriptor, 0);
+        if(address == MAP_FAILED)
+        {
+            std::cout << "Failed to map file: " << path << std::endl;
+            close(descriptor);
+            return false;
+        }
+        file->data = static_cast<const char*>(address);
+        file->size = static_cast<size_t>(status.st_size);
+    }
+    //The mapping keeps the file alive on its own
+    close(descriptor);
+#endif
+    stats.mapped_files++;
+    stats.mapped_bytes += file->size;
+    return true;
+}
+
+void AssetLoader::unmapFile(const MappedFile& file)
+{
+    if(file.data == nullptr)
+    {
+        return;
+    }
+#ifdef _WIN32
+    UnmapViewOfFile(file.data);
+#else
+    munmap(const_cast<char*>(file.data), file.size);
+#endif
+}
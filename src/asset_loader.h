@@ -0,0 +1,81 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <unordered_map>
+#include <cstdint>
+#include <cstddef>
+
+//Read only bytes of an asset. Spans from an AssetLoader point into mapped files and stay valid until the
+//loader is destroyed; owner is only set when the span keeps its own memory alive.
+struct AssetSpan
+{
+    const char* data = nullptr;
+    size_t size = 0;
+    std::shared_ptr<const void> owner = {};
+
+    const uint32_t* words() const { return reinterpret_cast<const uint32_t*>(data); }
+};
+
+//Maps asset files into memory instead of reading them, so loading doesn't copy or allocate per file.
+//Assets are looked up in the mounted packed archive first and fall back to loose files, which are
+//mapped once and kept. Every span is at least 4 byte aligned, so SPIR-V can go straight to Vulkan.
+//Not thread safe, load on one thread and hand the spans out.
+class AssetLoader
+{
+    public:
+        //Packed archive: the header, every asset's data at archive_alignment, then entry_count
+        //ArchiveEntry sorted by name. Written by tools/asset_pack.cpp.
+        static const uint32_t archive_version = 1;
+        static const uint64_t archive_alignment = 16;
+        struct ArchiveHeader
+        {
+            char magic[4];
+            uint32_t version;
+            uint32_t entry_count;
+            uint32_t reserved;
+            uint64_t toc_offset;
+        };
+        struct ArchiveEntry
+        {
+            //Path the asset is loaded by, nul padded
+            char name[112];
+            uint64_t offset;
+            uint64_t size;
+        };
+
+        struct Stats
+        {
+            uint32_t mapped_files = 0;
+            uint64_t mapped_bytes = 0;
+            uint32_t archive_loads = 0;
+            uint32_t loose_loads = 0;
+        };
+
+        AssetLoader();
+        ~AssetLoader();
+
+        bool mountArchive(const std::string&);
+        bool load(const std::string&, AssetSpan*);
+        void destroy();
+        void printStats() const;
+
+        Stats stats;
+
+    private:
+        struct MappedFile
+        {
+            const char* data = nullptr;
+            size_t size = 0;
+        };
+
+        bool mapFile(const std::string&, MappedFile*);
+        void unmapFile(const MappedFile&);
+        const ArchiveEntry* findEntry(const std::string&) const;
+
+        MappedFile archive;
+        const ArchiveEntry* archive_entries;
+        uint32_t archive_entry_count;
+        std::unordered_map<std::string, MappedFile> loose_files;
+};
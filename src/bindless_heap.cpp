@@ -0,0 +1,202 @@
+#include "bindless_heap.h"
+
+#include <iostream>
+#include <algorithm>
+
+BindlessHeap::BindlessHeap()
+{
+    set_layout = VK_NULL_HANDLE;
+    set = VK_NULL_HANDLE;
+    stats = {};
+    device = VK_NULL_HANDLE;
+    defer = {};
+    descriptor_pool = VK_NULL_HANDLE;
+    image_slots = {};
+    buffer_slots = {};
+}
+
+bool BindlessHeap::init(VkDevice logical_device, uint32_t image_capacity, uint32_t buffer_capacity, DeferFunction defer_function)
+{
+    device = logical_device;
+    defer = std::move(defer_function);
+    image_slots.capacity = image_capacity;
+    buffer_slots.capacity = buffer_capacity;
+
+    VkDescriptorSetLayoutBinding bindings[2] = {};
+    bindings[0].binding = image_binding;
+    bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    bindings[0].descriptorCount = image_capacity;
+    bindings[0].stageFlags = VK_SHADER_STAGE_ALL_GRAPHICS | VK_SHADER_STAGE_COMPUTE_BIT;
+    bindings[1].binding = buffer_binding;
+    bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    bindings[1].descriptorCount = buffer_capacity;
+    bindings[1].stageFlags = VK_SHADER_STAGE_ALL_GRAPHICS | VK_SHADER_STAGE_COMPUTE_BIT;
+
+    //Unused slots are never written, and slots change while the set is bound by frames in flight
+    VkDescriptorBindingFlags binding_flags[2] = {};
+    binding_flags[0] = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT;
+    binding_flags[1] = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT;
+
+    VkDescriptorSetLayoutBindingFlagsCreateInfo binding_flags_info = {};
+    binding_flags_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+    binding_flags_info.bindingCount = 2;
+    binding_flags_info.pBindingFlags = binding_flags;
+
+    VkDescriptorSetLayoutCreateInfo layout_info = {};
+    layout_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layout_info.pNext = &binding_flags_info;
+    layout_info.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
+    layout_info.bindingCount = 2;
+    layout_info.pBindings = bindings;
+    if(vkCreateDescriptorSetLayout(device, &layout_info, nullptr, &set_layout) != VK_SUCCESS)
+    {
+        std::cout << "Failed to create bindless descriptor set layout!" << std::endl;
+        return false;
+    }
+
+    VkDescriptorPoolSize pool_sizes[2] = {};
+    pool_sizes[0].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    pool_sizes[0].descriptorCount = image_capacity;
+    pool_sizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    pool_sizes[1].descriptorCount = buffer_capacity;
+
+    VkDescriptorPoolCreateInfo pool_info = {};
+    pool_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    pool_info.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
+    pool_info.maxSets = 1;
+    pool_info.poolSizeCount = 2;
+    pool_info.pPoolSizes = pool_sizes;
+    if(vkCreateDescriptorPool(device, &pool_info, nullptr, &descriptor_pool) != VK_SUCCESS)
+    {
+        std::cout << "Failed to create bindless descriptor pool!" << std::endl;
+        return false;
+    }
+
+    VkDescriptorSetAllocateInfo alloc_info = {};
+    alloc_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    alloc_info.descriptorPool = descriptor_pool;
+    alloc_info.descriptorSetCount = 1;
+    alloc_info.pSetLayouts = &set_layout;
+    if(vkAllocateDescriptorSets(device, &alloc_info, &set) != VK_SUCCESS)
+    {
+        std::cout << "Failed to allocate bindless descriptor set!" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+void BindlessHeap::destroy()
+{
+    if(device == VK_NULL_HANDLE)
+    {
+        return;
+    }
+    //Frees the set with it
+    vkDestroyDescriptorPool(device, descriptor_pool, nullptr);
+    vkDestroyDescriptorSetLayout(device, set_layout, nullptr);
+    descriptor_pool = VK_NULL_HANDLE;
+    set_layout = VK_NULL_HANDLE;
+    set = VK_NULL_HANDLE;
+    device = VK_NULL_HANDLE;
+}
+
+uint32_t BindlessHeap::addImage(VkImageView image_view, VkSampler sampler, VkImageLayout image_layout)
+{
+    uint32_t slot = allocateSlot(&image_slots);
+    if(slot == invalid_slot)
+    {
+        std::cout << "Bindless heap is out of image slots!" << std::endl;
+        return invalid_slot;
+    }
+
+    VkDescriptorImageInfo image_info = {};
+    image_info.sampler = sampler;
+    image_info.imageView = image_view;
+    image_info.imageLayout = image_layout;
+
+    VkWriteDescriptorSet write = {};
+    write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    write.dstSet = set;
+    write.dstBinding = image_binding;
+    write.dstArrayElement = slot;
+    write.descriptorCount = 1;
+    write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    write.pImageInfo = &image_info;
+    vkUpdateDescriptorSets(device, 1, &write, 0, nullptr);
+
+    stats.images++;
+    stats.peak_images = std::max(stats.peak_images, stats.images);
+    stats.writes++;
+    return slot;
+}
+
+uint32_t BindlessHeap::addBuffer(VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range)
+{
+    uint32_t slot = allocateSlot(&buffer_slots);
+    if(slot == invalid_slot)
+    {
+        std::cout << "Bindless heap is out of buffer slots!" << std::endl;
+        return invalid_slot;
+    }
+
+    VkDescriptorBufferInfo buffer_info = {};
+    buffer_info.buffer = buffer;
+    buffer_info.offset = offset;
+    buffer_info.range = range;
+
+    VkWriteDescriptorSet write = {};
+    write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    write.dstSet = set;
+    write.dstBinding = buffer_binding;
+    write.dstArrayElement = slot;
+    write.descriptorCount = 1;
+    write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    write.pBufferInfo = &buffer_info;
+    vkUpdateDescriptorSets(device, 1, &write, 0, nullptr);
+
+    stats.buffers++;
+    stats.peak_buffers = std::max(stats.peak_buffers, stats.buffers);
+    stats.writes++;
+    return slot;
+}
+
+void BindlessHeap::removeImage(uint32_t slot)
+{
+    stats.images--;
+    releaseSlot(&image_slots, slot);
+}
+
+void BindlessHeap::removeBuffer(uint32_t slot)
+{
+    stats.buffers--;
+    releaseSlot(&buffer_slots, slot);
+}
+
+void BindlessHeap::printStats() const
+{
+    std::cout << "Bindless heap: " << stats.images << " images (peak " << stats.peak_images << " of " << image_slots.capacity
+        << "), " << stats.buffers << " buffers (peak " << stats.peak_buffers << " of " << buffer_slots.capacity << "), "
+        << stats.writes << " descriptor writes" << std::endl;
+}
+
+uint32_t BindlessHeap::allocateSlot(SlotList* slots)
+{
+    //Reuse freed slots first, so the used part of the array stays compact
+    if(!slots->free_slots.empty())
+    {
+        uint32_t slot = slots->free_slots.back();
+        slots->free_slots.pop_back();
+        return slot;
+    }
+    if(slots->high_water < slots->capacity)
+    {
+        return slots->high_water++;
+    }
+    return invalid_slot;
+}
+
+void BindlessHeap::releaseSlot(SlotList* slots, uint32_t slot)
+{
+    //The descriptor stays valid until then, a frame in flight may still read it
+    defer([slots, slot]() { slots->free_slots.push_back(slot); });
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <vulkan/vulkan.h>
+#include "memory_allocator.h"
+
+//One descriptor set holding every image and buffer the shaders can reach, addressed by slot index from
+//push constants or instance data. It is bound once per command buffer instead of a set per material.
+//Needs descriptor indexing: bindings are partially bound and update after bind, so slots can be written
+//while frames reading other slots are in flight.
+class BindlessHeap
+{
+    public:
+        //Arrays of combined image samplers and storage buffers
+        static const uint32_t image_binding = 0;
+        static const uint32_t buffer_binding = 1;
+        static const uint32_t invalid_slot = ~0u;
+
+        struct Stats
+        {
+            uint32_t images = 0;
+            uint32_t buffers = 0;
+            uint32_t peak_images = 0;
+            uint32_t peak_buffers = 0;
+            uint64_t writes = 0;
+        };
+
+        BindlessHeap();
+
+        //Capacities are slots per binding, clamp them to the device's update after bind limits
+        bool init(VkDevice, uint32_t, uint32_t, DeferFunction);
+        void destroy();
+
+        //Return the slot to index the array with, invalid_slot when the heap is full
+        uint32_t addImage(VkImageView, VkSampler, VkImageLayout);
+        uint32_t addBuffer(VkBuffer, VkDeviceSize, VkDeviceSize);
+        //The slot is reused once the frames in flight are done with it
+        void removeImage(uint32_t);
+        void removeBuffer(uint32_t);
+        void printStats() const;
+
+        VkDescriptorSetLayout set_layout;
+        VkDescriptorSet set;
+        Stats stats;
+
+    private:
+        //Free list of slots; slots past high_water have never been handed out
+        struct SlotList
+        {
+            std::vector<uint32_t> free_slots = {};
+            uint32_t high_water = 0;
+            uint32_t capacity = 0;
+        };
+
+        uint32_t allocateSlot(SlotList*);
+        void releaseSlot(SlotList*, uint32_t);
+
+        VkDevice device;
+        DeferFunction defer;
+        VkDescriptorPool descriptor_pool;
+        SlotList image_slots;
+        SlotList buffer_slots;
+};
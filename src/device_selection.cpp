@@ -0,0 +1,244 @@
+#include "device_selection.h"
+
+#include <iostream>
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <iterator>
+
+namespace
+{
+    //Everything createLogicalDevice looks for beyond the required extensions
+    const char* const optional_device_extensions[] = {
+        VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME,
+        VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME,
+        VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME,
+        VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME,
+        VK_KHR_PRESENT_ID_EXTENSION_NAME,
+        VK_KHR_PRESENT_WAIT_EXTENSION_NAME
+    };
+
+    const uint64_t type_weight = 1000000000;
+    //Per MiB, a terabyte of VRAM stays below type_weight
+    const uint64_t memory_weight = 1000;
+    const uint64_t queue_weight = 200;
+    const uint64_t feature_weight = 100;
+    const uint64_t extension_weight = 50;
+
+    const char* deviceTypeName(VkPhysicalDeviceType type)
+    {
+        switch(type)
+        {
+            case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU:
+                return "discrete";
+            case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU:
+                return "integrated";
+            case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU:
+                return "virtual";
+            case VK_PHYSICAL_DEVICE_TYPE_CPU:
+                return "cpu";
+            default:
+                return "other";
+        }
+    }
+
+    //Vendors pack their driver versions differently, print them the way their tools do
+    std::string driverVersionString(uint32_t vendor_id, uint32_t version)
+    {
+        char text[32] = {};
+        if(vendor_id == 0x10DE)
+        {
+            snprintf(text, sizeof(text), "%u.%u.%u", version >> 22, (version >> 14) & 0xFF, (version >> 6) & 0xFF);
+        }
+        else
+        {
+            snprintf(text, sizeof(text), "%u.%u.%u", VK_API_VERSION_MAJOR(version), VK_API_VERSION_MINOR(version),
+                VK_API_VERSION_PATCH(version));
+        }
+        return text;
+    }
+}
+
+void DeviceInfo::query(VkPhysicalDevice physical_device, uint32_t device_index, uint32_t instance_api_version, DeviceInfo* info)
+{
+    *info = {};
+    info->device = physical_device;
+    info->index = device_index;
+    vkGetPhysicalDeviceProperties(physical_device, &info->properties);
+    vkGetPhysicalDeviceFeatures(physical_device, &info->features);
+
+    if(std::min(instance_api_version, info->properties.apiVersion) >= VK_API_VERSION_1_1)
+    {
+        VkPhysicalDeviceIDProperties id_properties = {};
+        id_properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ID_PROPERTIES;
+        VkPhysicalDeviceProperties2 properties2 = {};
+        properties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+        properties2.pNext = &id_properties;
+        vkGetPhysicalDeviceProperties2(physical_device, &properties2);
+        memcpy(info->uuid, id_properties.deviceUUID, VK_UUID_SIZE);
+        info->has_uuid = true;
+    }
+
+    VkPhysicalDeviceMemoryProperties memory_properties = {};
+    vkGetPhysicalDeviceMemoryProperties(physical_device, &memory_properties);
+    for(uint32_t i = 0; i < memory_properties.memoryHeapCount; i++)
+    {
+        if(memory_properties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT)
+        {
+            info->device_local_bytes = std::max(info->device_local_bytes, memory_properties.memoryHeaps[i].size);
+        }
+    }
+
+    uint32_t family_count = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(physical_device, &family_count, nullptr);
+    std::vector<VkQueueFamilyProperties> families(family_count);
+    vkGetPhysicalDeviceQueueFamilyProperties(physical_device, &family_count, families.data());
+    for(const auto& family : families)
+    {
+        if(family.queueCount == 0 || (family.queueFlags & VK_QUEUE_GRAPHICS_BIT))
+        {
+            continue;
+        }
+        if(family.queueFlags & VK_QUEUE_COMPUTE_BIT)
+        {
+            info->compute_only_family = true;
+        }
+        else if(family.queueFlags & VK_QUEUE_TRANSFER_BIT)
+        {
+            info->transfer_only_family = true;
+        }
+    }
+
+    uint32_t extension_count = 0;
+    vkEnumerateDeviceExtensionProperties(physical_device, nullptr, &extension_count, nullptr);
+    std::vector<VkExtensionProperties> extensions(extension_count);
+    vkEnumerateDeviceExtensionProperties(physical_device, nullptr, &extension_count, extensions.data());
+    for(const char* optional_extension : optional_device_extensions)
+    {
+        for(const auto& extension : extensions)
+        {
+            if(strcmp(extension.extensionName, optional_extension) == 0)
+            {
+                info->optional_extensions.push_back(optional_extension);
+                break;
+            }
+        }
+    }
+}
+
+void DeviceInfo::computeScore()
+{
+    uint64_t type_points = 0;
+    switch(properties.deviceType)
+    {
+        case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU:
+            type_points = 4;
+            break;
+        case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU:
+            type_points = 3;
+            break;
+        case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU:
+            type_points = 2;
+            break;
+        case VK_PHYSICAL_DEVICE_TYPE_CPU:
+            type_points = 1;
+            break;
+        default:
+            break;
+    }
+    uint64_t memory_mib = std::min<uint64_t>(device_local_bytes / (1024 * 1024), type_weight / memory_weight - 1);
+
+    score = type_points * type_weight + memory_mib * memory_weight;
+    score += compute_only_family ? queue_weight : 0;
+    score += transfer_only_family ? queue_weight : 0;
+    score += features.multiDrawIndirect ? feature_weight : 0;
+    score += features.drawIndirectFirstInstance ? feature_weight : 0;
+    score += optional_extensions.size() * extension_weight;
+}
+
+bool DeviceInfo::matches(const std::string& selector) const
+{
+    if(selector.empty())
+    {
+        return false;
+    }
+    if(std::all_of(selector.begin(), selector.end(), [](char c) { return std::isdigit(static_cast<unsigned char>(c)) != 0; }))
+    {
+        //Not this index, but a device name can contain digits and a UUID without dashes can be all digits
+        errno = 0;
+        unsigned long long value = strtoull(selector.c_str(), nullptr, 10);
+        if(errno == 0 && value <= UINT32_MAX && value == index)
+        {
+            return true;
+        }
+    }
+
+    auto lower = [](const std::string& text)
+    {
+        std::string result = {};
+        std::transform(text.begin(), text.end(), std::back_inserter(result),
+            [](char c) { return static_cast<char>(std::tolower(static_cast<unsigned char>(c))); });
+        return result;
+    };
+    std::string lower_selector = lower(selector);
+
+    std::string hex = lower_selector;
+    hex.erase(std::remove(hex.begin(), hex.end(), '-'), hex.end());
+    std::string uuid_hex = uuidString();
+    uuid_hex.erase(std::remove(uuid_hex.begin(), uuid_hex.end(), '-'), uuid_hex.end());
+    if(has_uuid && hex == uuid_hex)
+    {
+        return true;
+    }
+
+    std::string lower_name = lower(properties.deviceName);
+    return lower_name.find(lower_selector) != std::string::npos;
+}
+
+std::string DeviceInfo::uuidString() const
+{
+    //The usual 8-4-4-4-12 grouping
+    std::string text = {};
+    for(uint32_t i = 0; i < VK_UUID_SIZE; i++)
+    {
+        char byte[3] = {};
+        snprintf(byte, sizeof(byte), "%02x", uuid[i]);
+        text += byte;
+        if(i == 3 || i == 5 || i == 7 || i == 9)
+        {
+            text += '-';
+        }
+    }
+    return text;
+}
+
+void DeviceInfo::print(bool selected) const
+{
+    std::cout << (selected ? "* " : "  ") << "GPU " << index << ": " << properties.deviceName << " ("
+        << deviceTypeName(properties.deviceType) << ", Vulkan " << VK_API_VERSION_MAJOR(properties.apiVersion) << "."
+        << VK_API_VERSION_MINOR(properties.apiVersion) << "." << VK_API_VERSION_PATCH(properties.apiVersion)
+        << ", driver " << driverVersionString(properties.vendorID, properties.driverVersion) << ")" << std::endl;
+    if(has_uuid)
+    {
+        std::cout << "    uuid " << uuidString() << std::endl;
+    }
+    std::cout << "    " << device_local_bytes / (1024 * 1024) << " MiB device local, queues: graphics"
+        << (compute_only_family ? " + async compute" : "") << (transfer_only_family ? " + copy" : "")
+        << ", timestamp period " << properties.limits.timestampPeriod << " ns" << std::endl;
+    std::cout << "    multiDrawIndirect " << (features.multiDrawIndirect ? "yes" : "no") << ", drawIndirectFirstInstance "
+        << (features.drawIndirectFirstInstance ? "yes" : "no") << ", optional extensions:";
+    if(optional_extensions.empty())
+    {
+        std::cout << " none";
+    }
+    for(const auto& extension : optional_extensions)
+    {
+        std::cout << " " << extension;
+    }
+    std::cout << std::endl;
+    std::cout << "    score " << score << (suitable ? "" : ", unsuitable (missing required extensions or presentation)") << std::endl;
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <vulkan/vulkan.h>
+
+//What a physical device offers that the renderer cares about, gathered once to rank the devices and to
+//log at startup, so different frame rates on different machines can be traced back to the hardware
+struct DeviceInfo
+{
+    VkPhysicalDevice device = VK_NULL_HANDLE;
+    //Position in vkEnumeratePhysicalDevices
+    uint32_t index = 0;
+    VkPhysicalDeviceProperties properties = {};
+    VkPhysicalDeviceFeatures features = {};
+    //Needs Vulkan 1.1, has_uuid is false before that
+    uint8_t uuid[VK_UUID_SIZE] = {};
+    bool has_uuid = false;
+    //Largest device local heap, shared system memory on integrated GPUs
+    VkDeviceSize device_local_bytes = 0;
+    bool compute_only_family = false;
+    bool transfer_only_family = false;
+    //Optional extensions the renderer enables when they are there
+    std::vector<std::string> optional_extensions = {};
+    //Has the required extensions and can present to the window, set by the caller
+    bool suitable = false;
+    uint64_t score = 0;
+
+    static void query(VkPhysicalDevice, uint32_t, uint32_t, DeviceInfo*);
+    //Device type first, then device local memory, then dedicated compute and transfer queues, then
+    //optional features and extensions. Each comes with a weight the ones after it can't add up to.
+    void computeScore();
+    //A case insensitive part of the name, the UUID in hex with or without dashes, or the index
+    bool matches(const std::string&) const;
+    std::string uuidString() const;
+    void print(bool) const;
+};
@@ -0,0 +1,524 @@
+#include "frame_capture.h"
+
+#include <iostream>
+#include <algorithm>
+#include <chrono>
+
+namespace
+{
+    const uint32_t bytes_per_pixel = 4;
+    //Y4M needs a rate in its header, frames are still captured as fast as they render
+    const char* const y4m_header_rate = "F60:1";
+    //Largest block deflate stores without compression
+    const uint32_t stored_block_size = 65535;
+
+    bool endsWith(const std::string& text, const char* suffix)
+    {
+        std::string end = suffix;
+        return text.size() >= end.size() && text.compare(text.size() - end.size(), end.size(), end) == 0;
+    }
+
+    uint32_t crc32(const uint8_t* data, size_t size, uint32_t crc = 0)
+    {
+        static uint32_t table[256] = {};
+        static bool table_ready = false;
+        if(!table_ready)
+        {
+            for(uint32_t i = 0; i < 256; i++)
+            {
+                uint32_t value = i;
+                for(uint32_t bit = 0; bit < 8; bit++)
+                {
+                    value = (value & 1) ? 0xEDB88320u ^ (value >> 1) : value >> 1;
+                }
+                table[i] = value;
+            }
+            table_ready = true;
+        }
+        crc = ~crc;
+        for(size_t i = 0; i < size; i++)
+        {
+            crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+        }
+        return ~crc;
+    }
+
+    void appendBigEndian(std::vector<uint8_t>& out, uint32_t value)
+    {
+        out.push_back(static_cast<uint8_t>(value >> 24));
+        out.push_back(static_cast<uint8_t>(value >> 16));
+        out.push_back(static_cast<uint8_t>(value >> 8));
+        out.push_back(static_cast<uint8_t>(value));
+    }
+}
+
+FrameCapture::FrameCapture()
+{
+    device = VK_NULL_HANDLE;
+    allocator = nullptr;
+    format = Format::Ppm;
+    bgra = false;
+    path = {};
+    slots = {};
+    next_slot = 0;
+    sequence = 0;
+    copying = {};
+    stream = nullptr;
+    stream_extent = {};
+    rgb = {};
+    encoded = {};
+    stopping = false;
+    queued = {};
+    stats = {};
+}
+
+FrameCapture::~FrameCapture()
+{
+    destroy();
+}
+
+bool FrameCapture::init(VkDevice logical_device, DeviceAllocator* device_allocator, uint32_t slot_count, VkFormat image_format,
+    const std::string& output_path)
+{
+    device = logical_device;
+    allocator = device_allocator;
+    path = output_path;
+
+    switch(image_format)
+    {
+        case VK_FORMAT_R8G8B8A8_UNORM:
+        case VK_FORMAT_R8G8B8A8_SRGB:
+            bgra = false;
+            break;
+        case VK_FORMAT_B8G8R8A8_UNORM:
+        case VK_FORMAT_B8G8R8A8_SRGB:
+            bgra = true;
+            break;
+        default:
+            std::cout << "Failed to start capture, only 8 bit RGBA and BGRA images can be captured!" << std::endl;
+            return false;
+    }
+
+    if(endsWith(path, ".y4m"))
+    {
+        format = Format::Y4m;
+        stream = fopen(path.c_str(), "wb");
+        if(stream == nullptr)
+        {
+            std::cout << "Failed to open " << path << "!" << std::endl;
+            return false;
+        }
+    }
+    else if(endsWith(path, ".png"))
+    {
+        format = Format::Png;
+    }
+    else if(endsWith(path, ".raw"))
+    {
+        format = Format::Raw;
+        std::cout << "Capturing raw " << (bgra ? "BGRA" : "RGBA") << " frames" << std::endl;
+    }
+    else
+    {
+        format = Format::Ppm;
+    }
+
+    //Buffers are created on first use, at the size of the image copied into them
+    slots.assign(std::max(slot_count, 1u), Slot());
+    next_slot = 0;
+    sequence = 0;
+    stopping = false;
+    writer = std::thread(&FrameCapture::writerLoop, this);
+    return true;
+}
+
+void FrameCapture::destroy()
+{
+    if(!writer.joinable())
+    {
+        return;
+    }
+    flush();
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    work_ready.notify_all();
+    writer.join();
+
+    if(stream != nullptr)
+    {
+        fclose(stream);
+        stream = nullptr;
+    }
+    for(auto& slot : slots)
+    {
+        if(slot.buffer != VK_NULL_HANDLE)
+        {
+            allocator->destroyBuffer(slot.buffer, slot.allocation);
+        }
+    }
+    slots.clear();
+}
+
+bool FrameCapture::recordCopy(VkCommandBuffer command_buffer, VkImage image, VkExtent2D extent, uint64_t frame)
+{
+    Slot& slot = slots[next_slot];
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if(slot.state != SlotState::Free)
+        {
+            //Slots come back in order, so the next frame tries the same one again
+            stats.skipped++;
+            sequence++;
+            return true;
+        }
+    }
+
+    //Free slots aren't touched by the GPU or the writer, a resize can replace the buffer right away
+    VkDeviceSize size = static_cast<VkDeviceSize>(extent.width) * extent.height * bytes_per_pixel;
+    if(slot.size < size)
+    {
+        if(slot.buffer != VK_NULL_HANDLE)
+        {
+            allocator->destroyBuffer(slot.buffer, slot.allocation);
+            slot.buffer = VK_NULL_HANDLE;
+            slot.size = 0;
+        }
+        VkBufferCreateInfo buffer_info = {};
+        buffer_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+        buffer_info.size = size;
+        buffer_info.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+        buffer_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        //Cached memory makes the writer's reads far cheaper where the device offers it
+        if(!allocator->createBuffer(buffer_info, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+            VK_MEMORY_PROPERTY_HOST_CACHED_BIT, &slot.buffer, &slot.allocation))
+        {
+            std::cout << "Failed to create capture buffer!" << std::endl;
+            return false;
+        }
+        slot.size = size;
+    }
+
+    VkBufferImageCopy region = {};
+    region.bufferOffset = 0;
+    //Tightly packed rows
+    region.bufferRowLength = 0;
+    region.bufferImageHeight = 0;
+    region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    region.imageSubresource.mipLevel = 0;
+    region.imageSubresource.baseArrayLayer = 0;
+    region.imageSubresource.layerCount = 1;
+    region.imageOffset = {0, 0, 0};
+    region.imageExtent = {extent.width, extent.height, 1};
+    vkCmdCopyImageToBuffer(command_buffer, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, slot.buffer, 1, &region);
+
+    //The fence only covers execution, the host still needs the copy made visible to it
+    VkBufferMemoryBarrier barrier = {};
+    barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.buffer = slot.buffer;
+    barrier.offset = 0;
+    barrier.size = size;
+    vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 0, nullptr, 1, &barrier,
+        0, nullptr);
+
+    slot.extent = extent;
+    slot.frame = frame;
+    slot.sequence = sequence++;
+    slot.state = SlotState::Copying;
+    copying.push_back(next_slot);
+    next_slot = (next_slot + 1) % static_cast<uint32_t>(slots.size());
+    return true;
+}
+
+void FrameCapture::collect(uint64_t completed_frame)
+{
+    if(copying.empty() || slots[copying.front()].frame > completed_frame)
+    {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        while(!copying.empty() && slots[copying.front()].frame <= completed_frame)
+        {
+            slots[copying.front()].state = SlotState::Queued;
+            queued.push_back(copying.front());
+            copying.pop_front();
+            stats.copied++;
+        }
+        stats.max_queued = std::max(stats.max_queued, static_cast<uint32_t>(queued.size()));
+    }
+    work_ready.notify_one();
+}
+
+void FrameCapture::flush()
+{
+    collect(UINT64_MAX);
+    std::unique_lock<std::mutex> lock(mutex);
+    work_done.wait(lock, [this]() { return queued.empty(); });
+}
+
+void FrameCapture::writerLoop()
+{
+    while(true)
+    {
+        uint32_t index = 0;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            work_ready.wait(lock, [this]() { return stopping || !queued.empty(); });
+            if(queued.empty())
+            {
+                return;
+            }
+            index = queued.front();
+        }
+
+        //The slot stays queued while it is written, so the render thread leaves it alone
+        auto start = std::chrono::steady_clock::now();
+        bool written = writeSlot(slots[index]);
+        double write_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if(written)
+            {
+                stats.written++;
+                stats.bytes_written += encoded.size();
+            }
+            else
+            {
+                stats.failed++;
+            }
+            stats.write_ms += write_ms;
+            slots[index].state = SlotState::Free;
+            queued.pop_front();
+        }
+        work_done.notify_all();
+    }
+}
+
+bool FrameCapture::writeSlot(const Slot& slot)
+{
+    uint32_t width = slot.extent.width;
+    uint32_t height = slot.extent.height;
+    encoded.clear();
+
+    if(format == Format::Y4m)
+    {
+        return writeY4m(slot);
+    }
+
+    std::string file_path = sequencePath(slot.sequence);
+    if(format == Format::Png)
+    {
+        convertToRgb(slot);
+        return writePng(file_path, width, height);
+    }
+
+    FILE* file = fopen(file_path.c_str(), "wb");
+    if(file == nullptr)
+    {
+        std::cout << "Failed to open " << file_path << "!" << std::endl;
+        return false;
+    }
+    size_t size = 0;
+    if(format == Format::Raw)
+    {
+        size = static_cast<size_t>(width) * height * bytes_per_pixel;
+        encoded.assign(static_cast<const uint8_t*>(slot.allocation.mapped), static_cast<const uint8_t*>(slot.allocation.mapped) + size);
+    }
+    else
+    {
+        convertToRgb(slot);
+        std::string header = "P6\n" + std::to_string(width) + " " + std::to_string(height) + "\n255\n";
+        encoded.assign(header.begin(), header.end());
+        encoded.insert(encoded.end(), rgb.begin(), rgb.end());
+    }
+    size = fwrite(encoded.data(), 1, encoded.size(), file);
+    fclose(file);
+    return size == encoded.size();
+}
+
+void FrameCapture::convertToRgb(const Slot& slot)
+{
+    size_t pixel_count = static_cast<size_t>(slot.extent.width) * slot.extent.height;
+    const uint8_t* pixels = static_cast<const uint8_t*>(slot.allocation.mapped);
+    rgb.resize(pixel_count * 3);
+    uint32_t red = bgra ? 2 : 0;
+    uint32_t blue = bgra ? 0 : 2;
+    for(size_t i = 0; i < pixel_count; i++)
+    {
+        rgb[i * 3 + 0] = pixels[i * bytes_per_pixel + red];
+        rgb[i * 3 + 1] = pixels[i * bytes_per_pixel + 1];
+        rgb[i * 3 + 2] = pixels[i * bytes_per_pixel + blue];
+    }
+}
+
+bool FrameCapture::writePng(const std::string& file_path, uint32_t width, uint32_t height)
+{
+    auto chunk = [this](const char* type, const std::vector<uint8_t>& data)
+    {
+        appendBigEndian(encoded, static_cast<uint32_t>(data.size()));
+        size_t type_start = encoded.size();
+        encoded.insert(encoded.end(), type, type + 4);
+        encoded.insert(encoded.end(), data.begin(), data.end());
+        appendBigEndian(encoded, crc32(encoded.data() + type_start, encoded.size() - type_start));
+    };
+
+    const uint8_t signature[] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+    encoded.insert(encoded.end(), signature, signature + sizeof(signature));
+
+    //8 bit RGB, no interlacing
+    std::vector<uint8_t> header = {};
+    appendBigEndian(header, width);
+    appendBigEndian(header, height);
+    header.insert(header.end(), {8, 2, 0, 0, 0});
+    chunk("IHDR", header);
+
+    //Every row starts with filter type 0, then the rows go into stored deflate blocks
+    size_t row_size = static_cast<size_t>(width) * 3;
+    std::vector<uint8_t> scanlines(static_cast<size_t>(height) * (row_size + 1));
+    for(uint32_t y = 0; y < height; y++)
+    {
+        scanlines[y * (row_size + 1)] = 0;
+        std::copy(rgb.begin() + y * row_size, rgb.begin() + (y + 1) * row_size, scanlines.begin() + y * (row_size + 1) + 1);
+    }
+
+    std::vector<uint8_t> image_data = {0x78, 0x01};
+    size_t offset = 0;
+    do
+    {
+        uint32_t block = static_cast<uint32_t>(std::min<size_t>(scanlines.size() - offset, stored_block_size));
+        bool last = offset + block == scanlines.size();
+        image_data.push_back(last ? 1 : 0);
+        image_data.push_back(static_cast<uint8_t>(block));
+        image_data.push_back(static_cast<uint8_t>(block >> 8));
+        image_data.push_back(static_cast<uint8_t>(~block));
+        image_data.push_back(static_cast<uint8_t>(~block >> 8));
+        image_data.insert(image_data.end(), scanlines.begin() + offset, scanlines.begin() + offset + block);
+        offset += block;
+    } while(offset < scanlines.size());
+
+    uint32_t a = 1;
+    uint32_t b = 0;
+    for(uint8_t value : scanlines)
+    {
+        a = (a + value) % 65521;
+        b = (b + a) % 65521;
+    }
+    appendBigEndian(image_data, (b << 16) | a);
+    chunk("IDAT", image_data);
+    chunk("IEND", {});
+
+    FILE* file = fopen(file_path.c_str(), "wb");
+    if(file == nullptr)
+    {
+        std::cout << "Failed to open " << file_path << "!" << std::endl;
+        return false;
+    }
+    size_t size = fwrite(encoded.data(), 1, encoded.size(), file);
+    fclose(file);
+    return size == encoded.size();
+}
+
+bool FrameCapture::writeY4m(const Slot& slot)
+{
+    uint32_t width = slot.extent.width;
+    uint32_t height = slot.extent.height;
+    if(stream_extent.width == 0)
+    {
+        stream_extent = slot.extent;
+        std::string header = "YUV4MPEG2 W" + std::to_string(width) + " H" + std::to_string(height) + " " + y4m_header_rate
+            + " Ip A1:1 C420jpeg\n";
+        if(fwrite(header.data(), 1, header.size(), stream) != header.size())
+        {
+            return false;
+        }
+    }
+    //A stream has one size, frames rendered after a resize don't fit in it
+    if(width != stream_extent.width || height != stream_extent.height)
+    {
+        return false;
+    }
+
+    //Full range BT.601, chroma averaged over 2x2 pixels
+    const uint8_t* pixels = static_cast<const uint8_t*>(slot.allocation.mapped);
+    uint32_t red = bgra ? 2 : 0;
+    uint32_t blue = bgra ? 0 : 2;
+    uint32_t chroma_width = (width + 1) / 2;
+    uint32_t chroma_height = (height + 1) / 2;
+    size_t luma_size = static_cast<size_t>(width) * height;
+    size_t chroma_size = static_cast<size_t>(chroma_width) * chroma_height;
+    const char frame_header[] = "FRAME\n";
+    encoded.assign(frame_header, frame_header + sizeof(frame_header) - 1);
+    size_t planes = encoded.size();
+    encoded.resize(planes + luma_size + 2 * chroma_size);
+    uint8_t* y_plane = encoded.data() + planes;
+    uint8_t* u_plane = y_plane + luma_size;
+    uint8_t* v_plane = u_plane + chroma_size;
+
+    for(uint32_t y = 0; y < height; y++)
+    {
+        for(uint32_t x = 0; x < width; x++)
+        {
+            const uint8_t* pixel = pixels + (static_cast<size_t>(y) * width + x) * bytes_per_pixel;
+            float luma = 0.299f * pixel[red] + 0.587f * pixel[1] + 0.114f * pixel[blue];
+            y_plane[static_cast<size_t>(y) * width + x] = static_cast<uint8_t>(std::clamp(luma + 0.5f, 0.0f, 255.0f));
+        }
+    }
+    for(uint32_t cy = 0; cy < chroma_height; cy++)
+    {
+        for(uint32_t cx = 0; cx < chroma_width; cx++)
+        {
+            float r = 0.0f;
+            float g = 0.0f;
+            float b = 0.0f;
+            uint32_t count = 0;
+            for(uint32_t y = cy * 2; y < std::min(cy * 2 + 2, height); y++)
+            {
+                for(uint32_t x = cx * 2; x < std::min(cx * 2 + 2, width); x++)
+                {
+                    const uint8_t* pixel = pixels + (static_cast<size_t>(y) * width + x) * bytes_per_pixel;
+                    r += pixel[red];
+                    g += pixel[1];
+                    b += pixel[blue];
+                    count++;
+                }
+            }
+            r /= count;
+            g /= count;
+            b /= count;
+            float u = 128.0f - 0.168736f * r - 0.331264f * g + 0.5f * b;
+            float v = 128.0f + 0.5f * r - 0.418688f * g - 0.081312f * b;
+            u_plane[static_cast<size_t>(cy) * chroma_width + cx] = static_cast<uint8_t>(std::clamp(u + 0.5f, 0.0f, 255.0f));
+            v_plane[static_cast<size_t>(cy) * chroma_width + cx] = static_cast<uint8_t>(std::clamp(v + 0.5f, 0.0f, 255.0f));
+        }
+    }
+    return fwrite(encoded.data(), 1, encoded.size(), stream) == encoded.size();
+}
+
+std::string FrameCapture::sequencePath(uint64_t index) const
+{
+    char number[32] = {};
+    snprintf(number, sizeof(number), "_%06llu", static_cast<unsigned long long>(index));
+    size_t dot = path.find_last_of('.');
+    size_t slash = path.find_last_of('/');
+    if(dot == std::string::npos || (slash != std::string::npos && dot < slash))
+    {
+        return path + number;
+    }
+    return path.substr(0, dot) + number + path.substr(dot);
+}
+
+void FrameCapture::printStats()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    std::cout << "Capture: " << stats.written << " frames written to " << path << ", " << stats.skipped
+        << " skipped with the ring full, " << stats.failed << " failed, " << stats.bytes_written / (1024 * 1024) << " MiB, "
+        << (stats.written + stats.failed > 0 ? stats.write_ms / (stats.written + stats.failed) : 0.0) << " ms per write, up to "
+        << stats.max_queued << " of " << slots.size() << " slots queued" << std::endl;
+}
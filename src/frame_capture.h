@@ -0,0 +1,116 @@
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <cstdio>
+#include <cstdint>
+#include <vulkan/vulkan.h>
+#include "memory_allocator.h"
+
+//Copies rendered images into a ring of host visible buffers and writes them to disk on a worker thread.
+//A slot goes to the writer once the frame that copied into it has completed, which the renderer learns
+//from its fences anyway, so neither recording nor writing ever waits on the GPU. When the writer falls
+//behind and the ring is full, frames are skipped rather than holding the render thread up.
+class FrameCapture
+{
+    public:
+        enum class Format
+        {
+            //The copied bytes as they are, 4 per pixel in the image's channel order
+            Raw,
+            Ppm,
+            //Stored without compression, so encoding costs no more than a PPM
+            Png,
+            //One 4:2:0 stream of every frame
+            Y4m
+        };
+
+        struct Stats
+        {
+            uint64_t copied = 0;
+            //Frames that found the ring full
+            uint64_t skipped = 0;
+            uint64_t written = 0;
+            uint64_t failed = 0;
+            uint64_t bytes_written = 0;
+            double write_ms = 0.0;
+            uint32_t max_queued = 0;
+        };
+
+        FrameCapture();
+        ~FrameCapture();
+
+        //Slot count, format of the images copied from and the output path. The extension picks the format:
+        //.y4m writes one stream, .ppm, .png and .raw a file per frame numbered next to the path.
+        bool init(VkDevice, DeviceAllocator*, uint32_t, VkFormat, const std::string&);
+        //The device must be idle, frames still in the ring are written out first
+        void destroy();
+
+        //Record a copy of the image, which must be in TRANSFER_SRC_OPTIMAL, into the next slot. The last
+        //argument is the renderer's submission index of the command buffer.
+        bool recordCopy(VkCommandBuffer, VkImage, VkExtent2D, uint64_t);
+        //Hand the copies of every frame up to this submission index to the writer
+        void collect(uint64_t);
+        //The device must be idle, returns once everything copied so far is on disk
+        void flush();
+        void printStats();
+
+    private:
+        enum class SlotState : uint8_t
+        {
+            Free,
+            Copying,
+            Queued
+        };
+        struct Slot
+        {
+            VkBuffer buffer = VK_NULL_HANDLE;
+            MemoryAllocation allocation = {};
+            VkDeviceSize size = 0;
+            VkExtent2D extent = {};
+            //Submission index of the frame copying into it, and the frame's number in the capture
+            uint64_t frame = 0;
+            uint64_t sequence = 0;
+            SlotState state = SlotState::Free;
+        };
+
+        void writerLoop();
+        bool writeSlot(const Slot&);
+        //Rows of RGB bytes from a slot, into rgb
+        void convertToRgb(const Slot&);
+        bool writePng(const std::string&, uint32_t, uint32_t);
+        bool writeY4m(const Slot&);
+        std::string sequencePath(uint64_t) const;
+
+        VkDevice device;
+        DeviceAllocator* allocator;
+        Format format;
+        bool bgra;
+        std::string path;
+
+        std::vector<Slot> slots;
+        uint32_t next_slot;
+        uint64_t sequence;
+        //Render thread only: slots with recorded copies, oldest first
+        std::deque<uint32_t> copying;
+
+        //Writer thread only
+        FILE* stream;
+        VkExtent2D stream_extent;
+        std::vector<uint8_t> rgb;
+        std::vector<uint8_t> encoded;
+
+        std::thread writer;
+        std::atomic<bool> stopping;
+        //Guards slot states, queued and stats
+        std::mutex mutex;
+        std::condition_variable work_ready;
+        std::condition_variable work_done;
+        std::deque<uint32_t> queued;
+        Stats stats;
+};
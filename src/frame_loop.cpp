@@ -0,0 +1,210 @@
+#include "frame_loop.h"
+
+#include <iostream>
+#include <algorithm>
+#include <thread>
+
+InputQueue::InputQueue(uint32_t capacity)
+{
+    uint64_t size = 1;
+    while(size < capacity)
+    {
+        size <<= 1;
+    }
+    events.resize(size);
+    mask = size - 1;
+    write_index = 0;
+    read_index = 0;
+    dropped_events = 0;
+}
+
+bool InputQueue::push(const InputEvent& event)
+{
+    uint64_t write = write_index.load(std::memory_order_relaxed);
+    if(write - read_index.load(std::memory_order_acquire) > mask)
+    {
+        dropped_events.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    events[write & mask] = event;
+    write_index.store(write + 1, std::memory_order_release);
+    return true;
+}
+
+bool InputQueue::pop(InputEvent* event)
+{
+    uint64_t read = read_index.load(std::memory_order_relaxed);
+    if(read == write_index.load(std::memory_order_acquire))
+    {
+        return false;
+    }
+    *event = events[read & mask];
+    read_index.store(read + 1, std::memory_order_release);
+    return true;
+}
+
+uint64_t InputQueue::dropped() const
+{
+    return dropped_events.load(std::memory_order_relaxed);
+}
+
+FixedTimestep::FixedTimestep(double step_seconds, uint32_t max_steps_per_advance)
+{
+    step = step_seconds;
+    max_steps = max_steps_per_advance;
+    accumulator = 0.0;
+    last_time = std::chrono::steady_clock::now();
+    steps = 0;
+    dropped_seconds = 0.0;
+}
+
+void FixedTimestep::reset(std::chrono::steady_clock::time_point now)
+{
+    accumulator = 0.0;
+    last_time = now;
+}
+
+uint32_t FixedTimestep::advance(std::chrono::steady_clock::time_point now)
+{
+    accumulator += std::chrono::duration<double>(now - last_time).count();
+    last_time = now;
+
+    uint64_t due = static_cast<uint64_t>(accumulator / step);
+    if(due > max_steps)
+    {
+        dropped_seconds += (due - max_steps) * step;
+        accumulator -= (due - max_steps) * step;
+        due = max_steps;
+    }
+    accumulator -= due * step;
+    steps += due;
+    return static_cast<uint32_t>(due);
+}
+
+double FixedTimestep::alpha() const
+{
+    return std::clamp(accumulator / step, 0.0, 1.0);
+}
+
+void FixedTimestep::printStats() const
+{
+    std::cout << "Simulation: " << steps << " steps of " << step * 1000.0 << " ms, " << dropped_seconds * 1000.0
+        << " ms dropped after stalls" << std::endl;
+}
+
+FrameLimiter::FrameLimiter()
+{
+    rate = 0.0;
+    period = {};
+    next_start = std::chrono::steady_clock::now();
+    lead_seconds = 0.0;
+    frames = 0;
+    held_frames = 0;
+    held_seconds = 0.0;
+}
+
+void FrameLimiter::setRate(double frames_per_second)
+{
+    rate = std::max(frames_per_second, 0.0);
+    period = rate > 0.0 ? std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(1.0 / rate))
+        : std::chrono::steady_clock::duration::zero();
+    next_start = std::chrono::steady_clock::now();
+}
+
+bool FrameLimiter::enabled() const
+{
+    return rate > 0.0;
+}
+
+void FrameLimiter::wait()
+{
+    if(!enabled())
+    {
+        return;
+    }
+    frames++;
+    auto now = std::chrono::steady_clock::now();
+    if(now < next_start)
+    {
+        //Sleep for the bulk of it, the scheduler easily overshoots by a millisecond
+        auto spin = std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(spin_seconds));
+        if(next_start - now > spin)
+        {
+            std::this_thread::sleep_until(next_start - spin);
+        }
+        while(std::chrono::steady_clock::now() < next_start)
+        {
+            std::this_thread::yield();
+        }
+        held_frames++;
+        held_seconds += std::chrono::duration<double>(next_start - now).count();
+        now = next_start;
+    }
+    //A frame that ran late starts the schedule over instead of rushing the next ones to catch up
+    next_start = std::max(next_start + period, now);
+}
+
+void FrameLimiter::presented(std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point display,
+    uint32_t frames_after)
+{
+    if(!enabled())
+    {
+        return;
+    }
+    double lead = std::chrono::duration<double>(display - start).count();
+    lead_seconds = lead_seconds == 0.0 ? lead : lead_seconds + lead_weight * (lead - lead_seconds);
+    //Start the next frame so that it reaches the screen one period after the frames already started
+    auto lead_duration = std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(lead_seconds));
+    next_start = display + period * (frames_after + 1) - lead_duration;
+}
+
+void FrameLimiter::printStats() const
+{
+    if(!enabled())
+    {
+        return;
+    }
+    std::cout << "Frame limiter: " << rate << " fps cap, " << held_frames << " of " << frames << " frames held back for "
+        << held_seconds * 1000.0 << " ms in total" << std::endl;
+}
+
+LatencyTracker::LatencyTracker()
+{
+    buckets.assign(bucket_count + 1, 0);
+    samples = 0;
+    max_ms = 0.0;
+}
+
+void LatencyTracker::record(double latency_ms)
+{
+    uint32_t bucket = static_cast<uint32_t>(std::min(std::max(latency_ms, 0.0) / bucket_ms, static_cast<double>(bucket_count)));
+    buckets[bucket]++;
+    samples++;
+    max_ms = std::max(max_ms, latency_ms);
+}
+
+void LatencyTracker::printStats(const char* name) const
+{
+    if(samples == 0)
+    {
+        std::cout << name << ": no input" << std::endl;
+        return;
+    }
+    auto percentile = [this](double p)
+    {
+        uint64_t rank = std::min(samples - 1, static_cast<uint64_t>(samples * p));
+        uint64_t seen = 0;
+        for(uint32_t i = 0; i < bucket_count; i++)
+        {
+            seen += buckets[i];
+            if(seen > rank)
+            {
+                return std::min((i + 1) * bucket_ms, max_ms);
+            }
+        }
+        return max_ms;
+    };
+
+    std::cout << name << " over " << samples << " inputs (ms): p50 " << percentile(0.5)
+        << " p90 " << percentile(0.9) << " p99 " << percentile(0.99) << " max " << max_ms << std::endl;
+}
@@ -0,0 +1,124 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+//Input the render side acts on, stamped with when SDL received it
+struct InputEvent
+{
+    enum class Type : uint8_t
+    {
+        Quit,
+        Resize,
+        Minimized,
+        Restored,
+        TogglePause,
+        //Anything else the user did, only measured for latency
+        Other
+    };
+
+    Type type = Type::Other;
+    std::chrono::steady_clock::time_point time = {};
+};
+
+//Fixed size ring between exactly one producer, the event thread, and one consumer, the render thread.
+//Each side only stores its own index, so neither ever blocks the other.
+class InputQueue
+{
+    public:
+        //Rounded up to a power of two
+        explicit InputQueue(uint32_t);
+
+        //False when the ring is full, the event is dropped
+        bool push(const InputEvent&);
+        bool pop(InputEvent*);
+        uint64_t dropped() const;
+
+    private:
+        std::vector<InputEvent> events;
+        uint64_t mask;
+        //On their own cache lines, the two threads write them constantly
+        alignas(64) std::atomic<uint64_t> write_index;
+        alignas(64) std::atomic<uint64_t> read_index;
+        std::atomic<uint64_t> dropped_events;
+};
+
+//Advances the simulation in steps of a fixed length, however fast or slow frames are rendered.
+//Frames draw the state part way into the next step, alpha() of the way.
+class FixedTimestep
+{
+    public:
+        FixedTimestep(double, uint32_t);
+
+        void reset(std::chrono::steady_clock::time_point);
+        //Steps due since the last call. After a stall at most max_steps are run and the rest of the time
+        //is dropped, catching up would only make the next frame later still.
+        uint32_t advance(std::chrono::steady_clock::time_point);
+        double alpha() const;
+        void printStats() const;
+
+        double step;
+
+    private:
+        uint32_t max_steps;
+        double accumulator;
+        std::chrono::steady_clock::time_point last_time;
+        uint64_t steps;
+        double dropped_seconds;
+};
+
+//Holds frame starts back to a target rate on the CPU, so no frames are rendered only for the display to drop
+//them. With present feedback the deadlines follow when frames actually reach the screen instead of
+//drifting against it.
+class FrameLimiter
+{
+    public:
+        FrameLimiter();
+
+        //Frames per second, 0 turns the limiter off
+        void setRate(double);
+        bool enabled() const;
+        //Sleeps until the next frame may start
+        void wait();
+        //A frame that started at the first time was on screen at the second, and this many frames started after it
+        void presented(std::chrono::steady_clock::time_point, std::chrono::steady_clock::time_point, uint32_t);
+        void printStats() const;
+
+    private:
+        //Sleeping is only trusted up to this close to the deadline, the rest is spent yielding
+        static constexpr double spin_seconds = 0.001;
+        //Weight of the newest sample in the start to display average
+        static constexpr double lead_weight = 0.1;
+
+        double rate;
+        std::chrono::steady_clock::duration period;
+        std::chrono::steady_clock::time_point next_start;
+        //Average time from a frame's start to it being displayed
+        double lead_seconds;
+        uint64_t frames;
+        uint64_t held_frames;
+        double held_seconds;
+};
+
+//Time from an input event to the present of the first frame that simulated it, or to that frame reaching
+//the screen where present feedback is available. Samples go into a fixed histogram, so a session of any
+//length takes the same memory.
+class LatencyTracker
+{
+    public:
+        LatencyTracker();
+
+        void record(double);
+        void printStats(const char*) const;
+
+    private:
+        //Percentiles are read to the bucket's upper edge, latencies past the last bucket only count towards the max
+        static constexpr uint32_t bucket_count = 10000;
+        static constexpr double bucket_ms = 0.1;
+
+        std::vector<uint64_t> buckets;
+        uint64_t samples;
+        double max_ms;
+};
@@ -0,0 +1,275 @@
+#include "frame_trace.h"
+
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+
+TraceBuffer::TraceBuffer(uint32_t capacity)
+{
+    thread_id = 0;
+    events.resize(capacity);
+    write_index = 0;
+    claim_index = 0;
+}
+
+void TraceBuffer::push(const TraceEvent& event)
+{
+    uint64_t index = write_index.load(std::memory_order_relaxed);
+    claim_index.store(index + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    events[index % events.size()] = event;
+    write_index.store(index + 1, std::memory_order_release);
+}
+
+std::vector<TraceEvent> TraceBuffer::snapshot() const
+{
+    uint64_t end = write_index.load(std::memory_order_acquire);
+    uint64_t begin = end > events.size() ? end - events.size() : 0;
+
+    std::vector<TraceEvent> result = {};
+    result.reserve(end - begin);
+    for(uint64_t i = begin; i < end; i++)
+    {
+        result.push_back(events[i % events.size()]);
+    }
+
+    //Events the writer has claimed slots over since then may have been copied half written
+    std::atomic_thread_fence(std::memory_order_acquire);
+    uint64_t claimed = claim_index.load(std::memory_order_relaxed);
+    uint64_t first_valid = claimed > events.size() ? claimed - events.size() : 0;
+    if(first_valid > begin)
+    {
+        result.erase(result.begin(), result.begin() + std::min(first_valid - begin, end - begin));
+    }
+    return result;
+}
+
+FrameTrace& FrameTrace::get()
+{
+    static FrameTrace trace;
+    return trace;
+}
+
+FrameTrace::FrameTrace()
+{
+    enabled = true;
+    epoch = std::chrono::steady_clock::now();
+    current_frame = 0;
+    render_thread_buffer = nullptr;
+    frame_start_ns = 0;
+    pending = {};
+    last_frame = {};
+    frame_count = 0;
+    gpu_bound = 0;
+    present_bound = 0;
+    cpu_bound = 0;
+    stutters = 0;
+    max_frame_ms = 0.0;
+    histogram.assign(histogram_bucket_count + 1, 0);
+    percentile_histogram.assign(percentile_bucket_count + 1, 0);
+    recent_frame_ms = {};
+}
+
+uint64_t FrameTrace::nowNs() const
+{
+    //Offset by one so a valid timestamp is never 0
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch).count() + 1;
+}
+
+TraceBuffer* FrameTrace::threadBuffer()
+{
+    //Only the first event on each thread takes the lock
+    thread_local TraceBuffer* buffer = nullptr;
+    if(buffer == nullptr)
+    {
+        std::lock_guard<std::mutex> lock(buffers_mutex);
+        buffers.push_back(std::make_unique<TraceBuffer>(events_per_thread));
+        buffer = buffers.back().get();
+        buffer->thread_id = static_cast<uint32_t>(buffers.size());
+    }
+    return buffer;
+}
+
+uint32_t& FrameTrace::scopeDepth()
+{
+    thread_local uint32_t depth = 0;
+    return depth;
+}
+
+void FrameTrace::record(const char* name, uint64_t start_ns, uint64_t duration_ns, TraceCategory category, bool top_level)
+{
+    TraceEvent event = {};
+    event.name = name;
+    event.start_ns = start_ns;
+    event.duration_ns = duration_ns;
+    event.frame = current_frame.load(std::memory_order_relaxed);
+    event.category = category;
+    TraceBuffer* buffer = threadBuffer();
+    buffer->push(event);
+
+    //Scopes recorded on the render thread feed the per-frame breakdown
+    double ms = duration_ns / 1000000.0;
+    if(top_level && buffer == render_thread_buffer.load(std::memory_order_relaxed))
+    {
+        switch(category)
+        {
+            case TraceCategory::Cpu:
+                pending.cpu_ms += ms;
+                break;
+            case TraceCategory::GpuWait:
+                pending.gpu_wait_ms += ms;
+                break;
+            case TraceCategory::PresentWait:
+                pending.present_wait_ms += ms;
+                break;
+        }
+    }
+}
+
+void FrameTrace::endFrame()
+{
+    if(!enabled.load(std::memory_order_relaxed))
+    {
+        return;
+    }
+
+    //Whichever thread ends frames owns the frame breakdown
+    render_thread_buffer.store(threadBuffer(), std::memory_order_relaxed);
+
+    uint64_t now = nowNs();
+    if(frame_start_ns != 0)
+    {
+        pending.frame = current_frame.load(std::memory_order_relaxed);
+        pending.frame_ms = (now - frame_start_ns) / 1000000.0;
+
+        //A stutter is a frame well above the recent median
+        if(recent_frame_ms.size() >= stutter_window / 4)
+        {
+            std::vector<double> sorted = recent_frame_ms;
+            std::nth_element(sorted.begin(), sorted.begin() + sorted.size() / 2, sorted.end());
+            double median = sorted[sorted.size() / 2];
+            pending.stutter = pending.frame_ms > 2.0 * median && pending.frame_ms - median > 1.0;
+        }
+        if(recent_frame_ms.size() == stutter_window)
+        {
+            recent_frame_ms.erase(recent_frame_ms.begin());
+        }
+        recent_frame_ms.push_back(pending.frame_ms);
+
+        uint32_t bucket = std::min(histogram_bucket_count, static_cast<uint32_t>(pending.frame_ms / histogram_bucket_ms));
+        histogram[bucket]++;
+        uint32_t percentile_bucket = std::min(percentile_bucket_count, static_cast<uint32_t>(pending.frame_ms / percentile_bucket_ms));
+        percentile_histogram[percentile_bucket]++;
+
+        //Attribute each frame to whichever kind of time dominated it
+        if(pending.gpu_wait_ms >= pending.cpu_ms && pending.gpu_wait_ms >= pending.present_wait_ms)
+        {
+            gpu_bound++;
+        }
+        else if(pending.present_wait_ms >= pending.cpu_ms)
+        {
+            present_bound++;
+        }
+        else
+        {
+            cpu_bound++;
+        }
+        stutters += pending.stutter ? 1 : 0;
+        max_frame_ms = std::max(max_frame_ms, pending.frame_ms);
+        frame_count++;
+
+        last_frame = pending;
+
+        TraceEvent event = {};
+        event.name = "frame";
+        event.start_ns = frame_start_ns;
+        event.duration_ns = now - frame_start_ns;
+        event.frame = pending.frame;
+        threadBuffer()->push(event);
+    }
+
+    pending = {};
+    frame_start_ns = now;
+    current_frame.fetch_add(1, std::memory_order_relaxed);
+}
+
+FrameTiming FrameTrace::lastFrame() const
+{
+    return last_frame;
+}
+
+void FrameTrace::printReport() const
+{
+    if(frame_count == 0)
+    {
+        return;
+    }
+
+    //Upper edge of the bucket the percentile falls into
+    auto percentile = [this](double p)
+    {
+        uint64_t rank = std::min(frame_count - 1, static_cast<uint64_t>(frame_count * p));
+        uint64_t seen = 0;
+        for(uint32_t i = 0; i < percentile_bucket_count; i++)
+        {
+            seen += percentile_histogram[i];
+            if(seen > rank)
+            {
+                return std::min((i + 1) * percentile_bucket_ms, max_frame_ms);
+            }
+        }
+        return max_frame_ms;
+    };
+
+    std::cout << "CPU frame times over " << frame_count << " frames (ms): p50 " << percentile(0.5)
+        << " p90 " << percentile(0.9) << " p99 " << percentile(0.99) << " max " << max_frame_ms << std::endl;
+    std::cout << "  GPU bound: " << gpu_bound << " present bound: " << present_bound << " CPU bound: " << cpu_bound
+        << " stutters: " << stutters << std::endl;
+    std::cout << "  Histogram:" << std::endl;
+    for(uint32_t i = 0; i <= histogram_bucket_count; i++)
+    {
+        if(histogram[i] == 0)
+        {
+            continue;
+        }
+        std::cout << "    ";
+        if(i == histogram_bucket_count)
+        {
+            std::cout << ">= " << i * histogram_bucket_ms;
+        }
+        else
+        {
+            std::cout << i * histogram_bucket_ms << "-" << (i + 1) * histogram_bucket_ms;
+        }
+        std::cout << " ms: " << histogram[i] << std::endl;
+    }
+}
+
+bool FrameTrace::writeChromeTrace(const std::string& file_name) const
+{
+    std::ofstream file(file_name, std::ios::trunc);
+    if(!file.is_open())
+    {
+        std::cout << "Failed to open file: " << file_name << std::endl;
+        return false;
+    }
+
+    static const char* category_names[] = {"cpu", "gpu_wait", "present_wait"};
+
+    std::lock_guard<std::mutex> lock(buffers_mutex);
+    file << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n";
+    bool first = true;
+    for(const auto& buffer : buffers)
+    {
+        for(const auto& event : buffer->snapshot())
+        {
+            file << (first ? "" : ",\n") << "{\"name\": \"" << event.name << "\", \"cat\": \""
+                << category_names[static_cast<uint8_t>(event.category)] << "\", \"ph\": \"X\", \"ts\": "
+                << event.start_ns / 1000.0 << ", \"dur\": " << event.duration_ns / 1000.0
+                << ", \"pid\": 1, \"tid\": " << buffer->thread_id << ", \"args\": {\"frame\": " << event.frame << "}}";
+            first = false;
+        }
+    }
+    file << "\n]}\n";
+    return file.good();
+}
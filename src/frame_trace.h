@@ -0,0 +1,140 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+//What a timed scope spends its time on, used to tell GPU-, present- and CPU-bound frames apart
+enum class TraceCategory : uint8_t
+{
+    Cpu,
+    GpuWait,
+    PresentWait
+};
+
+struct TraceEvent
+{
+    const char* name = nullptr;
+    uint64_t start_ns = 0;
+    uint64_t duration_ns = 0;
+    uint64_t frame = 0;
+    TraceCategory category = TraceCategory::Cpu;
+};
+
+//Fixed size ring of events written by exactly one thread.
+//Writing claims the slot, stores the event and releases the write index, no locks on the hot path.
+class TraceBuffer
+{
+    public:
+        explicit TraceBuffer(uint32_t);
+
+        void push(const TraceEvent&);
+        //Oldest to newest copy of the events still in the ring, leaving out any the writer was overwriting
+        //while they were copied
+        std::vector<TraceEvent> snapshot() const;
+
+        uint32_t thread_id;
+
+    private:
+        std::vector<TraceEvent> events;
+        std::atomic<uint64_t> write_index;
+        //One past the event being written, ahead of write_index while a push is under way
+        std::atomic<uint64_t> claim_index;
+};
+
+struct FrameTiming
+{
+    uint64_t frame = 0;
+    double frame_ms = 0.0;
+    double cpu_ms = 0.0;
+    double gpu_wait_ms = 0.0;
+    double present_wait_ms = 0.0;
+    bool stutter = false;
+};
+
+class FrameTrace
+{
+    public:
+        static FrameTrace& get();
+
+        uint64_t nowNs() const;
+        //Only top level scopes count towards the frame breakdown, nested ones are already inside them
+        void record(const char*, uint64_t, uint64_t, TraceCategory, bool);
+        //ScopedTimers open on the calling thread
+        static uint32_t& scopeDepth();
+        //Called once per frame from the render thread, closes the frame and classifies it
+        void endFrame();
+
+        //The frame the last endFrame closed
+        FrameTiming lastFrame() const;
+        void printReport() const;
+        bool writeChromeTrace(const std::string&) const;
+
+        std::atomic<bool> enabled;
+
+    private:
+        FrameTrace();
+        TraceBuffer* threadBuffer();
+
+        static constexpr uint32_t events_per_thread = 1 << 16;
+        static constexpr uint32_t histogram_bucket_count = 100;
+        static constexpr double histogram_bucket_ms = 0.5;
+        static constexpr size_t stutter_window = 64;
+        //Finer histogram the percentiles are read from, frames past its end count towards the max only
+        static constexpr uint32_t percentile_bucket_count = 10000;
+        static constexpr double percentile_bucket_ms = 0.01;
+
+        std::chrono::steady_clock::time_point epoch;
+        mutable std::mutex buffers_mutex;
+        std::vector<std::unique_ptr<TraceBuffer>> buffers;
+
+        //Render thread only
+        std::atomic<uint64_t> current_frame;
+        std::atomic<TraceBuffer*> render_thread_buffer;
+        uint64_t frame_start_ns;
+        FrameTiming pending;
+        FrameTiming last_frame;
+        uint64_t frame_count;
+        uint64_t gpu_bound;
+        uint64_t present_bound;
+        uint64_t cpu_bound;
+        uint64_t stutters;
+        double max_frame_ms;
+        std::vector<uint32_t> histogram;
+        std::vector<uint32_t> percentile_histogram;
+        std::vector<double> recent_frame_ms;
+};
+
+//Times the enclosing scope into the calling thread's trace buffer
+class ScopedTimer
+{
+    public:
+        ScopedTimer(const char* name, TraceCategory category = TraceCategory::Cpu)
+        {
+            this->name = name;
+            this->category = category;
+            start_ns = FrameTrace::get().enabled.load(std::memory_order_relaxed) ? FrameTrace::get().nowNs() : 0;
+            top_level = FrameTrace::scopeDepth()++ == 0;
+        }
+        ~ScopedTimer()
+        {
+            if(start_ns != 0)
+            {
+                FrameTrace& trace = FrameTrace::get();
+                trace.record(name, start_ns, trace.nowNs() - start_ns, category, top_level);
+            }
+            FrameTrace::scopeDepth()--;
+        }
+        ScopedTimer(const ScopedTimer&) = delete;
+        ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+    private:
+        const char* name;
+        TraceCategory category;
+        uint64_t start_ns;
+        bool top_level;
+};
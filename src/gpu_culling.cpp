@@ -0,0 +1,626 @@
+#include "gpu_culling.h"
+
+#include <iostream>
+#include <algorithm>
+#include <cstring>
+
+static constexpr uint32_t cull_group_size = 64;
+static constexpr uint32_t pyramid_group_size = 8;
+
+//Layouts come from reflecting the shader, shared through the layout cache
+static bool createComputePipeline(VkDevice device, VkPipelineCache pipeline_cache, AssetLoader* assets, LayoutCache* layouts,
+    const char* path, LayoutCache::Layout* layout, VkPipeline* pipeline)
+{
+    AssetSpan code = {};
+    ShaderReflection reflection = {};
+    if(!assets->load(path, &code) || !ShaderReflection::reflect(code, &reflection) || !layouts->getLayout({&reflection}, layout))
+    {
+        return false;
+    }
+    if(layout->set_layouts.size() != 1)
+    {
+        std::cout << "Compute shader " << path << " has to use exactly descriptor set 0!" << std::endl;
+        return false;
+    }
+
+    VkShaderModuleCreateInfo create_info = {};
+    create_info.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+    create_info.codeSize = code.size;
+    create_info.pCode = code.words();
+    VkShaderModule shader_module = VK_NULL_HANDLE;
+    if(vkCreateShaderModule(device, &create_info, nullptr, &shader_module) != VK_SUCCESS)
+    {
+        std::cout << "Failed to create shader module " << path << "!" << std::endl;
+        return false;
+    }
+
+    VkComputePipelineCreateInfo pipeline_info = {};
+    pipeline_info.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipeline_info.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    pipeline_info.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    pipeline_info.stage.module = shader_module;
+    pipeline_info.stage.pName = "main";
+    pipeline_info.layout = layout->pipeline_layout;
+
+    VkResult result = vkCreateComputePipelines(device, pipeline_cache, 1, &pipeline_info, nullptr, pipeline);
+    vkDestroyShaderModule(device, shader_module, nullptr);
+    if(result != VK_SUCCESS)
+    {
+        std::cout << "Failed to create compute pipeline " << path << "!" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+GpuCulling::GpuCulling()
+{
+    compact = false;
+    draw_buffers = {};
+    count_buffers = {};
+    object_count = 0;
+    stats = {};
+    device = VK_NULL_HANDLE;
+    allocator = nullptr;
+    defer = {};
+    queue_families = {};
+    cull_set_layout = VK_NULL_HANDLE;
+    cull_pipeline_layout = VK_NULL_HANDLE;
+    cull_pipeline = VK_NULL_HANDLE;
+    pyramid_set_layout = VK_NULL_HANDLE;
+    pyramid_pipeline_layout = VK_NULL_HANDLE;
+    pyramid_pipeline = VK_NULL_HANDLE;
+    depth_sampler = VK_NULL_HANDLE;
+    descriptor_pool = VK_NULL_HANDLE;
+    cull_sets = {};
+    pyramid_sets = {};
+    instance_buffer = VK_NULL_HANDLE;
+    index_count = 0;
+    mesh_extent = 0.0f;
+    draw_allocations = {};
+    count_allocations = {};
+    depth_view = VK_NULL_HANDLE;
+    depth_extent = {};
+    pyramid_image = VK_NULL_HANDLE;
+    pyramid_allocation = {};
+    pyramid_view = VK_NULL_HANDLE;
+    pyramid_mip_views = {};
+    pyramid_extents = {};
+    pyramid_valid = false;
+    pyramid_needs_layout = false;
+    readback_buffer = VK_NULL_HANDLE;
+    readback_allocation = {};
+    slot_submitted = {};
+}
+
+bool GpuCulling::init(VkDevice logical_device, DeviceAllocator* device_allocator, AssetLoader* assets, LayoutCache* layouts,
+    VkPipelineCache pipeline_cache, uint32_t frames_in_flight, bool compact_draws, const std::vector<uint32_t>& sharing_families, DeferFunction defer_function)
+{
+    device = logical_device;
+    allocator = device_allocator;
+    compact = compact_draws;
+    queue_families = sharing_families;
+    defer = std::move(defer_function);
+
+    if(!createPipelines(assets, layouts, pipeline_cache))
+    {
+        return false;
+    }
+
+    VkSamplerCreateInfo sampler_info = {};
+    sampler_info.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    sampler_info.magFilter = VK_FILTER_NEAREST;
+    sampler_info.minFilter = VK_FILTER_NEAREST;
+    sampler_info.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+    sampler_info.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    sampler_info.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    sampler_info.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    sampler_info.maxLod = VK_LOD_CLAMP_NONE;
+    if(vkCreateSampler(device, &sampler_info, nullptr, &depth_sampler) != VK_SUCCESS)
+    {
+        std::cout << "Failed to create depth pyramid sampler!" << std::endl;
+        return false;
+    }
+
+    //The count is copied into a host visible slot per frame, so reading it never stalls the GPU
+    VkBufferCreateInfo buffer_info = {};
+    buffer_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    buffer_info.size = 16;
+    buffer_info.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT
+        | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+    setSharingMode(&buffer_info.sharingMode, &buffer_info.queueFamilyIndexCount, &buffer_info.pQueueFamilyIndices);
+    count_buffers.assign(frames_in_flight, VK_NULL_HANDLE);
+    count_allocations.assign(frames_in_flight, {});
+    draw_buffers.assign(frames_in_flight, VK_NULL_HANDLE);
+    draw_allocations.assign(frames_in_flight, {});
+    for(uint32_t slot = 0; slot < frames_in_flight; slot++)
+    {
+        if(!allocator->createBuffer(buffer_info, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 0, &count_buffers[slot], &count_allocations[slot]))
+        {
+            std::cout << "Failed to create draw count buffer!" << std::endl;
+            return false;
+        }
+    }
+
+    buffer_info.size = sizeof(uint32_t) * frames_in_flight;
+    buffer_info.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    if(!allocator->createBuffer(buffer_info, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+        VK_MEMORY_PROPERTY_HOST_CACHED_BIT, &readback_buffer, &readback_allocation))
+    {
+        std::cout << "Failed to create cull readback buffer!" << std::endl;
+        return false;
+    }
+    memset(readback_allocation.mapped, 0, buffer_info.size);
+    slot_submitted.assign(frames_in_flight, 0);
+
+    return true;
+}
+
+void GpuCulling::setSharingMode(VkSharingMode* sharing_mode, uint32_t* family_count, const uint32_t** families) const
+{
+    //Culling on its own queue family shares everything with graphics instead of transferring ownership
+    //back and forth every frame
+    if(queue_families.size() > 1)
+    {
+        *sharing_mode = VK_SHARING_MODE_CONCURRENT;
+        *family_count = static_cast<uint32_t>(queue_families.size());
+        *families = queue_families.data();
+    }
+    else
+    {
+        *sharing_mode = VK_SHARING_MODE_EXCLUSIVE;
+        *family_count = 0;
+        *families = nullptr;
+    }
+}
+
+bool GpuCulling::createPipelines(AssetLoader* assets, LayoutCache* layouts, VkPipelineCache pipeline_cache)
+{
+    LayoutCache::Layout cull_layout = {};
+    LayoutCache::Layout pyramid_layout = {};
+    if(!createComputePipeline(device, pipeline_cache, assets, layouts, "shaders/cull.spv", &cull_layout, &cull_pipeline)
+        || !createComputePipeline(device, pipeline_cache, assets, layouts, "shaders/hiz.spv", &pyramid_layout, &pyramid_pipeline))
+    {
+        return false;
+    }
+    if(cull_layout.push_constants.size < sizeof(CullParams))
+    {
+        std::cout << "Cull shader push constants are smaller than CullParams!" << std::endl;
+        return false;
+    }
+    cull_set_layout = cull_layout.set_layouts[0];
+    cull_pipeline_layout = cull_layout.pipeline_layout;
+    pyramid_set_layout = pyramid_layout.set_layouts[0];
+    pyramid_pipeline_layout = pyramid_layout.pipeline_layout;
+    return true;
+}
+
+void GpuCulling::destroy()
+{
+    if(device == VK_NULL_HANDLE)
+    {
+        return;
+    }
+
+    defer = [](std::function<void()> destroy_function) { destroy_function(); };
+    releasePyramid();
+    if(descriptor_pool != VK_NULL_HANDLE)
+    {
+        vkDestroyDescriptorPool(device, descriptor_pool, nullptr);
+    }
+    for(size_t slot = 0; slot < draw_buffers.size(); slot++)
+    {
+        if(draw_buffers[slot] != VK_NULL_HANDLE)
+        {
+            allocator->destroyBuffer(draw_buffers[slot], draw_allocations[slot]);
+        }
+        if(count_buffers[slot] != VK_NULL_HANDLE)
+        {
+            allocator->destroyBuffer(count_buffers[slot], count_allocations[slot]);
+        }
+    }
+    if(readback_buffer != VK_NULL_HANDLE)
+    {
+        allocator->destroyBuffer(readback_buffer, readback_allocation);
+    }
+    vkDestroySampler(device, depth_sampler, nullptr);
+    vkDestroyPipeline(device, cull_pipeline, nullptr);
+    vkDestroyPipeline(device, pyramid_pipeline, nullptr);
+    device = VK_NULL_HANDLE;
+}
+
+bool GpuCulling::setObjects(VkBuffer instances, uint32_t count, uint32_t mesh_index_count, float mesh_half_extent)
+{
+    instance_buffer = instances;
+    object_count = count;
+    index_count = mesh_index_count;
+    mesh_extent = mesh_half_extent;
+
+    //Worst case every object is visible and gets its own command
+    VkBufferCreateInfo buffer_info = {};
+    buffer_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    buffer_info.size = sizeof(VkDrawIndexedIndirectCommand) * std::max(object_count, 1u);
+    buffer_info.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT;
+    setSharingMode(&buffer_info.sharingMode, &buffer_info.queueFamilyIndexCount, &buffer_info.pQueueFamilyIndices);
+    for(size_t slot = 0; slot < draw_buffers.size(); slot++)
+    {
+        if(draw_buffers[slot] != VK_NULL_HANDLE)
+        {
+            DeviceAllocator* allocator_ptr = allocator;
+            VkBuffer old_buffer = draw_buffers[slot];
+            MemoryAllocation old_allocation = draw_allocations[slot];
+            defer([allocator_ptr, old_buffer, old_allocation]() mutable
+            {
+                allocator_ptr->destroyBuffer(old_buffer, old_allocation);
+            });
+            draw_buffers[slot] = VK_NULL_HANDLE;
+        }
+        if(!allocator->createBuffer(buffer_info, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 0, &draw_buffers[slot], &draw_allocations[slot]))
+        {
+            std::cout << "Failed to create culled draw buffer!" << std::endl;
+            return false;
+        }
+    }
+
+    return updateDescriptors();
+}
+
+bool GpuCulling::setDepthBuffer(VkImageView view, VkExtent2D extent)
+{
+    //Rebuilding the render graph keeps the depth buffer unless its size changed
+    if(view == depth_view && extent.width == depth_extent.width && extent.height == depth_extent.height)
+    {
+        return true;
+    }
+    depth_view = view;
+    depth_extent = extent;
+    releasePyramid();
+    if(!createPyramid(extent))
+    {
+        return false;
+    }
+    return updateDescriptors();
+}
+
+void GpuCulling::releasePyramid()
+{
+    if(pyramid_image == VK_NULL_HANDLE)
+    {
+        return;
+    }
+
+    VkDevice device_handle = device;
+    DeviceAllocator* allocator_ptr = allocator;
+    VkImage old_image = pyramid_image;
+    MemoryAllocation old_allocation = pyramid_allocation;
+    std::vector<VkImageView> old_views = pyramid_mip_views;
+    old_views.push_back(pyramid_view);
+    defer([device_handle, allocator_ptr, old_image, old_allocation, old_views]() mutable
+    {
+        for(auto view : old_views)
+        {
+            vkDestroyImageView(device_handle, view, nullptr);
+        }
+        allocator_ptr->destroyImage(old_image, old_allocation);
+    });
+
+    pyramid_image = VK_NULL_HANDLE;
+    pyramid_view = VK_NULL_HANDLE;
+    pyramid_mip_views.clear();
+    pyramid_extents.clear();
+    pyramid_valid = false;
+}
+
+bool GpuCulling::createPyramid(VkExtent2D extent)
+{
+    //Level 0 is half the depth buffer, every texel of a level is the farthest depth of the 2x2 below it
+    VkExtent2D level_extent = {std::max((extent.width + 1) / 2, 1u), std::max((extent.height + 1) / 2, 1u)};
+    while(true)
+    {
+        pyramid_extents.push_back(level_extent);
+        if(level_extent.width == 1 && level_extent.height == 1)
+        {
+            break;
+        }
+        level_extent = {std::max((level_extent.width + 1) / 2, 1u), std::max((level_extent.height + 1) / 2, 1u)};
+    }
+    uint32_t level_count = static_cast<uint32_t>(pyramid_extents.size());
+
+    VkImageCreateInfo image_info = {};
+    image_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    image_info.imageType = VK_IMAGE_TYPE_2D;
+    image_info.format = VK_FORMAT_R32_SFLOAT;
+    image_info.extent = {pyramid_extents[0].width, pyramid_extents[0].height, 1};
+    image_info.mipLevels = level_count;
+    image_info.arrayLayers = 1;
+    image_info.samples = VK_SAMPLE_COUNT_1_BIT;
+    image_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+    image_info.usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+    setSharingMode(&image_info.sharingMode, &image_info.queueFamilyIndexCount, &image_info.pQueueFamilyIndices);
+    image_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    if(!allocator->createImage(image_info, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 0, &pyramid_image, &pyramid_allocation))
+    {
+        std::cout << "Failed to create depth pyramid!" << std::endl;
+        return false;
+    }
+
+    VkImageViewCreateInfo view_info = {};
+    view_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    view_info.image = pyramid_image;
+    view_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    view_info.format = VK_FORMAT_R32_SFLOAT;
+    view_info.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    view_info.subresourceRange.baseMipLevel = 0;
+    view_info.subresourceRange.levelCount = level_count;
+    view_info.subresourceRange.baseArrayLayer = 0;
+    view_info.subresourceRange.layerCount = 1;
+    if(vkCreateImageView(device, &view_info, nullptr, &pyramid_view) != VK_SUCCESS)
+    {
+        std::cout << "Failed to create depth pyramid view!" << std::endl;
+        return false;
+    }
+
+    pyramid_mip_views.resize(level_count, VK_NULL_HANDLE);
+    for(uint32_t level = 0; level < level_count; level++)
+    {
+        view_info.subresourceRange.baseMipLevel = level;
+        view_info.subresourceRange.levelCount = 1;
+        if(vkCreateImageView(device, &view_info, nullptr, &pyramid_mip_views[level]) != VK_SUCCESS)
+        {
+            std::cout << "Failed to create depth pyramid level view!" << std::endl;
+            return false;
+        }
+    }
+
+    pyramid_valid = false;
+    pyramid_needs_layout = true;
+    return true;
+}
+
+bool GpuCulling::updateDescriptors()
+{
+    //Wait until both halves exist
+    if(draw_buffers.empty() || draw_buffers[0] == VK_NULL_HANDLE || pyramid_image == VK_NULL_HANDLE)
+    {
+        return true;
+    }
+
+    //Sets bound by frames in flight can't be rewritten, build a fresh pool and retire the old one
+    if(descriptor_pool != VK_NULL_HANDLE)
+    {
+        VkDevice device_handle = device;
+        VkDescriptorPool old_pool = descriptor_pool;
+        defer([device_handle, old_pool]()
+        {
+            vkDestroyDescriptorPool(device_handle, old_pool, nullptr);
+        });
+        descriptor_pool = VK_NULL_HANDLE;
+    }
+
+    uint32_t level_count = static_cast<uint32_t>(pyramid_mip_views.size());
+    uint32_t slot_count = static_cast<uint32_t>(draw_buffers.size());
+    VkDescriptorPoolSize pool_sizes[3] = {};
+    pool_sizes[0].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    pool_sizes[0].descriptorCount = 3 * slot_count;
+    pool_sizes[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    pool_sizes[1].descriptorCount = slot_count + level_count;
+    pool_sizes[2].type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+    pool_sizes[2].descriptorCount = level_count;
+
+    VkDescriptorPoolCreateInfo pool_info = {};
+    pool_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    pool_info.maxSets = slot_count + level_count;
+    pool_info.poolSizeCount = 3;
+    pool_info.pPoolSizes = pool_sizes;
+    if(vkCreateDescriptorPool(device, &pool_info, nullptr, &descriptor_pool) != VK_SUCCESS)
+    {
+        std::cout << "Failed to create culling descriptor pool!" << std::endl;
+        return false;
+    }
+
+    //A cull set per frame slot first, then one per pyramid level
+    std::vector<VkDescriptorSetLayout> set_layouts(slot_count + level_count, pyramid_set_layout);
+    std::fill(set_layouts.begin(), set_layouts.begin() + slot_count, cull_set_layout);
+    std::vector<VkDescriptorSet> sets(set_layouts.size());
+    VkDescriptorSetAllocateInfo alloc_info = {};
+    alloc_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    alloc_info.descriptorPool = descriptor_pool;
+    alloc_info.descriptorSetCount = static_cast<uint32_t>(set_layouts.size());
+    alloc_info.pSetLayouts = set_layouts.data();
+    if(vkAllocateDescriptorSets(device, &alloc_info, sets.data()) != VK_SUCCESS)
+    {
+        std::cout << "Failed to allocate culling descriptor sets!" << std::endl;
+        return false;
+    }
+    cull_sets.assign(sets.begin(), sets.begin() + slot_count);
+    pyramid_sets.assign(sets.begin() + slot_count, sets.end());
+
+    std::vector<VkDescriptorBufferInfo> buffer_infos(3 * slot_count);
+    for(uint32_t slot = 0; slot < slot_count; slot++)
+    {
+        buffer_infos[3 * slot].buffer = instance_buffer;
+        buffer_infos[3 * slot].range = VK_WHOLE_SIZE;
+        buffer_infos[3 * slot + 1].buffer = draw_buffers[slot];
+        buffer_infos[3 * slot + 1].range = VK_WHOLE_SIZE;
+        buffer_infos[3 * slot + 2].buffer = count_buffers[slot];
+        buffer_infos[3 * slot + 2].range = VK_WHOLE_SIZE;
+    }
+
+    VkDescriptorImageInfo pyramid_info = {};
+    pyramid_info.sampler = depth_sampler;
+    pyramid_info.imageView = pyramid_view;
+    pyramid_info.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+    //Level 0 reads the depth buffer, every other level the one above it
+    std::vector<VkDescriptorImageInfo> source_infos(level_count);
+    std::vector<VkDescriptorImageInfo> target_infos(level_count);
+    for(uint32_t level = 0; level < level_count; level++)
+    {
+        source_infos[level].sampler = depth_sampler;
+        source_infos[level].imageView = level == 0 ? depth_view : pyramid_mip_views[level - 1];
+        source_infos[level].imageLayout = level == 0 ? VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_GENERAL;
+        target_infos[level].imageView = pyramid_mip_views[level];
+        target_infos[level].imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+    }
+
+    std::vector<VkWriteDescriptorSet> writes = {};
+    for(uint32_t slot = 0; slot < slot_count; slot++)
+    {
+        for(uint32_t i = 0; i < 4; i++)
+        {
+            VkWriteDescriptorSet write = {};
+            write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            write.dstSet = cull_sets[slot];
+            write.dstBinding = i;
+            write.descriptorCount = 1;
+            write.descriptorType = i < 3 ? VK_DESCRIPTOR_TYPE_STORAGE_BUFFER : VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+            write.pBufferInfo = i < 3 ? &buffer_infos[3 * slot + i] : nullptr;
+            write.pImageInfo = i < 3 ? nullptr : &pyramid_info;
+            writes.push_back(write);
+        }
+    }
+    for(uint32_t level = 0; level < level_count; level++)
+    {
+        VkWriteDescriptorSet write = {};
+        write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        write.dstSet = pyramid_sets[level];
+        write.dstBinding = 0;
+        write.descriptorCount = 1;
+        write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        write.pImageInfo = &source_infos[level];
+        writes.push_back(write);
+        write.dstBinding = 1;
+        write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+        write.pImageInfo = &target_infos[level];
+        writes.push_back(write);
+    }
+    vkUpdateDescriptorSets(device, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+
+    return true;
+}
+
+void GpuCulling::recordCull(VkCommandBuffer command_buffer, uint32_t slot)
+{
+    if(pyramid_needs_layout)
+    {
+        //Fresh pyramid, move it to the layout it stays in for good
+        VkImageMemoryBarrier barrier = {};
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barrier.srcAccessMask = 0;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+        barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        barrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.image = pyramid_image;
+        barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        barrier.subresourceRange.levelCount = VK_REMAINING_MIP_LEVELS;
+        barrier.subresourceRange.layerCount = 1;
+        vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+            0, 0, nullptr, 0, nullptr, 1, &barrier);
+        pyramid_needs_layout = false;
+    }
+
+    //The slot's buffers were last read by the frame whose fence the caller waited on. The caller orders
+    //the draws after this against the cull: the render graph inline, the timeline semaphores on the async
+    //compute queue.
+    vkCmdFillBuffer(command_buffer, count_buffers[slot], 0, sizeof(uint32_t), 0);
+
+    VkMemoryBarrier fill_barrier = {};
+    fill_barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    fill_barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    fill_barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        0, 1, &fill_barrier, 0, nullptr, 0, nullptr);
+
+    CullParams params = {};
+    params.object_count = object_count;
+    params.index_count = index_count;
+    params.occlusion_enabled = pyramid_valid ? 1 : 0;
+    params.compact = compact ? 1 : 0;
+    params.depth_size[0] = static_cast<float>(depth_extent.width);
+    params.depth_size[1] = static_cast<float>(depth_extent.height);
+    params.pyramid_levels = static_cast<float>(pyramid_extents.size());
+    params.mesh_extent = mesh_extent;
+
+    vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, cull_pipeline);
+    vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, cull_pipeline_layout, 0, 1, &cull_sets[slot], 0, nullptr);
+    vkCmdPushConstants(command_buffer, cull_pipeline_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(params), &params);
+    vkCmdDispatch(command_buffer, (object_count + cull_group_size - 1) / cull_group_size, 1, 1);
+
+    VkMemoryBarrier cull_barrier = {};
+    cull_barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    cull_barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    cull_barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+    vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+        0, 1, &cull_barrier, 0, nullptr, 0, nullptr);
+
+    VkBufferCopy region = {};
+    region.srcOffset = 0;
+    region.dstOffset = sizeof(uint32_t) * slot;
+    region.size = sizeof(uint32_t);
+    vkCmdCopyBuffer(command_buffer, count_buffers[slot], readback_buffer, 1, &region);
+
+    VkMemoryBarrier readback_barrier = {};
+    readback_barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    readback_barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    readback_barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+    vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT,
+        0, 1, &readback_barrier, 0, nullptr, 0, nullptr);
+    slot_submitted[slot] = object_count;
+}
+
+void GpuCulling::recordDepthPyramid(VkCommandBuffer command_buffer)
+{
+    //The render graph already moved the depth buffer to a sampled layout behind its writes
+    vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, pyramid_pipeline);
+    for(size_t level = 0; level < pyramid_extents.size(); level++)
+    {
+        vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, pyramid_pipeline_layout, 0, 1,
+            &pyramid_sets[level], 0, nullptr);
+        vkCmdDispatch(command_buffer, (pyramid_extents[level].width + pyramid_group_size - 1) / pyramid_group_size,
+            (pyramid_extents[level].height + pyramid_group_size - 1) / pyramid_group_size, 1);
+
+        //Each level feeds the next one, and the last one the next frame's cull
+        VkImageMemoryBarrier barrier = {};
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        barrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+        barrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.image = pyramid_image;
+        barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        barrier.subresourceRange.baseMipLevel = static_cast<uint32_t>(level);
+        barrier.subresourceRange.levelCount = 1;
+        barrier.subresourceRange.layerCount = 1;
+        vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+            0, 0, nullptr, 0, nullptr, 1, &barrier);
+    }
+    pyramid_valid = true;
+}
+
+void GpuCulling::readResults(uint32_t slot)
+{
+    if(slot_submitted[slot] == 0)
+    {
+        return;
+    }
+
+    uint32_t visible = 0;
+    memcpy(&visible, static_cast<char*>(readback_allocation.mapped) + sizeof(uint32_t) * slot, sizeof(uint32_t));
+    stats.last_submitted = slot_submitted[slot];
+    stats.last_visible = visible;
+    stats.total_submitted += slot_submitted[slot];
+    stats.total_visible += visible;
+    stats.frames++;
+    slot_submitted[slot] = 0;
+}
+
+void GpuCulling::printStats() const
+{
+    double visible_percent = stats.total_submitted > 0 ? 100.0 * stats.total_visible / stats.total_submitted : 0.0;
+    std::cout << "GPU culling (" << (compact ? "compacted, draw count from GPU" : "not compacted, culled draws have 0 instances") << "): "
+        << stats.last_visible << " of " << stats.last_submitted << " instances visible last frame, "
+        << visible_percent << "% visible on average over " << stats.frames << " frames" << std::endl;
+}
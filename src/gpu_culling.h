@@ -0,0 +1,109 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <vulkan/vulkan.h>
+#include "memory_allocator.h"
+#include "asset_loader.h"
+#include "shader_reflection.h"
+
+//Culls instances on the GPU against the frustum and a hierarchical depth pyramid built from the
+//previous frame's depth buffer, and writes the survivors as indirect draw commands. In compact mode
+//visible draws are appended and counted for vkCmdDrawIndexedIndirectCount, otherwise every object keeps
+//its own command and culled ones get an instanceCount of 0.
+class GpuCulling
+{
+    public:
+        struct Stats
+        {
+            uint32_t last_submitted = 0;
+            uint32_t last_visible = 0;
+            uint64_t total_submitted = 0;
+            uint64_t total_visible = 0;
+            uint64_t frames = 0;
+        };
+
+        GpuCulling();
+
+        //queue_families lists every family touching the culling resources, more than one makes them concurrent
+        bool init(VkDevice, DeviceAllocator*, AssetLoader*, LayoutCache*, VkPipelineCache, uint32_t, bool, const std::vector<uint32_t>&, DeferFunction);
+        //The device must be idle
+        void destroy();
+
+        bool setObjects(VkBuffer, uint32_t, uint32_t, float);
+        bool setDepthBuffer(VkImageView, VkExtent2D);
+
+        //Before the render pass, or on the async compute queue: reset the count, cull, and copy the count out for the stats
+        void recordCull(VkCommandBuffer, uint32_t);
+        //After the render pass: reduce the depth buffer into the pyramid the next frame culls against
+        void recordDepthPyramid(VkCommandBuffer);
+        //Call once the frame slot's fence has signaled
+        void readResults(uint32_t);
+        void printStats() const;
+
+        bool compact;
+        //One of each per frame slot, so a slot's cull never rewrites draws another frame in flight still reads
+        std::vector<VkBuffer> draw_buffers;
+        std::vector<VkBuffer> count_buffers;
+        uint32_t object_count;
+        Stats stats;
+
+    private:
+        struct CullParams
+        {
+            uint32_t object_count;
+            uint32_t index_count;
+            uint32_t occlusion_enabled;
+            uint32_t compact;
+            float depth_size[2];
+            float pyramid_levels;
+            float mesh_extent;
+        };
+
+        bool createPipelines(AssetLoader*, LayoutCache*, VkPipelineCache);
+        void setSharingMode(VkSharingMode*, uint32_t*, const uint32_t**) const;
+        bool createPyramid(VkExtent2D);
+        bool updateDescriptors();
+        void releasePyramid();
+
+        VkDevice device;
+        DeviceAllocator* allocator;
+        DeferFunction defer;
+        std::vector<uint32_t> queue_families;
+
+        //Layouts are reflected from the shaders and owned by the layout cache
+        VkDescriptorSetLayout cull_set_layout;
+        VkPipelineLayout cull_pipeline_layout;
+        VkPipeline cull_pipeline;
+        VkDescriptorSetLayout pyramid_set_layout;
+        VkPipelineLayout pyramid_pipeline_layout;
+        VkPipeline pyramid_pipeline;
+        VkSampler depth_sampler;
+
+        //Rebuilt together whenever the objects or the depth buffer change
+        VkDescriptorPool descriptor_pool;
+        std::vector<VkDescriptorSet> cull_sets;
+        std::vector<VkDescriptorSet> pyramid_sets;
+
+        VkBuffer instance_buffer;
+        uint32_t index_count;
+        float mesh_extent;
+        std::vector<MemoryAllocation> draw_allocations;
+        std::vector<MemoryAllocation> count_allocations;
+
+        VkImageView depth_view;
+        VkExtent2D depth_extent;
+        VkImage pyramid_image;
+        MemoryAllocation pyramid_allocation;
+        VkImageView pyramid_view;
+        std::vector<VkImageView> pyramid_mip_views;
+        std::vector<VkExtent2D> pyramid_extents;
+        //The pyramid only holds usable depth after one frame has built it
+        bool pyramid_valid;
+        bool pyramid_needs_layout;
+
+        //One counter per frame slot, read once the slot's fence has signaled
+        VkBuffer readback_buffer;
+        MemoryAllocation readback_allocation;
+        std::vector<uint32_t> slot_submitted;
+};
@@ -0,0 +1,278 @@
+#include "gpu_profiler.h"
+
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+#include <limits>
+
+GpuProfiler::GpuProfiler()
+{
+    enabled = false;
+    device = VK_NULL_HANDLE;
+    query_pool = VK_NULL_HANDLE;
+    timestamp_period_ns = 1.0;
+    timestamp_mask = 0;
+    frame_count = 0;
+    current_slot = 0;
+}
+
+GpuProfiler::~GpuProfiler()
+{
+    destroy();
+}
+
+bool GpuProfiler::init(VkDevice logical_device, VkPhysicalDevice physical_device, uint32_t queue_family, uint32_t frames_in_flight)
+{
+    device = logical_device;
+
+    uint32_t queue_family_count = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(physical_device, &queue_family_count, nullptr);
+    std::vector<VkQueueFamilyProperties> queue_families(queue_family_count);
+    vkGetPhysicalDeviceQueueFamilyProperties(physical_device, &queue_family_count, queue_families.data());
+
+    uint32_t valid_bits = queue_family < queue_family_count ? queue_families[queue_family].timestampValidBits : 0;
+    if(valid_bits == 0)
+    {
+        std::cout << "Queue family " << queue_family << " doesn't support timestamps, GPU profiling disabled" << std::endl;
+        enabled = false;
+        return true;
+    }
+    timestamp_mask = valid_bits >= 64 ? std::numeric_limits<uint64_t>::max() : ((uint64_t) 1 << valid_bits) - 1;
+
+    VkPhysicalDeviceProperties device_properties = {};
+    vkGetPhysicalDeviceProperties(physical_device, &device_properties);
+    timestamp_period_ns = device_properties.limits.timestampPeriod;
+
+    frame_count = frames_in_flight;
+    VkQueryPoolCreateInfo pool_info = {};
+    pool_info.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    pool_info.queryType = VK_QUERY_TYPE_TIMESTAMP;
+    pool_info.queryCount = max_queries_per_frame * frame_count;
+
+    if(vkCreateQueryPool(device, &pool_info, nullptr, &query_pool) != VK_SUCCESS)
+    {
+        std::cout << "Failed to create timestamp query pool!" << std::endl;
+        return false;
+    }
+
+    queries_used.assign(frame_count, 0);
+    recorded_scopes.assign(frame_count, {});
+    //Timestamp value followed by its availability word
+    query_results.resize(max_queries_per_frame * 2);
+    enabled = true;
+
+    return true;
+}
+
+void GpuProfiler::destroy()
+{
+    if(query_pool != VK_NULL_HANDLE)
+    {
+        vkDestroyQueryPool(device, query_pool, nullptr);
+        query_pool = VK_NULL_HANDLE;
+    }
+    enabled = false;
+}
+
+uint32_t GpuProfiler::scopeId(const char* name)
+{
+    auto it = scope_ids.find(name);
+    if(it != scope_ids.end())
+    {
+        return it->second;
+    }
+
+    uint32_t id = static_cast<uint32_t>(scopes.size());
+    ScopeHistory history = {};
+    history.name = name;
+    history.samples_ms.reserve(history_length);
+    scopes.push_back(std::move(history));
+    scope_ids.emplace(name, id);
+    return id;
+}
+
+void GpuProfiler::readResults(uint32_t slot)
+{
+    if(queries_used[slot] == 0)
+    {
+        return;
+    }
+
+    //The slot's fence has signaled, so this only fails if a query was never written; skip those
+    uint32_t first_query = slot * max_queries_per_frame;
+    VkResult result = vkGetQueryPoolResults(device, query_pool, first_query, queries_used[slot],
+        queries_used[slot] * 2 * sizeof(uint64_t), query_results.data(), 2 * sizeof(uint64_t),
+        VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+    if(result != VK_SUCCESS && result != VK_NOT_READY)
+    {
+        return;
+    }
+
+    for(const auto& recorded : recorded_scopes[slot])
+    {
+        uint32_t begin = recorded.begin_query - first_query;
+        uint32_t end = recorded.end_query - first_query;
+        if(query_results[begin * 2 + 1] == 0 || query_results[end * 2 + 1] == 0)
+        {
+            continue;
+        }
+
+        uint64_t ticks = (query_results[end * 2] - query_results[begin * 2]) & timestamp_mask;
+        double ms = ticks * timestamp_period_ns / 1000000.0;
+
+        ScopeHistory& history = scopes[recorded.scope_id];
+        if(history.samples_ms.size() < history_length)
+        {
+            history.samples_ms.push_back(ms);
+        }
+        else
+        {
+            history.samples_ms[history.next_sample] = ms;
+        }
+        history.next_sample = (history.next_sample + 1) % history_length;
+        history.total_samples++;
+    }
+}
+
+void GpuProfiler::beginFrame(VkCommandBuffer command_buffer, uint32_t slot)
+{
+    if(!enabled)
+    {
+        return;
+    }
+
+    current_slot = slot % frame_count;
+    readResults(current_slot);
+
+    queries_used[current_slot] = 0;
+    recorded_scopes[current_slot].clear();
+    vkCmdResetQueryPool(command_buffer, query_pool, current_slot * max_queries_per_frame, max_queries_per_frame);
+}
+
+uint32_t GpuProfiler::beginScope(VkCommandBuffer command_buffer, const char* name, VkPipelineStageFlagBits stage)
+{
+    if(!enabled || queries_used[current_slot] + 2 > max_queries_per_frame)
+    {
+        return UINT32_MAX;
+    }
+
+    RecordedScope recorded = {};
+    recorded.scope_id = scopeId(name);
+    recorded.begin_query = current_slot * max_queries_per_frame + queries_used[current_slot]++;
+    //Reserve the end query now so the pair stays valid even if scopes nest
+    recorded.end_query = current_slot * max_queries_per_frame + queries_used[current_slot]++;
+    vkCmdWriteTimestamp(command_buffer, stage, query_pool, recorded.begin_query);
+
+    recorded_scopes[current_slot].push_back(recorded);
+    return static_cast<uint32_t>(recorded_scopes[current_slot].size() - 1);
+}
+
+void GpuProfiler::endScope(VkCommandBuffer command_buffer, uint32_t scope, VkPipelineStageFlagBits stage)
+{
+    if(!enabled || scope >= recorded_scopes[current_slot].size())
+    {
+        return;
+    }
+
+    vkCmdWriteTimestamp(command_buffer, stage, query_pool, recorded_scopes[current_slot][scope].end_query);
+}
+
+std::vector<GpuProfiler::ScopeStats> GpuProfiler::getStats() const
+{
+    std::vector<ScopeStats> stats = {};
+    for(const auto& history : scopes)
+    {
+        if(history.samples_ms.empty())
+        {
+            continue;
+        }
+
+        ScopeStats scope_stats = {};
+        scope_stats.name = history.name;
+        scope_stats.samples = history.total_samples;
+        size_t last = (history.next_sample + history_length - 1) % history_length;
+        scope_stats.last_ms = history.samples_ms[std::min(last, history.samples_ms.size() - 1)];
+
+        std::vector<double> sorted = history.samples_ms;
+        std::sort(sorted.begin(), sorted.end());
+        double total = 0.0;
+        for(double sample : sorted)
+        {
+            total += sample;
+        }
+        scope_stats.min_ms = sorted.front();
+        scope_stats.avg_ms = total / sorted.size();
+        size_t p99_index = std::min(sorted.size() - 1, (sorted.size() * 99) / 100);
+        scope_stats.p99_ms = sorted[p99_index];
+
+        stats.push_back(scope_stats);
+    }
+    return stats;
+}
+
+void GpuProfiler::resetStats()
+{
+    for(auto& history : scopes)
+    {
+        history.samples_ms.clear();
+        history.next_sample = 0;
+        history.total_samples = 0;
+    }
+    //Queries recorded before the reset are never read back
+    std::fill(queries_used.begin(), queries_used.end(), 0);
+}
+
+void GpuProfiler::printSummary() const
+{
+    if(!enabled)
+    {
+        return;
+    }
+
+    std::cout << "GPU timings over the last " << history_length << " frames (ms):" << std::endl;
+    for(const auto& scope : getStats())
+    {
+        std::cout << "  " << scope.name << ": min " << scope.min_ms << " avg " << scope.avg_ms
+            << " p99 " << scope.p99_ms << " (" << scope.samples << " samples)" << std::endl;
+    }
+}
+
+bool GpuProfiler::writeCsv(const std::string& file_name) const
+{
+    std::ofstream file(file_name, std::ios::trunc);
+    if(!file.is_open())
+    {
+        std::cout << "Failed to open file: " << file_name << std::endl;
+        return false;
+    }
+
+    file << "scope,samples,last_ms,min_ms,avg_ms,p99_ms\n";
+    for(const auto& scope : getStats())
+    {
+        file << scope.name << "," << scope.samples << "," << scope.last_ms << "," << scope.min_ms << ","
+            << scope.avg_ms << "," << scope.p99_ms << "\n";
+    }
+    return file.good();
+}
+
+bool GpuProfiler::writeJson(const std::string& file_name) const
+{
+    std::ofstream file(file_name, std::ios::trunc);
+    if(!file.is_open())
+    {
+        std::cout << "Failed to open file: " << file_name << std::endl;
+        return false;
+    }
+
+    auto stats = getStats();
+    file << "{\n  \"scopes\": [\n";
+    for(size_t i = 0; i < stats.size(); i++)
+    {
+        file << "    {\"name\": \"" << stats[i].name << "\", \"samples\": " << stats[i].samples
+            << ", \"last_ms\": " << stats[i].last_ms << ", \"min_ms\": " << stats[i].min_ms
+            << ", \"avg_ms\": " << stats[i].avg_ms << ", \"p99_ms\": " << stats[i].p99_ms << "}"
+            << (i + 1 < stats.size() ? "," : "") << "\n";
+    }
+    file << "  ]\n}\n";
+    return file.good();
+}
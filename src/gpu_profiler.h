@@ -0,0 +1,77 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <unordered_map>
+#include <cstdint>
+#include <vulkan/vulkan.h>
+
+//Per-scope GPU timings from timestamp queries.
+//Each frame in flight owns a slice of one query pool. Results for a slice are read back when the slot
+//comes around again, after its fence has been waited on, so reading never stalls.
+class GpuProfiler
+{
+    public:
+        struct ScopeStats
+        {
+            std::string name = {};
+            double last_ms = 0.0;
+            double min_ms = 0.0;
+            double avg_ms = 0.0;
+            double p99_ms = 0.0;
+            uint64_t samples = 0;
+        };
+
+        GpuProfiler();
+        ~GpuProfiler();
+
+        bool init(VkDevice, VkPhysicalDevice, uint32_t, uint32_t);
+        void destroy();
+
+        //Must be recorded outside of a render pass, before any scopes of the frame
+        void beginFrame(VkCommandBuffer, uint32_t);
+        uint32_t beginScope(VkCommandBuffer, const char*, VkPipelineStageFlagBits = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT);
+        void endScope(VkCommandBuffer, uint32_t, VkPipelineStageFlagBits = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT);
+
+        std::vector<ScopeStats> getStats() const;
+        //Forget every sample, including those of frames still in flight
+        void resetStats();
+        void printSummary() const;
+        bool writeCsv(const std::string&) const;
+        bool writeJson(const std::string&) const;
+
+        bool enabled;
+
+    private:
+        struct RecordedScope
+        {
+            uint32_t scope_id = 0;
+            uint32_t begin_query = 0;
+            uint32_t end_query = 0;
+        };
+        struct ScopeHistory
+        {
+            std::string name = {};
+            std::vector<double> samples_ms = {};
+            size_t next_sample = 0;
+            uint64_t total_samples = 0;
+        };
+
+        void readResults(uint32_t);
+        uint32_t scopeId(const char*);
+
+        static constexpr uint32_t max_queries_per_frame = 128;
+        static constexpr size_t history_length = 512;
+
+        VkDevice device;
+        VkQueryPool query_pool;
+        double timestamp_period_ns;
+        uint64_t timestamp_mask;
+        uint32_t frame_count;
+        uint32_t current_slot;
+        std::vector<uint32_t> queries_used;
+        std::vector<std::vector<RecordedScope>> recorded_scopes;
+        std::vector<ScopeHistory> scopes;
+        std::unordered_map<std::string, uint32_t> scope_ids;
+        std::vector<uint64_t> query_results;
+};
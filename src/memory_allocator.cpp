@@ -0,0 +1,538 @@
+#include "memory_allocator.h"
+
+#include <iostream>
+#include <algorithm>
+#include <bitset>
+
+BuddyBlock::BuddyBlock(VkDeviceMemory block_memory, void* block_mapped, VkDeviceSize block_size, VkDeviceSize smallest_size)
+{
+    memory = block_memory;
+    mapped = block_mapped;
+    size = block_size;
+    used = 0;
+    allocation_count = 0;
+    min_size = smallest_size;
+
+    max_order = 0;
+    while((min_size << max_order) < size)
+    {
+        max_order++;
+    }
+    free_lists.resize(max_order + 1);
+    free_lists[max_order].insert(0);
+}
+
+bool BuddyBlock::allocate(VkDeviceSize request_size, VkDeviceSize alignment, VkDeviceSize* offset, uint32_t* order)
+{
+    VkDeviceSize needed = std::max(request_size, alignment);
+    uint32_t wanted_order = 0;
+    while(orderSize(wanted_order) < needed)
+    {
+        wanted_order++;
+        if(wanted_order > max_order)
+        {
+            return false;
+        }
+    }
+
+    uint32_t found_order = wanted_order;
+    while(found_order <= max_order && free_lists[found_order].empty())
+    {
+        found_order++;
+    }
+    if(found_order > max_order)
+    {
+        return false;
+    }
+
+    VkDeviceSize found_offset = *free_lists[found_order].begin();
+    free_lists[found_order].erase(free_lists[found_order].begin());
+
+    //Split down to the wanted size, keeping the lower half and freeing the upper one
+    while(found_order > wanted_order)
+    {
+        found_order--;
+        free_lists[found_order].insert(found_offset + orderSize(found_order));
+    }
+
+    used += orderSize(wanted_order);
+    allocation_count++;
+    *offset = found_offset;
+    *order = wanted_order;
+    return true;
+}
+
+void BuddyBlock::free(VkDeviceSize offset, uint32_t order)
+{
+    used -= orderSize(order);
+    allocation_count--;
+
+    //Merge with the buddy for as long as it is free too
+    while(order < max_order)
+    {
+        VkDeviceSize buddy = offset ^ orderSize(order);
+        auto it = free_lists[order].find(buddy);
+        if(it == free_lists[order].end())
+        {
+            break;
+        }
+        free_lists[order].erase(it);
+        offset = std::min(offset, buddy);
+        order++;
+    }
+    free_lists[order].insert(offset);
+}
+
+DeviceAllocator::DeviceAllocator()
+{
+    memory_properties = {};
+    device = VK_NULL_HANDLE;
+    preferred_block_size = 0;
+    buffer_image_granularity = 1;
+    max_allocation_count = 0;
+    device_memory_count = 0;
+}
+
+DeviceAllocator::~DeviceAllocator()
+{
+    destroy();
+}
+
+bool DeviceAllocator::init(VkPhysicalDevice physical_device, VkDevice logical_device, VkDeviceSize block_size)
+{
+    device = logical_device;
+    preferred_block_size = block_size;
+    vkGetPhysicalDeviceMemoryProperties(physical_device, &memory_properties);
+
+    VkPhysicalDeviceProperties device_properties = {};
+    vkGetPhysicalDeviceProperties(physical_device, &device_properties);
+    buffer_image_granularity = device_properties.limits.bufferImageGranularity;
+    max_allocation_count = device_properties.limits.maxMemoryAllocationCount;
+
+    pools.resize(memory_properties.memoryTypeCount * 2);
+    for(uint32_t i = 0; i < pools.size(); i++)
+    {
+        pools[i].memory_type = i / 2;
+    }
+
+    heap_stats.resize(memory_properties.memoryHeapCount);
+    for(uint32_t i = 0; i < memory_properties.memoryHeapCount; i++)
+    {
+        heap_stats[i].heap_size = memory_properties.memoryHeaps[i].size;
+        heap_stats[i].device_local = (memory_properties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) != 0;
+    }
+
+    return true;
+}
+
+void DeviceAllocator::destroy()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    for(auto& pool : pools)
+    {
+        for(auto& block : pool.blocks)
+        {
+            if(block != nullptr)
+            {
+                if(block->allocation_count != 0)
+                {
+                    std::cout << "Memory block freed with " << block->allocation_count << " live allocations!" << std::endl;
+                }
+                freeDeviceMemory(block->memory, pool.memory_type, block->size);
+            }
+        }
+        pool.blocks.clear();
+    }
+    pools.clear();
+}
+
+uint32_t DeviceAllocator::findMemoryType(uint32_t type_filter, VkMemoryPropertyFlags required, VkMemoryPropertyFlags preferred, bool* result) const
+{
+    uint32_t best_type = 0;
+    int best_score = -1;
+    for(uint32_t i = 0; i < memory_properties.memoryTypeCount; i++)
+    {
+        VkMemoryPropertyFlags flags = memory_properties.memoryTypes[i].propertyFlags;
+        if(!(type_filter & (1u << i)) || (flags & required) != required)
+        {
+            continue;
+        }
+
+        int score = static_cast<int>(std::bitset<32>(flags & preferred).count());
+        if(score > best_score)
+        {
+            best_score = score;
+            best_type = i;
+        }
+    }
+
+    if(best_score < 0)
+    {
+        std::cout << "Failed to find a suitable memory type!" << std::endl;
+        *result = false;
+        return 0;
+    }
+    *result = true;
+    return best_type;
+}
+
+VkDeviceSize DeviceAllocator::blockSizeForType(uint32_t memory_type) const
+{
+    //Don't let a single block eat a big share of a small heap
+    VkDeviceSize heap_size = memory_properties.memoryHeaps[memory_properties.memoryTypes[memory_type].heapIndex].size;
+    VkDeviceSize block_size = preferred_block_size;
+    while(block_size > 1024 * 1024 && block_size > heap_size / 8)
+    {
+        block_size /= 2;
+    }
+    return block_size;
+}
+
+bool DeviceAllocator::allocateDeviceMemory(VkDeviceSize size, uint32_t memory_type, VkDeviceMemory* memory, void** mapped)
+{
+    if(device_memory_count >= max_allocation_count)
+    {
+        std::cout << "Reached maxMemoryAllocationCount (" << max_allocation_count << ")!" << std::endl;
+        return false;
+    }
+
+    VkMemoryAllocateInfo alloc_info = {};
+    alloc_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    alloc_info.allocationSize = size;
+    alloc_info.memoryTypeIndex = memory_type;
+    if(vkAllocateMemory(device, &alloc_info, nullptr, memory) != VK_SUCCESS)
+    {
+        std::cout << "Failed to allocate " << size << " bytes of device memory!" << std::endl;
+        return false;
+    }
+
+    //Host visible memory stays mapped for its whole lifetime
+    *mapped = nullptr;
+    if(memory_properties.memoryTypes[memory_type].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+    {
+        if(vkMapMemory(device, *memory, 0, VK_WHOLE_SIZE, 0, mapped) != VK_SUCCESS)
+        {
+            std::cout << "Failed to map device memory!" << std::endl;
+            vkFreeMemory(device, *memory, nullptr);
+            return false;
+        }
+    }
+
+    device_memory_count++;
+    HeapStats& heap = heap_stats[memory_properties.memoryTypes[memory_type].heapIndex];
+    heap.block_bytes += size;
+    return true;
+}
+
+void DeviceAllocator::freeDeviceMemory(VkDeviceMemory memory, uint32_t memory_type, VkDeviceSize size)
+{
+    vkFreeMemory(device, memory, nullptr);
+    device_memory_count--;
+    heap_stats[memory_properties.memoryTypes[memory_type].heapIndex].block_bytes -= size;
+}
+
+bool DeviceAllocator::allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags required,
+    VkMemoryPropertyFlags preferred, ResourceKind kind, MemoryAllocation* allocation)
+{
+    bool result = false;
+    uint32_t memory_type = findMemoryType(requirements.memoryTypeBits, required, preferred, &result);
+    if(!result)
+    {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    HeapStats& heap = heap_stats[memory_properties.memoryTypes[memory_type].heapIndex];
+    *allocation = {};
+    allocation->memory_type = memory_type;
+    allocation->size = requirements.size;
+
+    //Big resources get their own allocation instead of hogging most of a block
+    VkDeviceSize block_size = blockSizeForType(memory_type);
+    if(requirements.size > block_size / 2)
+    {
+        if(!allocateDeviceMemory(requirements.size, memory_type, &allocation->memory, &allocation->mapped))
+        {
+            return false;
+        }
+        heap.dedicated_count++;
+        heap.used_bytes += requirements.size;
+        heap.requested_bytes += requirements.size;
+        heap.allocation_count++;
+        return true;
+    }
+
+    uint32_t pool_index = memory_type * 2 + static_cast<uint32_t>(kind);
+    Pool& pool = pools[pool_index];
+
+    VkDeviceSize offset = 0;
+    uint32_t order = 0;
+    uint32_t block_index = UINT32_MAX;
+    for(uint32_t i = 0; i < pool.blocks.size(); i++)
+    {
+        if(pool.blocks[i] != nullptr && pool.blocks[i]->allocate(requirements.size, requirements.alignment, &offset, &order))
+        {
+            block_index = i;
+            break;
+        }
+    }
+
+    if(block_index == UINT32_MAX)
+    {
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+        void* mapped = nullptr;
+        if(!allocateDeviceMemory(block_size, memory_type, &memory, &mapped))
+        {
+            return false;
+        }
+        heap.block_count++;
+
+        //Reuse an empty slot so block indices held by live allocations stay valid
+        auto empty_slot = std::find(pool.blocks.begin(), pool.blocks.end(), nullptr);
+        block_index = static_cast<uint32_t>(empty_slot - pool.blocks.begin());
+        auto block = std::make_unique<BuddyBlock>(memory, mapped, block_size, min_allocation_size);
+        if(empty_slot == pool.blocks.end())
+        {
+            pool.blocks.push_back(std::move(block));
+        }
+        else
+        {
+            *empty_slot = std::move(block);
+        }
+
+        if(!pool.blocks[block_index]->allocate(requirements.size, requirements.alignment, &offset, &order))
+        {
+            std::cout << "Failed to sub-allocate " << requirements.size << " bytes from a fresh block!" << std::endl;
+            return false;
+        }
+    }
+
+    BuddyBlock& block = *pool.blocks[block_index];
+    allocation->memory = block.memory;
+    allocation->offset = offset;
+    allocation->mapped = block.mapped != nullptr ? static_cast<char*>(block.mapped) + offset : nullptr;
+    allocation->pool = pool_index;
+    allocation->block = block_index;
+    allocation->order = order;
+
+    heap.used_bytes += block.orderSize(order);
+    heap.requested_bytes += requirements.size;
+    heap.allocation_count++;
+    return true;
+}
+
+void DeviceAllocator::free(MemoryAllocation& allocation)
+{
+    if(allocation.memory == VK_NULL_HANDLE)
+    {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    HeapStats& heap = heap_stats[memory_properties.memoryTypes[allocation.memory_type].heapIndex];
+    heap.requested_bytes -= allocation.size;
+    heap.allocation_count--;
+
+    if(allocation.block == UINT32_MAX)
+    {
+        heap.dedicated_count--;
+        heap.used_bytes -= allocation.size;
+        freeDeviceMemory(allocation.memory, allocation.memory_type, allocation.size);
+        allocation = {};
+        return;
+    }
+
+    Pool& pool = pools[allocation.pool];
+    BuddyBlock& block = *pool.blocks[allocation.block];
+    heap.used_bytes -= block.orderSize(allocation.order);
+    block.free(allocation.offset, allocation.order);
+
+    //Keep one empty block around per pool so allocation churn doesn't hit the driver every time
+    if(block.allocation_count == 0)
+    {
+        size_t other_empty = std::count_if(pool.blocks.begin(), pool.blocks.end(), [&block](const std::unique_ptr<BuddyBlock>& other)
+        {
+            return other != nullptr && other.get() != &block && other->allocation_count == 0;
+        });
+        if(other_empty > 0)
+        {
+            freeDeviceMemory(block.memory, pool.memory_type, block.size);
+            heap.block_count--;
+            pool.blocks[allocation.block].reset();
+        }
+    }
+
+    allocation = {};
+}
+
+bool DeviceAllocator::createBuffer(const VkBufferCreateInfo& buffer_info, VkMemoryPropertyFlags required,
+    VkMemoryPropertyFlags preferred, VkBuffer* buffer, MemoryAllocation* allocation)
+{
+    if(vkCreateBuffer(device, &buffer_info, nullptr, buffer) != VK_SUCCESS)
+    {
+        std::cout << "Failed to create buffer!" << std::endl;
+        return false;
+    }
+
+    VkMemoryRequirements requirements = {};
+    vkGetBufferMemoryRequirements(device, *buffer, &requirements);
+    if(!allocate(requirements, required, preferred, ResourceKind::Linear, allocation))
+    {
+        vkDestroyBuffer(device, *buffer, nullptr);
+        *buffer = VK_NULL_HANDLE;
+        return false;
+    }
+
+    if(vkBindBufferMemory(device, *buffer, allocation->memory, allocation->offset) != VK_SUCCESS)
+    {
+        std::cout << "Failed to bind buffer memory!" << std::endl;
+        destroyBuffer(*buffer, *allocation);
+        *buffer = VK_NULL_HANDLE;
+        return false;
+    }
+    return true;
+}
+
+bool DeviceAllocator::createImage(const VkImageCreateInfo& image_info, VkMemoryPropertyFlags required,
+    VkMemoryPropertyFlags preferred, VkImage* image, MemoryAllocation* allocation)
+{
+    if(vkCreateImage(device, &image_info, nullptr, image) != VK_SUCCESS)
+    {
+        std::cout << "Failed to create image!" << std::endl;
+        return false;
+    }
+
+    VkMemoryRequirements requirements = {};
+    vkGetImageMemoryRequirements(device, *image, &requirements);
+    ResourceKind kind = image_info.tiling == VK_IMAGE_TILING_LINEAR ? ResourceKind::Linear : ResourceKind::Optimal;
+    if(!allocate(requirements, required, preferred, kind, allocation))
+    {
+        vkDestroyImage(device, *image, nullptr);
+        *image = VK_NULL_HANDLE;
+        return false;
+    }
+
+    if(vkBindImageMemory(device, *image, allocation->memory, allocation->offset) != VK_SUCCESS)
+    {
+        std::cout << "Failed to bind image memory!" << std::endl;
+        destroyImage(*image, *allocation);
+        *image = VK_NULL_HANDLE;
+        return false;
+    }
+    return true;
+}
+
+void DeviceAllocator::destroyBuffer(VkBuffer buffer, MemoryAllocation& allocation)
+{
+    vkDestroyBuffer(device, buffer, nullptr);
+    free(allocation);
+}
+
+void DeviceAllocator::destroyImage(VkImage image, MemoryAllocation& allocation)
+{
+    vkDestroyImage(device, image, nullptr);
+    free(allocation);
+}
+
+std::vector<DeviceAllocator::HeapStats> DeviceAllocator::getHeapStats() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return heap_stats;
+}
+
+void DeviceAllocator::printStats() const
+{
+    auto stats = getHeapStats();
+    std::cout << "Device memory (bufferImageGranularity " << buffer_image_granularity << ", "
+        << device_memory_count << "/" << max_allocation_count << " driver allocations):" << std::endl;
+    for(size_t i = 0; i < stats.size(); i++)
+    {
+        const HeapStats& heap = stats[i];
+        std::cout << "  heap " << i << (heap.device_local ? " (device local)" : "") << ": "
+            << heap.used_bytes / 1024 << " KiB used of " << heap.block_bytes / 1024 << " KiB allocated, "
+            << heap.requested_bytes / 1024 << " KiB requested, heap size " << heap.heap_size / (1024 * 1024) << " MiB, "
+            << heap.allocation_count << " allocations in " << heap.block_count << " blocks + "
+            << heap.dedicated_count << " dedicated" << std::endl;
+    }
+}
+
+LinearAllocator::LinearAllocator()
+{
+    buffer = VK_NULL_HANDLE;
+    segment_size = 0;
+    bytes_this_frame = 0;
+    stats = {};
+    allocation = {};
+    device = VK_NULL_HANDLE;
+    alignment = 1;
+    frame_count = 0;
+    current_segment = 0;
+    head = 0;
+}
+
+bool LinearAllocator::init(DeviceAllocator& allocator, VkDevice logical_device, VkDeviceSize bytes_per_frame,
+    uint32_t frames_in_flight, VkBufferUsageFlags usage, VkDeviceSize min_alignment)
+{
+    device = logical_device;
+    alignment = std::max<VkDeviceSize>(min_alignment, 16);
+    segment_size = (bytes_per_frame + alignment - 1) / alignment * alignment;
+    frame_count = frames_in_flight;
+
+    VkBufferCreateInfo buffer_info = {};
+    buffer_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    buffer_info.size = segment_size * frame_count;
+    buffer_info.usage = usage;
+    buffer_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    //Written by the CPU every frame and read once by the GPU; device local + host visible is ideal when it exists
+    if(!allocator.createBuffer(buffer_info, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &buffer, &allocation))
+    {
+        return false;
+    }
+
+    beginFrame(0);
+    stats = {};
+    return true;
+}
+
+void LinearAllocator::destroy(DeviceAllocator& allocator)
+{
+    if(buffer != VK_NULL_HANDLE)
+    {
+        allocator.destroyBuffer(buffer, allocation);
+        buffer = VK_NULL_HANDLE;
+    }
+}
+
+void LinearAllocator::beginFrame(uint32_t slot)
+{
+    current_segment = slot % std::max(frame_count, 1u);
+    head = 0;
+    bytes_this_frame = 0;
+    stats.frames++;
+}
+
+void* LinearAllocator::allocate(VkDeviceSize size, VkDeviceSize* offset)
+{
+    VkDeviceSize aligned_head = (head + alignment - 1) / alignment * alignment;
+    if(aligned_head + size > segment_size)
+    {
+        stats.overflows++;
+        return nullptr;
+    }
+
+    head = aligned_head + size;
+    bytes_this_frame += size;
+    stats.bytes += size;
+    stats.peak_frame_bytes = std::max(stats.peak_frame_bytes, bytes_this_frame);
+    *offset = current_segment * segment_size + aligned_head;
+    return static_cast<char*>(allocation.mapped) + *offset;
+}
+
+void LinearAllocator::printStats(const char* name) const
+{
+    uint64_t average = stats.frames > 0 ? stats.bytes / stats.frames : 0;
+    std::cout << name << ": " << average << " bytes/frame average, " << stats.peak_frame_bytes << " peak of "
+        << segment_size << " per frame, " << stats.overflows << " overflows" << std::endl;
+}
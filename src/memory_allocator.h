@@ -0,0 +1,158 @@
+#pragma once
+
+#include <vector>
+#include <set>
+#include <memory>
+#include <mutex>
+#include <functional>
+#include <cstdint>
+#include <vulkan/vulkan.h>
+
+//Hands Vulkan objects to the owner's deferred deletion, frames in flight may still use them
+using DeferFunction = std::function<void(std::function<void()>)>;
+
+//Where a resource lives relative to bufferImageGranularity. Linear resources (buffers, linear images)
+//and optimal tiling images are never placed in the same block, so they can't share a granularity page.
+enum class ResourceKind : uint32_t
+{
+    Linear = 0,
+    Optimal = 1
+};
+
+struct MemoryAllocation
+{
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    VkDeviceSize offset = 0;
+    VkDeviceSize size = 0;
+    //Host pointer to offset, only set for host visible memory
+    void* mapped = nullptr;
+    uint32_t memory_type = 0;
+    //Bookkeeping for DeviceAllocator::free, block is UINT32_MAX for dedicated allocations
+    uint32_t pool = UINT32_MAX;
+    uint32_t block = UINT32_MAX;
+    uint32_t order = 0;
+};
+
+//Binary buddy allocator over one VkDeviceMemory block. Every allocation is a power of two multiple of
+//min_size and is aligned to its own size, so any alignment up to the allocation size comes for free.
+class BuddyBlock
+{
+    public:
+        BuddyBlock(VkDeviceMemory, void*, VkDeviceSize, VkDeviceSize);
+
+        bool allocate(VkDeviceSize, VkDeviceSize, VkDeviceSize*, uint32_t*);
+        void free(VkDeviceSize, uint32_t);
+        VkDeviceSize orderSize(uint32_t order) const { return min_size << order; }
+
+        VkDeviceMemory memory;
+        void* mapped;
+        VkDeviceSize size;
+        VkDeviceSize used;
+        uint32_t allocation_count;
+
+    private:
+        VkDeviceSize min_size;
+        uint32_t max_order;
+        std::vector<std::set<VkDeviceSize>> free_lists;
+};
+
+//Hands out sub-allocations of large vkAllocateMemory blocks so the renderer stays far away from
+//maxMemoryAllocationCount and pays the driver allocation cost once per block instead of per resource.
+class DeviceAllocator
+{
+    public:
+        struct HeapStats
+        {
+            VkDeviceSize heap_size = 0;
+            bool device_local = false;
+            //Bytes allocated from the driver, and how much of that is handed out to resources
+            VkDeviceSize block_bytes = 0;
+            VkDeviceSize used_bytes = 0;
+            VkDeviceSize requested_bytes = 0;
+            uint32_t block_count = 0;
+            uint32_t dedicated_count = 0;
+            uint32_t allocation_count = 0;
+        };
+
+        DeviceAllocator();
+        ~DeviceAllocator();
+
+        bool init(VkPhysicalDevice, VkDevice, VkDeviceSize = 64 * 1024 * 1024);
+        void destroy();
+
+        //Picks the type with all required flags and as many preferred flags as possible
+        uint32_t findMemoryType(uint32_t, VkMemoryPropertyFlags, VkMemoryPropertyFlags, bool*) const;
+        bool allocate(const VkMemoryRequirements&, VkMemoryPropertyFlags, VkMemoryPropertyFlags, ResourceKind, MemoryAllocation*);
+        void free(MemoryAllocation&);
+
+        bool createBuffer(const VkBufferCreateInfo&, VkMemoryPropertyFlags, VkMemoryPropertyFlags, VkBuffer*, MemoryAllocation*);
+        bool createImage(const VkImageCreateInfo&, VkMemoryPropertyFlags, VkMemoryPropertyFlags, VkImage*, MemoryAllocation*);
+        void destroyBuffer(VkBuffer, MemoryAllocation&);
+        void destroyImage(VkImage, MemoryAllocation&);
+
+        std::vector<HeapStats> getHeapStats() const;
+        void printStats() const;
+
+        VkPhysicalDeviceMemoryProperties memory_properties;
+
+    private:
+        struct Pool
+        {
+            uint32_t memory_type = 0;
+            std::vector<std::unique_ptr<BuddyBlock>> blocks = {};
+        };
+
+        bool allocateDeviceMemory(VkDeviceSize, uint32_t, VkDeviceMemory*, void**);
+        void freeDeviceMemory(VkDeviceMemory, uint32_t, VkDeviceSize);
+        VkDeviceSize blockSizeForType(uint32_t) const;
+
+        static constexpr VkDeviceSize min_allocation_size = 256;
+
+        VkDevice device;
+        VkDeviceSize preferred_block_size;
+        VkDeviceSize buffer_image_granularity;
+        uint32_t max_allocation_count;
+        uint32_t device_memory_count;
+        //Indexed by memory type * 2 + ResourceKind
+        std::vector<Pool> pools;
+        std::vector<HeapStats> heap_stats;
+        mutable std::mutex mutex;
+};
+
+//Persistently mapped buffer split into one segment per frame in flight. Each frame bump-allocates from
+//its own segment and the whole segment is recycled when the frame slot comes around again.
+class LinearAllocator
+{
+    public:
+        struct Stats
+        {
+            uint64_t frames = 0;
+            uint64_t bytes = 0;
+            VkDeviceSize peak_frame_bytes = 0;
+            //Allocations that didn't fit in their frame's segment
+            uint64_t overflows = 0;
+        };
+
+        LinearAllocator();
+
+        bool init(DeviceAllocator&, VkDevice, VkDeviceSize, uint32_t, VkBufferUsageFlags, VkDeviceSize);
+        void destroy(DeviceAllocator&);
+
+        void beginFrame(uint32_t);
+        //Returns nullptr when the frame's segment is full, offset is from the start of buffer
+        void* allocate(VkDeviceSize, VkDeviceSize*);
+        void printStats(const char*) const;
+
+        VkBuffer buffer;
+        VkDeviceSize segment_size;
+        VkDeviceSize bytes_this_frame;
+        Stats stats;
+
+    private:
+        MemoryAllocation allocation;
+        VkDevice device;
+        VkDeviceSize alignment;
+        uint32_t frame_count;
+        uint32_t current_segment;
+        VkDeviceSize head;
+};
@@ -0,0 +1,184 @@
+#include "parallel_recorder.h"
+
+#include <iostream>
+
+ParallelRecorder::ParallelRecorder()
+{
+    device = VK_NULL_HANDLE;
+    workers.clear();
+    generation = 0;
+    pending = 0;
+    stopping = false;
+    job_slot = 0;
+    job_inheritance = nullptr;
+    job_record = nullptr;
+}
+
+ParallelRecorder::~ParallelRecorder()
+{
+    destroy();
+}
+
+bool ParallelRecorder::init(VkDevice logical_device, uint32_t queue_family, uint32_t frames_in_flight, uint32_t thread_count)
+{
+    device = logical_device;
+
+    //Create everything up front, the threads index into workers as soon as they start
+    for(uint32_t i = 0; i < thread_count; i++)
+    {
+        auto worker = std::make_unique<Worker>();
+        worker->command_pools.resize(frames_in_flight, VK_NULL_HANDLE);
+        worker->command_buffers.resize(frames_in_flight, VK_NULL_HANDLE);
+        for(uint32_t slot = 0; slot < frames_in_flight; slot++)
+        {
+            VkCommandPoolCreateInfo pool_info = {};
+            pool_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+            pool_info.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+            pool_info.queueFamilyIndex = queue_family;
+            if(vkCreateCommandPool(device, &pool_info, nullptr, &worker->command_pools[slot]) != VK_SUCCESS)
+            {
+                std::cout << "Failed to create worker command pool!" << std::endl;
+                workers.push_back(std::move(worker));
+                return false;
+            }
+
+            VkCommandBufferAllocateInfo alloc_info = {};
+            alloc_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+            alloc_info.commandPool = worker->command_pools[slot];
+            alloc_info.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+            alloc_info.commandBufferCount = 1;
+            if(vkAllocateCommandBuffers(device, &alloc_info, &worker->command_buffers[slot]) != VK_SUCCESS)
+            {
+                std::cout << "Failed to allocate secondary command buffer!" << std::endl;
+                workers.push_back(std::move(worker));
+                return false;
+            }
+        }
+        workers.push_back(std::move(worker));
+    }
+
+    for(uint32_t i = 0; i < thread_count; i++)
+    {
+        workers[i]->thread = std::thread(&ParallelRecorder::workerLoop, this, i);
+    }
+
+    return true;
+}
+
+void ParallelRecorder::destroy()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    work_ready.notify_all();
+
+    for(auto& worker : workers)
+    {
+        if(worker->thread.joinable())
+        {
+            worker->thread.join();
+        }
+        //Destroying the pools frees their command buffers
+        for(auto command_pool : worker->command_pools)
+        {
+            if(command_pool != VK_NULL_HANDLE)
+            {
+                vkDestroyCommandPool(device, command_pool, nullptr);
+            }
+        }
+    }
+    workers.clear();
+}
+
+bool ParallelRecorder::record(uint32_t slot, const VkCommandBufferInheritanceInfo& inheritance,
+    const RecordFunction& record_function, std::vector<VkCommandBuffer>* command_buffers)
+{
+    if(workers.empty())
+    {
+        return false;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        job_slot = slot;
+        job_inheritance = &inheritance;
+        job_record = &record_function;
+        pending = static_cast<uint32_t>(workers.size());
+        generation++;
+    }
+    work_ready.notify_all();
+
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        work_done.wait(lock, [this]() { return pending == 0; });
+        job_inheritance = nullptr;
+        job_record = nullptr;
+    }
+
+    bool result = true;
+    command_buffers->clear();
+    for(auto& worker : workers)
+    {
+        result = result && worker->result;
+        command_buffers->push_back(worker->command_buffers[slot]);
+    }
+    return result;
+}
+
+void ParallelRecorder::workerLoop(uint32_t index)
+{
+    uint64_t seen_generation = 0;
+    while(true)
+    {
+        uint32_t slot = 0;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            work_ready.wait(lock, [this, seen_generation]() { return stopping || generation != seen_generation; });
+            if(stopping)
+            {
+                return;
+            }
+            seen_generation = generation;
+            slot = job_slot;
+        }
+
+        workers[index]->result = recordSlot(index, slot);
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            pending--;
+            if(pending == 0)
+            {
+                work_done.notify_one();
+            }
+        }
+    }
+}
+
+bool ParallelRecorder::recordSlot(uint32_t index, uint32_t slot)
+{
+    Worker& worker = *workers[index];
+    //The frame slot's fence was waited on before record() was called, nothing from the pool is in use
+    vkResetCommandPool(device, worker.command_pools[slot], 0);
+
+    VkCommandBuffer command_buffer = worker.command_buffers[slot];
+    VkCommandBufferBeginInfo begin_info = {};
+    begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT | VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+    begin_info.pInheritanceInfo = job_inheritance;
+    if(vkBeginCommandBuffer(command_buffer, &begin_info) != VK_SUCCESS)
+    {
+        std::cout << "Failed to begin recording secondary command buffer!" << std::endl;
+        return false;
+    }
+
+    bool result = (*job_record)(index, command_buffer);
+
+    if(vkEndCommandBuffer(command_buffer) != VK_SUCCESS)
+    {
+        std::cout << "Failed to record secondary command buffer!" << std::endl;
+        return false;
+    }
+    return result;
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <cstdint>
+#include <vulkan/vulkan.h>
+
+//Records secondary command buffers on a fixed set of worker threads. Every worker owns one command
+//pool per frame in flight, so pools are never shared between threads and a whole slot's pool can be
+//reset at once when its fence has signaled.
+class ParallelRecorder
+{
+    public:
+        //Called on worker N with that worker's secondary command buffer, already begun
+        using RecordFunction = std::function<bool(uint32_t, VkCommandBuffer)>;
+
+        ParallelRecorder();
+        ~ParallelRecorder();
+
+        bool init(VkDevice, uint32_t, uint32_t, uint32_t);
+        void destroy();
+
+        //Blocks until every worker has recorded its buffer for the frame slot. The buffers are returned
+        //in worker order, ready for vkCmdExecuteCommands.
+        bool record(uint32_t, const VkCommandBufferInheritanceInfo&, const RecordFunction&, std::vector<VkCommandBuffer>*);
+        uint32_t threadCount() const { return static_cast<uint32_t>(workers.size()); }
+
+    private:
+        struct Worker
+        {
+            std::thread thread = {};
+            std::vector<VkCommandPool> command_pools = {};
+            std::vector<VkCommandBuffer> command_buffers = {};
+            bool result = true;
+        };
+
+        void workerLoop(uint32_t);
+        bool recordSlot(uint32_t, uint32_t);
+
+        VkDevice device;
+        std::vector<std::unique_ptr<Worker>> workers;
+        std::mutex mutex;
+        std::condition_variable work_ready;
+        std::condition_variable work_done;
+        uint64_t generation;
+        uint32_t pending;
+        bool stopping;
+        //The job of the current generation, only valid while record() is waiting
+        uint32_t job_slot;
+        const VkCommandBufferInheritanceInfo* job_inheritance;
+        const RecordFunction* job_record;
+};
@@ -0,0 +1,467 @@
+#include "pipeline_state_cache.h"
+
+#include <iostream>
+#include <algorithm>
+#include <chrono>
+
+namespace
+{
+    //FNV-1a, fed field by field so struct padding never ends up in the hash
+    const uint64_t fnv_offset = 14695981039346656037ull;
+    const uint64_t fnv_prime = 1099511628211ull;
+
+    uint64_t hashBytes(uint64_t hash, const void* data, size_t size)
+    {
+        const unsigned char* bytes = static_cast<const unsigned char*>(data);
+        for(size_t i = 0; i < size; i++)
+        {
+            hash ^= bytes[i];
+            hash *= fnv_prime;
+        }
+        return hash;
+    }
+
+    template<typename T>
+    uint64_t hashValue(uint64_t hash, const T& value)
+    {
+        return hashBytes(hash, &value, sizeof(value));
+    }
+}
+
+PipelineStateCache::PipelineStateCache()
+{
+    device = VK_NULL_HANDLE;
+    pipeline_cache = VK_NULL_HANDLE;
+    workers.clear();
+    queue.clear();
+    entries.clear();
+    stats = {};
+    stopping = false;
+}
+
+PipelineStateCache::~PipelineStateCache()
+{
+    destroy();
+}
+
+bool PipelineStateCache::init(VkDevice logical_device, VkPipelineCache cache, uint32_t thread_count)
+{
+    device = logical_device;
+    pipeline_cache = cache;
+    stopping = false;
+
+    //Pipeline caches are internally synchronized, every thread compiles through the same one
+    for(uint32_t i = 0; i < std::max(thread_count, 1u); i++)
+    {
+        workers.push_back(std::thread(&PipelineStateCache::workerLoop, this));
+    }
+    return true;
+}
+
+void PipelineStateCache::destroy()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+        queue.clear();
+    }
+    work_ready.notify_all();
+
+    for(auto& worker : workers)
+    {
+        if(worker.joinable())
+        {
+            worker.join();
+        }
+    }
+    workers.clear();
+
+    //Only called once the device is idle
+    for(auto& entry : entries)
+    {
+        if(entry.second.pipeline != VK_NULL_HANDLE)
+        {
+            vkDestroyPipeline(device, entry.second.pipeline, nullptr);
+        }
+    }
+    entries.clear();
+}
+
+uint64_t PipelineStateCache::hashCode(const char* code, size_t size)
+{
+    return hashBytes(fnv_offset, code, size);
+}
+
+uint64_t PipelineStateCache::hashState(const PipelineState& state)
+{
+    uint64_t hash = fnv_offset;
+    for(const auto& stage : state.stages)
+    {
+        hash = hashValue(hash, stage.stage);
+        hash = hashValue(hash, stage.code_hash);
+        hash = hashValue(hash, stage.constants.size());
+        for(uint32_t constant : stage.constants)
+        {
+            hash = hashValue(hash, constant);
+        }
+    }
+    for(const auto& binding : state.bindings)
+    {
+        hash = hashValue(hash, binding.binding);
+        hash = hashValue(hash, binding.stride);
+        hash = hashValue(hash, binding.inputRate);
+    }
+    for(const auto& attribute : state.attributes)
+    {
+        hash = hashValue(hash, attribute.location);
+        hash = hashValue(hash, attribute.binding);
+        hash = hashValue(hash, attribute.format);
+        hash = hashValue(hash, attribute.offset);
+    }
+    hash = hashValue(hash, state.topology);
+    hash = hashValue(hash, state.polygon_mode);
+    hash = hashValue(hash, state.cull_mode);
+    hash = hashValue(hash, state.front_face);
+    hash = hashValue(hash, state.depth_test);
+    hash = hashValue(hash, state.depth_write);
+    hash = hashValue(hash, state.depth_compare);
+    hash = hashValue(hash, state.blend);
+    hash = hashValue(hash, state.src_blend);
+    hash = hashValue(hash, state.dst_blend);
+    hash = hashValue(hash, state.blend_op);
+    hash = hashValue(hash, state.render_pass);
+    hash = hashValue(hash, state.color_format);
+    hash = hashValue(hash, state.depth_format);
+    hash = hashValue(hash, state.layout);
+    return hash;
+}
+
+VkPipeline PipelineStateCache::get(const PipelineState& state, uint64_t hash)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    auto found = entries.find(hash);
+    if(found != entries.end())
+    {
+        //Wanted again before a released compile finished
+        found->second.discard = false;
+        //Still compiling counts as a miss, the caller has to fall back
+        if(found->second.status == EntryStatus::Ready)
+        {
+            stats.hits++;
+            return found->second.pipeline;
+        }
+        if(found->second.status != EntryStatus::Failed)
+        {
+            stats.misses++;
+        }
+        return VK_NULL_HANDLE;
+    }
+
+    stats.misses++;
+    Entry entry = {};
+    entry.state = state;
+    entries[hash] = entry;
+    queue.push_back(hash);
+    work_ready.notify_one();
+    return VK_NULL_HANDLE;
+}
+
+VkPipeline PipelineStateCache::getBlocking(const PipelineState& state, uint64_t hash)
+{
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        auto found = entries.find(hash);
+        if(found == entries.end())
+        {
+            stats.misses++;
+            Entry entry = {};
+            entry.state = state;
+            entry.status = EntryStatus::Compiling;
+            entries[hash] = entry;
+        }
+        else if(found->second.status == EntryStatus::Queued)
+        {
+            //Take it away from the compile threads
+            stats.misses++;
+            queue.erase(std::find(queue.begin(), queue.end(), hash));
+            found->second.status = EntryStatus::Compiling;
+        }
+        else
+        {
+            found->second.discard = false;
+            stats.hits += found->second.status == EntryStatus::Ready ? 1 : 0;
+            //Looked up again after every wake, release() may have erased it and inserts can rehash the map
+            work_done.wait(lock, [this, hash]()
+            {
+                auto waited = entries.find(hash);
+                return waited == entries.end() || waited->second.status != EntryStatus::Compiling;
+            });
+            auto waited = entries.find(hash);
+            //Released while it compiled, finishCompile destroyed it
+            return waited != entries.end() ? waited->second.pipeline : VK_NULL_HANDLE;
+        }
+    }
+
+    auto compile_start = std::chrono::steady_clock::now();
+    VkPipeline pipeline = compile(state);
+    double compile_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - compile_start).count();
+    return finishCompile(hash, pipeline, compile_ms);
+}
+
+bool PipelineStateCache::hasFailed(uint64_t hash)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    auto found = entries.find(hash);
+    return found != entries.end() && found->second.status == EntryStatus::Failed;
+}
+
+VkPipeline PipelineStateCache::release(uint64_t hash)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    auto found = entries.find(hash);
+    if(found == entries.end())
+    {
+        return VK_NULL_HANDLE;
+    }
+    if(found->second.status == EntryStatus::Compiling)
+    {
+        found->second.discard = true;
+        return VK_NULL_HANDLE;
+    }
+    if(found->second.status == EntryStatus::Queued)
+    {
+        queue.erase(std::find(queue.begin(), queue.end(), hash));
+    }
+    VkPipeline pipeline = found->second.pipeline;
+    entries.erase(found);
+    return pipeline;
+}
+
+PipelineStateCache::Stats PipelineStateCache::getStats()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return stats;
+}
+
+void PipelineStateCache::printStats()
+{
+    Stats current = getStats();
+    double average_ms = current.compiled > 0 ? current.compile_ms / current.compiled : 0.0;
+    std::cout << "Pipeline state cache: " << current.hits << " hits, " << current.misses << " misses, "
+        << current.compiled << " pipelines compiled (" << average_ms << " ms average, " << current.max_compile_ms
+        << " ms worst), " << current.failed << " failed" << std::endl;
+}
+
+VkPipeline PipelineStateCache::compile(const PipelineState& state)
+{
+    std::vector<VkShaderModule> modules(state.stages.size(), VK_NULL_HANDLE);
+    std::vector<VkPipelineShaderStageCreateInfo> stage_infos(state.stages.size());
+    std::vector<VkSpecializationInfo> specialization_infos(state.stages.size());
+    std::vector<std::vector<VkSpecializationMapEntry>> map_entries(state.stages.size());
+    auto destroy_modules = [this, &modules]()
+    {
+        for(auto shader_module : modules)
+        {
+            if(shader_module != VK_NULL_HANDLE)
+            {
+                vkDestroyShaderModule(device, shader_module, nullptr);
+            }
+        }
+    };
+
+    for(size_t i = 0; i < state.stages.size(); i++)
+    {
+        const ShaderStage& stage = state.stages[i];
+        VkShaderModuleCreateInfo module_info = {};
+        module_info.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+        module_info.codeSize = stage.code.size;
+        module_info.pCode = stage.code.words();
+        if(vkCreateShaderModule(device, &module_info, nullptr, &modules[i]) != VK_SUCCESS)
+        {
+            std::cout << "Failed to create shader module!" << std::endl;
+            destroy_modules();
+            return VK_NULL_HANDLE;
+        }
+
+        for(uint32_t id = 0; id < stage.constants.size(); id++)
+        {
+            VkSpecializationMapEntry map_entry = {};
+            map_entry.constantID = id;
+            map_entry.offset = id * sizeof(uint32_t);
+            map_entry.size = sizeof(uint32_t);
+            map_entries[i].push_back(map_entry);
+        }
+        specialization_infos[i].mapEntryCount = static_cast<uint32_t>(map_entries[i].size());
+        specialization_infos[i].pMapEntries = map_entries[i].data();
+        specialization_infos[i].dataSize = stage.constants.size() * sizeof(uint32_t);
+        specialization_infos[i].pData = stage.constants.data();
+
+        stage_infos[i] = {};
+        stage_infos[i].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        stage_infos[i].stage = stage.stage;
+        stage_infos[i].module = modules[i];
+        stage_infos[i].pName = "main";
+        stage_infos[i].pSpecializationInfo = stage.constants.empty() ? nullptr : &specialization_infos[i];
+    }
+
+    VkPipelineVertexInputStateCreateInfo vertex_input_info = {};
+    vertex_input_info.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+    vertex_input_info.vertexBindingDescriptionCount = static_cast<uint32_t>(state.bindings.size());
+    vertex_input_info.pVertexBindingDescriptions = state.bindings.data();
+    vertex_input_info.vertexAttributeDescriptionCount = static_cast<uint32_t>(state.attributes.size());
+    vertex_input_info.pVertexAttributeDescriptions = state.attributes.data();
+
+    VkPipelineInputAssemblyStateCreateInfo input_assembly = {};
+    input_assembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+    input_assembly.topology = state.topology;
+    input_assembly.primitiveRestartEnable = VK_FALSE;
+
+    VkPipelineViewportStateCreateInfo viewport_state = {};
+    viewport_state.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+    viewport_state.viewportCount = 1;
+    viewport_state.scissorCount = 1;
+
+    VkDynamicState dynamic_states[] = {VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR};
+    VkPipelineDynamicStateCreateInfo dynamic_state = {};
+    dynamic_state.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+    dynamic_state.dynamicStateCount = 2;
+    dynamic_state.pDynamicStates = dynamic_states;
+
+    VkPipelineRasterizationStateCreateInfo rasterizer = {};
+    rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+    rasterizer.depthClampEnable = VK_FALSE;
+    rasterizer.rasterizerDiscardEnable = VK_FALSE;
+    rasterizer.polygonMode = state.polygon_mode;
+    rasterizer.lineWidth = 1.0f;
+    rasterizer.cullMode = state.cull_mode;
+    rasterizer.frontFace = state.front_face;
+    rasterizer.depthBiasEnable = VK_FALSE;
+
+    VkPipelineMultisampleStateCreateInfo multisampling = {};
+    multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+    multisampling.sampleShadingEnable = VK_FALSE;
+    multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+    multisampling.minSampleShading = 1.0f;
+
+    VkPipelineDepthStencilStateCreateInfo depth_stencil = {};
+    depth_stencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+    depth_stencil.depthTestEnable = state.depth_test ? VK_TRUE : VK_FALSE;
+    depth_stencil.depthWriteEnable = state.depth_write ? VK_TRUE : VK_FALSE;
+    depth_stencil.depthCompareOp = state.depth_compare;
+    depth_stencil.depthBoundsTestEnable = VK_FALSE;
+    depth_stencil.stencilTestEnable = VK_FALSE;
+
+    VkPipelineColorBlendAttachmentState color_blend_attachment = {};
+    color_blend_attachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT
+        | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+    color_blend_attachment.blendEnable = state.blend ? VK_TRUE : VK_FALSE;
+    color_blend_attachment.srcColorBlendFactor = state.src_blend;
+    color_blend_attachment.dstColorBlendFactor = state.dst_blend;
+    color_blend_attachment.colorBlendOp = state.blend_op;
+    color_blend_attachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+    color_blend_attachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
+    color_blend_attachment.alphaBlendOp = VK_BLEND_OP_ADD;
+
+    VkPipelineColorBlendStateCreateInfo color_blending = {};
+    color_blending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+    color_blending.logicOpEnable = VK_FALSE;
+    color_blending.attachmentCount = 1;
+    color_blending.pAttachments = &color_blend_attachment;
+
+    //Without a render pass the pipeline only needs to know the attachment formats
+    VkPipelineRenderingCreateInfoKHR rendering_info = {};
+    rendering_info.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO_KHR;
+    rendering_info.colorAttachmentCount = 1;
+    rendering_info.pColorAttachmentFormats = &state.color_format;
+    rendering_info.depthAttachmentFormat = state.depth_format;
+    rendering_info.stencilAttachmentFormat = VK_FORMAT_UNDEFINED;
+
+    VkGraphicsPipelineCreateInfo pipeline_info = {};
+    pipeline_info.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+    pipeline_info.pNext = state.render_pass == VK_NULL_HANDLE ? &rendering_info : nullptr;
+    pipeline_info.stageCount = static_cast<uint32_t>(stage_infos.size());
+    pipeline_info.pStages = stage_infos.data();
+    pipeline_info.pVertexInputState = &vertex_input_info;
+    pipeline_info.pInputAssemblyState = &input_assembly;
+    pipeline_info.pViewportState = &viewport_state;
+    pipeline_info.pRasterizationState = &rasterizer;
+    pipeline_info.pMultisampleState = &multisampling;
+    pipeline_info.pDepthStencilState = &depth_stencil;
+    pipeline_info.pColorBlendState = &color_blending;
+    pipeline_info.pDynamicState = &dynamic_state;
+    pipeline_info.layout = state.layout;
+    pipeline_info.renderPass = state.render_pass;
+    pipeline_info.subpass = 0;
+
+    VkPipeline pipeline = VK_NULL_HANDLE;
+    if(vkCreateGraphicsPipelines(device, pipeline_cache, 1, &pipeline_info, nullptr, &pipeline) != VK_SUCCESS)
+    {
+        std::cout << "Failed to create graphics pipeline!" << std::endl;
+        pipeline = VK_NULL_HANDLE;
+    }
+    destroy_modules();
+    return pipeline;
+}
+
+VkPipeline PipelineStateCache::finishCompile(uint64_t hash, VkPipeline pipeline, double compile_ms)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        Entry& entry = entries[hash];
+        if(entry.discard)
+        {
+            //Nobody has seen it, so it can go right away. getBlocking callers still waiting on it get nothing.
+            if(pipeline != VK_NULL_HANDLE)
+            {
+                vkDestroyPipeline(device, pipeline, nullptr);
+            }
+            entries.erase(hash);
+            pipeline = VK_NULL_HANDLE;
+        }
+        else
+        {
+            entry.pipeline = pipeline;
+            entry.status = pipeline != VK_NULL_HANDLE ? EntryStatus::Ready : EntryStatus::Failed;
+            if(pipeline != VK_NULL_HANDLE)
+            {
+                stats.compiled++;
+                stats.compile_ms += compile_ms;
+                stats.max_compile_ms = std::max(stats.max_compile_ms, compile_ms);
+            }
+            else
+            {
+                stats.failed++;
+            }
+        }
+    }
+    work_done.notify_all();
+    return pipeline;
+}
+
+void PipelineStateCache::workerLoop()
+{
+    while(true)
+    {
+        uint64_t hash = 0;
+        PipelineState state = {};
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            work_ready.wait(lock, [this]() { return stopping || !queue.empty(); });
+            if(stopping)
+            {
+                return;
+            }
+            hash = queue.front();
+            queue.pop_front();
+            //Copied out so the map can change while this thread compiles
+            Entry& entry = entries[hash];
+            entry.status = EntryStatus::Compiling;
+            state = entry.state;
+        }
+
+        auto compile_start = std::chrono::steady_clock::now();
+        VkPipeline pipeline = compile(state);
+        double compile_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - compile_start).count();
+        finishCompile(hash, pipeline, compile_ms);
+    }
+}
@@ -0,0 +1,120 @@
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <deque>
+#include <unordered_map>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <cstdint>
+#include <vulkan/vulkan.h>
+
+#include "asset_loader.h"
+
+//Graphics pipelines keyed by a hash of their full state. Lookups never wait for a compile: a miss queues
+//the state for the compile threads and returns VK_NULL_HANDLE, and the caller draws with a fallback
+//pipeline or skips the draw until the variant is ready.
+class PipelineStateCache
+{
+    public:
+        struct ShaderStage
+        {
+            VkShaderStageFlagBits stage = VK_SHADER_STAGE_VERTEX_BIT;
+            //SPIR-V, kept alive by the asset loader or by the span itself
+            AssetSpan code = {};
+            //From hashCode, so hashing a state doesn't walk the SPIR-V
+            uint64_t code_hash = 0;
+            //Specialization constants, constant_id i gets constants[i]
+            std::vector<uint32_t> constants = {};
+        };
+
+        //Everything that goes into vkCreateGraphicsPipelines. Viewport and scissor are always dynamic.
+        struct PipelineState
+        {
+            std::vector<ShaderStage> stages = {};
+            std::vector<VkVertexInputBindingDescription> bindings = {};
+            std::vector<VkVertexInputAttributeDescription> attributes = {};
+            VkPrimitiveTopology topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+            VkPolygonMode polygon_mode = VK_POLYGON_MODE_FILL;
+            VkCullModeFlags cull_mode = VK_CULL_MODE_BACK_BIT;
+            VkFrontFace front_face = VK_FRONT_FACE_CLOCKWISE;
+            bool depth_test = true;
+            bool depth_write = true;
+            VkCompareOp depth_compare = VK_COMPARE_OP_LESS;
+            bool blend = false;
+            VkBlendFactor src_blend = VK_BLEND_FACTOR_ONE;
+            VkBlendFactor dst_blend = VK_BLEND_FACTOR_ZERO;
+            VkBlendOp blend_op = VK_BLEND_OP_ADD;
+            //Render targets, through a render pass or as formats for dynamic rendering
+            VkRenderPass render_pass = VK_NULL_HANDLE;
+            VkFormat color_format = VK_FORMAT_UNDEFINED;
+            VkFormat depth_format = VK_FORMAT_UNDEFINED;
+            VkPipelineLayout layout = VK_NULL_HANDLE;
+        };
+
+        struct Stats
+        {
+            uint64_t hits = 0;
+            uint64_t misses = 0;
+            uint64_t compiled = 0;
+            uint64_t failed = 0;
+            double compile_ms = 0.0;
+            double max_compile_ms = 0.0;
+        };
+
+        PipelineStateCache();
+        ~PipelineStateCache();
+
+        bool init(VkDevice, VkPipelineCache, uint32_t);
+        void destroy();
+
+        static uint64_t hashCode(const char*, size_t);
+        static uint64_t hashState(const PipelineState&);
+
+        //The pipeline if it has been compiled, otherwise queues it and returns VK_NULL_HANDLE. Thread safe.
+        VkPipeline get(const PipelineState&, uint64_t);
+        //Compiles on the calling thread if nobody else is, for pipelines that have to exist up front.
+        //VK_NULL_HANDLE when compiling fails or the pipeline is released before it is done.
+        VkPipeline getBlocking(const PipelineState&, uint64_t);
+        bool hasFailed(uint64_t);
+        //Forgets a pipeline and hands it back, the caller destroys it once no frame uses it anymore.
+        //Returns VK_NULL_HANDLE if it wasn't compiled yet, a running compile is thrown away when it finishes.
+        VkPipeline release(uint64_t);
+        Stats getStats();
+        void printStats();
+
+    private:
+        enum class EntryStatus
+        {
+            Queued,
+            Compiling,
+            Ready,
+            Failed
+        };
+        struct Entry
+        {
+            PipelineState state = {};
+            VkPipeline pipeline = VK_NULL_HANDLE;
+            EntryStatus status = EntryStatus::Queued;
+            //Released while compiling
+            bool discard = false;
+        };
+
+        VkPipeline compile(const PipelineState&);
+        //Stores the result, or destroys it when the entry was released meanwhile. Returns what was kept.
+        VkPipeline finishCompile(uint64_t, VkPipeline, double);
+        void workerLoop();
+
+        VkDevice device;
+        VkPipelineCache pipeline_cache;
+        std::vector<std::thread> workers;
+        //Guards everything below, never held while compiling
+        std::mutex mutex;
+        std::condition_variable work_ready;
+        std::condition_variable work_done;
+        std::deque<uint64_t> queue;
+        std::unordered_map<uint64_t, Entry> entries;
+        Stats stats;
+        bool stopping;
+};
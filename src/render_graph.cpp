@@ -0,0 +1,644 @@
+#include "render_graph.h"
+
+#include <iostream>
+#include <algorithm>
+
+namespace
+{
+    struct AccessInfo
+    {
+        VkPipelineStageFlags stages;
+        VkAccessFlags access;
+        VkImageLayout layout;
+        VkImageUsageFlags usage;
+        bool write;
+        bool discard;
+    };
+
+    //Indexed by RenderGraph::Access
+    const AccessInfo access_infos[] =
+    {
+        {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+            VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, true, true},
+        {VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+            VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+            VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, true, true},
+        {VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT,
+            VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_USAGE_SAMPLED_BIT, false, false},
+        {VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT,
+            VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_USAGE_STORAGE_BIT, false, false},
+        {VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+            VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_USAGE_STORAGE_BIT, true, false},
+        {VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT,
+            VK_IMAGE_LAYOUT_UNDEFINED, 0, false, false},
+        {VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT,
+            VK_IMAGE_LAYOUT_UNDEFINED, 0, false, false},
+        {VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT,
+            VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_SRC_BIT, false, false},
+        {VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+            VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_DST_BIT, true, false},
+        {VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0,
+            VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, 0, false, false},
+    };
+
+    const VkAccessFlags write_access_mask = VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT
+        | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_HOST_WRITE_BIT
+        | VK_ACCESS_MEMORY_WRITE_BIT;
+
+    const AccessInfo& accessInfo(RenderGraph::Access access)
+    {
+        return access_infos[static_cast<uint32_t>(access)];
+    }
+
+    //Whatever touched the resource before the graph saw it
+    RenderGraph::ResourceState unknownState()
+    {
+        RenderGraph::ResourceState state = {};
+        state.write_stages = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+        state.write_access = VK_ACCESS_MEMORY_WRITE_BIT;
+        return state;
+    }
+}
+
+RenderGraph::RenderGraph()
+{
+    stats = {};
+    device = VK_NULL_HANDLE;
+    allocator = nullptr;
+    defer = {};
+    resources = {};
+    passes = {};
+    transients = {};
+    slots = {};
+}
+
+bool RenderGraph::init(VkDevice logical_device, DeviceAllocator* device_allocator, DeferFunction defer_function)
+{
+    device = logical_device;
+    allocator = device_allocator;
+    defer = std::move(defer_function);
+    return true;
+}
+
+void RenderGraph::destroy()
+{
+    if(device == VK_NULL_HANDLE)
+    {
+        return;
+    }
+
+    for(auto& transient : transients)
+    {
+        vkDestroyImageView(device, transient.view, nullptr);
+        vkDestroyImage(device, transient.image, nullptr);
+    }
+    for(auto& slot : slots)
+    {
+        allocator->free(slot.allocation);
+    }
+    transients.clear();
+    slots.clear();
+    resources.clear();
+    passes.clear();
+    device = VK_NULL_HANDLE;
+}
+
+void RenderGraph::reset()
+{
+    resources.clear();
+    passes.clear();
+    //Redeclared transients lose their state, make them pick it up from the slot again
+    for(auto& slot : slots)
+    {
+        slot.owner = UINT32_MAX;
+    }
+}
+
+uint32_t RenderGraph::importImage(const char* name, VkImage image, VkImageAspectFlags aspect)
+{
+    Resource resource = {};
+    resource.name = name;
+    resource.is_image = true;
+    resource.image = image;
+    resource.desc.aspect = aspect;
+    resource.state = unknownState();
+    resources.push_back(resource);
+    return static_cast<uint32_t>(resources.size() - 1);
+}
+
+uint32_t RenderGraph::importBuffer(const char* name, VkBuffer buffer)
+{
+    Resource resource = {};
+    resource.name = name;
+    resource.buffer = buffer;
+    resource.state = unknownState();
+    resources.push_back(resource);
+    return static_cast<uint32_t>(resources.size() - 1);
+}
+
+uint32_t RenderGraph::createImage(const char* name, const ImageDesc& desc)
+{
+    Resource resource = {};
+    resource.name = name;
+    resource.is_image = true;
+    resource.transient = true;
+    resource.desc = desc;
+    resources.push_back(resource);
+    return static_cast<uint32_t>(resources.size() - 1);
+}
+
+void RenderGraph::setImage(uint32_t resource, VkImage image, const ResourceState& state)
+{
+    resources[resource].image = image;
+    resources[resource].state = state;
+}
+
+void RenderGraph::setBuffer(uint32_t resource, VkBuffer buffer)
+{
+    //A different buffer has no history in this graph
+    if(resources[resource].buffer != buffer)
+    {
+        resources[resource].buffer = buffer;
+        resources[resource].state = unknownState();
+    }
+}
+
+uint32_t RenderGraph::addPass(const char* name, ExecuteFunction execute)
+{
+    Pass pass = {};
+    pass.name = name;
+    pass.execute = std::move(execute);
+    passes.push_back(std::move(pass));
+    return static_cast<uint32_t>(passes.size() - 1);
+}
+
+void RenderGraph::use(uint32_t pass, uint32_t resource, Access access)
+{
+    const AccessInfo& info = accessInfo(access);
+    resources[resource].usage |= info.usage;
+
+    //Several uses of one resource in a pass merge into one, the first layout wins
+    for(auto& existing : passes[pass].uses)
+    {
+        if(existing.resource == resource)
+        {
+            existing.stages |= info.stages;
+            existing.access |= info.access;
+            existing.discard = existing.discard && info.discard;
+            existing.write = existing.write || info.write;
+            return;
+        }
+    }
+
+    PassUse pass_use = {};
+    pass_use.resource = resource;
+    pass_use.stages = info.stages;
+    pass_use.access = info.access;
+    pass_use.layout = info.layout;
+    pass_use.write = info.write;
+    pass_use.discard = info.discard;
+    passes[pass].uses.push_back(pass_use);
+}
+
+void RenderGraph::keep(uint32_t pass)
+{
+    passes[pass].keep = true;
+}
+
+void RenderGraph::markOutput(uint32_t resource, Access final_access)
+{
+    resources[resource].output = true;
+    resources[resource].final_access = final_access;
+    resources[resource].usage |= accessInfo(final_access).usage;
+}
+
+bool RenderGraph::compile()
+{
+    //Walk backwards from the outputs. A pass survives if it writes something a surviving pass or the
+    //outside world reads; imported resources always count as read by the outside world.
+    std::vector<bool> needed(resources.size(), false);
+    for(size_t i = 0; i < resources.size(); i++)
+    {
+        needed[i] = resources[i].output;
+    }
+    stats.passes = static_cast<uint32_t>(passes.size());
+    stats.culled_passes = 0;
+    for(size_t i = passes.size(); i-- > 0;)
+    {
+        Pass& pass = passes[i];
+        bool used = pass.keep;
+        for(const auto& pass_use : pass.uses)
+        {
+            if(pass_use.write && (needed[pass_use.resource] || !resources[pass_use.resource].transient))
+            {
+                used = true;
+            }
+        }
+        pass.culled = !used;
+        if(!used)
+        {
+            stats.culled_passes++;
+            continue;
+        }
+        //A discarding write doesn't care what came before it, anything else depends on earlier writers
+        for(const auto& pass_use : pass.uses)
+        {
+            needed[pass_use.resource] = !(pass_use.write && pass_use.discard);
+        }
+    }
+
+    for(size_t i = 0; i < passes.size(); i++)
+    {
+        if(passes[i].culled)
+        {
+            continue;
+        }
+        for(const auto& pass_use : passes[i].uses)
+        {
+            Resource& resource = resources[pass_use.resource];
+            resource.first_pass = std::min(resource.first_pass, static_cast<uint32_t>(i));
+            resource.last_pass = std::max(resource.last_pass, static_cast<uint32_t>(i));
+        }
+    }
+
+    return createTransients();
+}
+
+bool RenderGraph::createTransients()
+{
+    //Transients only used by culled passes are never created
+    std::vector<uint32_t> used_transients = {};
+    for(size_t i = 0; i < resources.size(); i++)
+    {
+        if(resources[i].transient && resources[i].first_pass != UINT32_MAX)
+        {
+            used_transients.push_back(static_cast<uint32_t>(i));
+        }
+    }
+    std::sort(used_transients.begin(), used_transients.end(), [this](uint32_t a, uint32_t b)
+    {
+        return resources[a].first_pass < resources[b].first_pass;
+    });
+
+    //The same declarations and lifetimes keep the images and their memory from the last compile
+    bool unchanged = used_transients.size() == transients.size();
+    for(size_t i = 0; unchanged && i < used_transients.size(); i++)
+    {
+        const Resource& resource = resources[used_transients[i]];
+        const TransientImage& transient = transients[i];
+        unchanged = transient.name == resource.name && transient.usage == resource.usage
+            && transient.desc.format == resource.desc.format && transient.desc.aspect == resource.desc.aspect
+            && transient.desc.extent.width == resource.desc.extent.width
+            && transient.desc.extent.height == resource.desc.extent.height
+            && transient.first_pass == resource.first_pass && transient.last_pass == resource.last_pass;
+    }
+    if(!unchanged)
+    {
+        releaseTransients();
+    }
+
+    for(size_t i = 0; i < used_transients.size(); i++)
+    {
+        Resource& resource = resources[used_transients[i]];
+        if(unchanged)
+        {
+            resource.image = transients[i].image;
+            resource.view = transients[i].view;
+            resource.slot = transients[i].slot;
+            continue;
+        }
+
+        TransientImage transient = {};
+        transient.name = resource.name;
+        transient.desc = resource.desc;
+        transient.usage = resource.usage;
+        transient.first_pass = resource.first_pass;
+        transient.last_pass = resource.last_pass;
+
+        VkImageCreateInfo image_info = {};
+        image_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        image_info.imageType = VK_IMAGE_TYPE_2D;
+        image_info.format = resource.desc.format;
+        image_info.extent = {resource.desc.extent.width, resource.desc.extent.height, 1};
+        image_info.mipLevels = 1;
+        image_info.arrayLayers = 1;
+        image_info.samples = VK_SAMPLE_COUNT_1_BIT;
+        image_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+        image_info.usage = resource.usage;
+        image_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        image_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        if(vkCreateImage(device, &image_info, nullptr, &transient.image) != VK_SUCCESS)
+        {
+            std::cout << "Failed to create transient image " << resource.name << "!" << std::endl;
+            return false;
+        }
+
+        //First slot whose occupants are all dead before this image is born, and whose memory type fits
+        VkMemoryRequirements requirements = {};
+        vkGetImageMemoryRequirements(device, transient.image, &requirements);
+        stats.unaliased_bytes += requirements.size;
+        uint32_t slot_index = UINT32_MAX;
+        for(uint32_t s = 0; s < slots.size(); s++)
+        {
+            if(slots[s].last_pass < resource.first_pass
+                && (slots[s].requirements.memoryTypeBits & requirements.memoryTypeBits) != 0)
+            {
+                slot_index = s;
+                break;
+            }
+        }
+        if(slot_index == UINT32_MAX)
+        {
+            MemorySlot slot = {};
+            slot.requirements = requirements;
+            slots.push_back(slot);
+            slot_index = static_cast<uint32_t>(slots.size() - 1);
+        }
+        else
+        {
+            VkMemoryRequirements& shared = slots[slot_index].requirements;
+            shared.size = std::max(shared.size, requirements.size);
+            shared.alignment = std::max(shared.alignment, requirements.alignment);
+            shared.memoryTypeBits &= requirements.memoryTypeBits;
+        }
+        slots[slot_index].last_pass = resource.last_pass;
+        transient.slot = slot_index;
+        resource.image = transient.image;
+        resource.slot = slot_index;
+        transients.push_back(transient);
+    }
+    if(unchanged)
+    {
+        return true;
+    }
+
+    stats.transient_images = static_cast<uint32_t>(transients.size());
+    stats.transient_bytes = 0;
+    for(auto& slot : slots)
+    {
+        if(!allocator->allocate(slot.requirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 0, ResourceKind::Optimal, &slot.allocation))
+        {
+            std::cout << "Failed to allocate transient image memory!" << std::endl;
+            return false;
+        }
+        stats.transient_bytes += slot.requirements.size;
+    }
+
+    for(size_t i = 0; i < transients.size(); i++)
+    {
+        TransientImage& transient = transients[i];
+        const MemorySlot& slot = slots[transient.slot];
+        if(vkBindImageMemory(device, transient.image, slot.allocation.memory, slot.allocation.offset) != VK_SUCCESS)
+        {
+            std::cout << "Failed to bind transient image " << transient.name << "!" << std::endl;
+            return false;
+        }
+
+        //Views of combined depth/stencil images only show depth, shaders can't sample both at once
+        VkImageViewCreateInfo view_info = {};
+        view_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+        view_info.image = transient.image;
+        view_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        view_info.format = transient.desc.format;
+        view_info.subresourceRange.aspectMask = (transient.desc.aspect & VK_IMAGE_ASPECT_DEPTH_BIT)
+            ? static_cast<VkImageAspectFlags>(VK_IMAGE_ASPECT_DEPTH_BIT) : transient.desc.aspect;
+        view_info.subresourceRange.baseMipLevel = 0;
+        view_info.subresourceRange.levelCount = 1;
+        view_info.subresourceRange.baseArrayLayer = 0;
+        view_info.subresourceRange.layerCount = 1;
+        if(vkCreateImageView(device, &view_info, nullptr, &transient.view) != VK_SUCCESS)
+        {
+            std::cout << "Failed to create transient image view " << transient.name << "!" << std::endl;
+            return false;
+        }
+        resources[used_transients[i]].view = transient.view;
+    }
+
+    return true;
+}
+
+void RenderGraph::releaseTransients()
+{
+    if(transients.empty())
+    {
+        return;
+    }
+
+    VkDevice device_handle = device;
+    DeviceAllocator* allocator_ptr = allocator;
+    std::vector<TransientImage> old_transients = transients;
+    std::vector<MemorySlot> old_slots = slots;
+    defer([device_handle, allocator_ptr, old_transients, old_slots]() mutable
+    {
+        for(auto& transient : old_transients)
+        {
+            vkDestroyImageView(device_handle, transient.view, nullptr);
+            vkDestroyImage(device_handle, transient.image, nullptr);
+        }
+        for(auto& slot : old_slots)
+        {
+            allocator_ptr->free(slot.allocation);
+        }
+    });
+    transients.clear();
+    slots.clear();
+    stats.unaliased_bytes = 0;
+}
+
+void RenderGraph::addBarrier(Resource& resource, const PassUse& pass_use, std::vector<VkImageMemoryBarrier>& image_barriers,
+    VkMemoryBarrier& memory_barrier, VkPipelineStageFlags* src_stages, VkPipelineStageFlags* dst_stages)
+{
+    ResourceState& state = resource.state;
+
+    //A slot that last held another image starts this one from scratch, after the other one is done
+    MemorySlot* slot = resource.transient ? &slots[resource.slot] : nullptr;
+    uint32_t resource_index = static_cast<uint32_t>(&resource - resources.data());
+    if(slot != nullptr && slot->owner != resource_index)
+    {
+        state = {};
+        state.write_stages = slot->owner_stages;
+        state.write_access = slot->owner_write_access;
+    }
+
+    bool layout_change = resource.is_image && state.layout != pass_use.layout;
+    VkPipelineStageFlags wait_stages = 0;
+    VkAccessFlags wait_access = 0;
+    if(pass_use.write || layout_change)
+    {
+        //Writes and transitions wait for every earlier access, reads included
+        wait_stages = state.write_stages | state.read_stages;
+        wait_access = state.write_access;
+    }
+    else if(state.write_stages != 0
+        && ((pass_use.stages & ~state.read_stages) != 0 || (pass_use.access & ~state.visible_access) != 0))
+    {
+        //A read that hasn't seen the last write yet
+        wait_stages = state.write_stages;
+        wait_access = state.write_access;
+    }
+
+    if(wait_stages != 0 || layout_change)
+    {
+        *src_stages |= wait_stages;
+        *dst_stages |= pass_use.stages;
+        if(resource.is_image)
+        {
+            VkImageMemoryBarrier barrier = {};
+            barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+            barrier.srcAccessMask = wait_access;
+            barrier.dstAccessMask = pass_use.access;
+            barrier.oldLayout = pass_use.discard ? VK_IMAGE_LAYOUT_UNDEFINED : state.layout;
+            barrier.newLayout = pass_use.layout;
+            barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.image = resource.image;
+            barrier.subresourceRange.aspectMask = resource.desc.aspect;
+            barrier.subresourceRange.baseMipLevel = 0;
+            barrier.subresourceRange.levelCount = VK_REMAINING_MIP_LEVELS;
+            barrier.subresourceRange.baseArrayLayer = 0;
+            barrier.subresourceRange.layerCount = VK_REMAINING_ARRAY_LAYERS;
+            image_barriers.push_back(barrier);
+        }
+        else if(wait_access != 0)
+        {
+            //Buffers share one global barrier, per buffer ranges buy nothing on current hardware
+            memory_barrier.srcAccessMask |= wait_access;
+            memory_barrier.dstAccessMask |= pass_use.access;
+        }
+    }
+
+    if(pass_use.write)
+    {
+        state.write_stages = pass_use.stages;
+        state.write_access = pass_use.access & write_access_mask;
+        state.read_stages = 0;
+        state.visible_access = 0;
+    }
+    else if(layout_change)
+    {
+        //The transition acts as a write the reading stages have already waited for
+        state.write_stages = pass_use.stages;
+        state.write_access = 0;
+        state.read_stages = pass_use.stages;
+        state.visible_access = pass_use.access;
+    }
+    else
+    {
+        state.read_stages |= pass_use.stages;
+        if(wait_stages != 0)
+        {
+            state.visible_access |= pass_use.access;
+        }
+    }
+    if(resource.is_image)
+    {
+        state.layout = pass_use.layout;
+    }
+
+    if(slot != nullptr)
+    {
+        slot->owner = resource_index;
+        slot->owner_stages = state.write_stages | state.read_stages;
+        slot->owner_write_access = state.write_access;
+    }
+}
+
+bool RenderGraph::execute(VkCommandBuffer command_buffer, uint32_t first_pass, uint32_t end_pass)
+{
+    std::vector<VkImageMemoryBarrier> image_barriers = {};
+    auto flush_barriers = [this, command_buffer, &image_barriers](VkMemoryBarrier& memory_barrier,
+        VkPipelineStageFlags src_stages, VkPipelineStageFlags dst_stages)
+    {
+        if(dst_stages == 0)
+        {
+            return;
+        }
+        //Nothing to wait for, only a layout transition
+        if(src_stages == 0)
+        {
+            src_stages = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+        }
+        bool memory = memory_barrier.srcAccessMask != 0;
+        vkCmdPipelineBarrier(command_buffer, src_stages, dst_stages,
+            0, memory ? 1 : 0, &memory_barrier, 0, nullptr, static_cast<uint32_t>(image_barriers.size()), image_barriers.data());
+        stats.barrier_batches++;
+        stats.image_barriers += image_barriers.size();
+        stats.memory_barriers += memory ? 1 : 0;
+    };
+
+    end_pass = std::min(end_pass, static_cast<uint32_t>(passes.size()));
+    for(uint32_t pass_index = first_pass; pass_index < end_pass; pass_index++)
+    {
+        Pass& pass = passes[pass_index];
+        if(pass.culled)
+        {
+            continue;
+        }
+
+        //Everything the pass waits on goes into a single barrier in front of it
+        image_barriers.clear();
+        VkMemoryBarrier memory_barrier = {};
+        memory_barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        VkPipelineStageFlags src_stages = 0;
+        VkPipelineStageFlags dst_stages = 0;
+        for(const auto& pass_use : pass.uses)
+        {
+            addBarrier(resources[pass_use.resource], pass_use, image_barriers, memory_barrier, &src_stages, &dst_stages);
+        }
+        flush_barriers(memory_barrier, src_stages, dst_stages);
+
+        if(!pass.execute(command_buffer))
+        {
+            std::cout << "Failed to record render graph pass " << pass.name << "!" << std::endl;
+            return false;
+        }
+    }
+
+    if(end_pass < passes.size())
+    {
+        return true;
+    }
+
+    //Hand the outputs over in the state whoever comes after the graph expects
+    image_barriers.clear();
+    VkMemoryBarrier memory_barrier = {};
+    memory_barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    VkPipelineStageFlags src_stages = 0;
+    VkPipelineStageFlags dst_stages = 0;
+    for(auto& resource : resources)
+    {
+        if(!resource.output)
+        {
+            continue;
+        }
+        const AccessInfo& info = accessInfo(resource.final_access);
+        PassUse final_use = {};
+        final_use.stages = info.stages;
+        final_use.access = info.access;
+        final_use.layout = info.layout;
+        addBarrier(resource, final_use, image_barriers, memory_barrier, &src_stages, &dst_stages);
+    }
+    flush_barriers(memory_barrier, src_stages, dst_stages);
+    stats.executions++;
+    return true;
+}
+
+VkImage RenderGraph::image(uint32_t resource) const
+{
+    return resources[resource].image;
+}
+
+VkImageView RenderGraph::imageView(uint32_t resource) const
+{
+    return resources[resource].view;
+}
+
+void RenderGraph::printStats() const
+{
+    double batches_per_frame = stats.executions > 0 ? static_cast<double>(stats.barrier_batches) / stats.executions : 0.0;
+    double images_per_frame = stats.executions > 0 ? static_cast<double>(stats.image_barriers) / stats.executions : 0.0;
+    std::cout << "Render graph: " << stats.passes - stats.culled_passes << " of " << stats.passes << " passes live, "
+        << batches_per_frame << " barrier batches and " << images_per_frame << " image barriers per frame, "
+        << stats.transient_images << " transient images in " << stats.transient_bytes / 1024 << " KiB ("
+        << stats.unaliased_bytes / 1024 << " KiB without aliasing)" << std::endl;
+}
@@ -0,0 +1,176 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <functional>
+#include <cstdint>
+#include <vulkan/vulkan.h>
+#include "memory_allocator.h"
+
+//Frame graph of passes that declare how they touch images and buffers. Barriers and layout transitions
+//are derived from those declarations when the graph executes, one batched vkCmdPipelineBarrier in front
+//of every pass that needs one. Passes whose results nobody uses are culled at compile time, and
+//transient images with disjoint lifetimes share memory.
+class RenderGraph
+{
+    public:
+        //Records the pass, returning false fails the whole execution
+        using ExecuteFunction = std::function<bool(VkCommandBuffer)>;
+
+        //How a pass uses a resource. Attachment writes discard the old contents (the render pass clears).
+        enum class Access : uint32_t
+        {
+            ColorAttachmentWrite = 0,
+            DepthAttachmentWrite,
+            ComputeSampledRead,
+            ComputeStorageRead,
+            ComputeStorageWrite,
+            IndirectRead,
+            VertexRead,
+            TransferRead,
+            TransferWrite,
+            //Only valid as an output's final access
+            Present,
+            Count
+        };
+
+        //Synchronization state of a resource since its last write
+        struct ResourceState
+        {
+            VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+            VkPipelineStageFlags write_stages = 0;
+            VkAccessFlags write_access = 0;
+            //Stages and accesses that have already waited for the last write
+            VkPipelineStageFlags read_stages = 0;
+            VkAccessFlags visible_access = 0;
+        };
+
+        struct ImageDesc
+        {
+            VkFormat format = VK_FORMAT_UNDEFINED;
+            VkExtent2D extent = {};
+            VkImageAspectFlags aspect = VK_IMAGE_ASPECT_COLOR_BIT;
+        };
+
+        struct Stats
+        {
+            uint32_t passes = 0;
+            uint32_t culled_passes = 0;
+            uint32_t transient_images = 0;
+            VkDeviceSize transient_bytes = 0;
+            //Memory the transients would need without aliasing
+            VkDeviceSize unaliased_bytes = 0;
+            uint64_t executions = 0;
+            uint64_t barrier_batches = 0;
+            uint64_t image_barriers = 0;
+            uint64_t memory_barriers = 0;
+        };
+
+        RenderGraph();
+
+        bool init(VkDevice, DeviceAllocator*, DeferFunction);
+        //The device must be idle
+        void destroy();
+
+        //Drops every pass and resource declaration, transients are kept until compile knows if they changed.
+        //Imports start out assuming any earlier access, so the first use after a rebuild fully waits.
+        void reset();
+        uint32_t importImage(const char*, VkImage, VkImageAspectFlags);
+        uint32_t importBuffer(const char*, VkBuffer);
+        uint32_t createImage(const char*, const ImageDesc&);
+        //Point an import at another handle, a new handle starts from state
+        void setImage(uint32_t, VkImage, const ResourceState&);
+        void setBuffer(uint32_t, VkBuffer);
+        uint32_t addPass(const char*, ExecuteFunction);
+        void use(uint32_t, uint32_t, Access);
+        //Never cull the pass, it has effects the graph can't see
+        void keep(uint32_t);
+        //The resource is consumed after the graph, the last pass leaves it ready for the given access
+        void markOutput(uint32_t, Access);
+
+        //Cull passes and create transient images. Call after declaring the graph and before execute.
+        bool compile();
+        //Records the passes from first up to but not including end, so a frame can be split across submits.
+        //The outputs are handed over by the call that records the last pass.
+        bool execute(VkCommandBuffer, uint32_t = 0, uint32_t = UINT32_MAX);
+
+        VkImage image(uint32_t) const;
+        VkImageView imageView(uint32_t) const;
+        void printStats() const;
+
+        Stats stats;
+
+    private:
+        struct Resource
+        {
+            std::string name = {};
+            bool is_image = false;
+            bool transient = false;
+            VkImage image = VK_NULL_HANDLE;
+            VkImageView view = VK_NULL_HANDLE;
+            VkBuffer buffer = VK_NULL_HANDLE;
+            ImageDesc desc = {};
+            VkImageUsageFlags usage = 0;
+            ResourceState state = {};
+            bool output = false;
+            Access final_access = Access::Count;
+            //Memory slot of a transient image, and the pass range it is alive in
+            uint32_t slot = UINT32_MAX;
+            uint32_t first_pass = UINT32_MAX;
+            uint32_t last_pass = 0;
+        };
+        struct PassUse
+        {
+            uint32_t resource = 0;
+            VkPipelineStageFlags stages = 0;
+            VkAccessFlags access = 0;
+            VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+            bool write = false;
+            bool discard = false;
+        };
+        struct Pass
+        {
+            std::string name = {};
+            ExecuteFunction execute = {};
+            std::vector<PassUse> uses = {};
+            bool keep = false;
+            bool culled = false;
+        };
+        //Memory shared by transient images that are never alive at the same time
+        struct MemorySlot
+        {
+            VkMemoryRequirements requirements = {};
+            MemoryAllocation allocation = {};
+            uint32_t last_pass = 0;
+            //Occupant that touched the memory last and the stages it did so in
+            uint32_t owner = UINT32_MAX;
+            VkPipelineStageFlags owner_stages = 0;
+            VkAccessFlags owner_write_access = 0;
+        };
+        //Created images survive recompiles as long as the declarations don't change
+        struct TransientImage
+        {
+            std::string name = {};
+            ImageDesc desc = {};
+            VkImageUsageFlags usage = 0;
+            VkImage image = VK_NULL_HANDLE;
+            VkImageView view = VK_NULL_HANDLE;
+            uint32_t slot = 0;
+            uint32_t first_pass = 0;
+            uint32_t last_pass = 0;
+        };
+
+        bool createTransients();
+        void releaseTransients();
+        void addBarrier(Resource&, const PassUse&, std::vector<VkImageMemoryBarrier>&, VkMemoryBarrier&,
+            VkPipelineStageFlags*, VkPipelineStageFlags*);
+
+        VkDevice device;
+        DeviceAllocator* allocator;
+        DeferFunction defer;
+
+        std::vector<Resource> resources;
+        std::vector<Pass> passes;
+        std::vector<TransientImage> transients;
+        std::vector<MemorySlot> slots;
+};
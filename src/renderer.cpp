@@ -0,0 +1,3009 @@
+#include "renderer.h"
+
+#include <iostream>
+#include <set>
+#include <cstring>
+#include <optional>
+#include <limits> // Necessary for std::numeric_limits
+#include <algorithm> // Necessary for std::clamp
+#include <fstream>
+#include <cstdlib> // Necessary for getenv
+#include <cstdio> // Necessary for std::rename
+#include <cmath>
+#include <thread>
+#include <memory>
+#include "SDL_vulkan.h"
+#include "frame_trace.h"
+#include "device_selection.h"
+
+//Vertex buffer binding 0. The attributes are reflected from the vertex shader's inputs, which have to
+//match these members in order and size.
+struct Vertex
+{
+    float position[2];
+    float color[3];
+};
+
+const std::vector<Vertex> vertices = {
+    {{0.0f, -0.5f}, {1.0f, 0.0f, 0.0f}},
+    {{0.5f, 0.5f}, {0.0f, 1.0f, 0.0f}},
+    {{-0.5f, 0.5f}, {0.0f, 0.0f, 1.0f}}
+};
+
+const std::vector<uint16_t> vertex_indices = {0, 1, 2};
+//Half size of the mesh's bounding square in model space, used for culling
+const float mesh_half_extent = 0.5f;
+
+//Per object data, streamed to the vertex shader at instance rate and read by the cull shader.
+//Laid out to match the std430 struct in cull.comp. Vertex buffer binding 1, from instance_first_location on.
+struct InstanceData
+{
+    float offset[3];
+    float scale;
+};
+const uint32_t instance_first_location = 2;
+
+//Per frame shader data, written into the uniform ring every frame. Matches FrameData in shader.vert.
+struct FrameData
+{
+    float time;
+    //How far the brightness wave darkens the objects, 0 turns it off
+    float pulse;
+};
+
+//Per draw group data, pushed before the group's draws. Matches DrawData in shader.vert.
+struct DrawData
+{
+    float phase;
+    //Bindless heap slot of the group's palette, or the palette index when every palette has its own set
+    uint32_t palette;
+};
+
+//Tints cycled through per instance, one palette per draw group
+const uint32_t palette_count = 4;
+const uint32_t palette_colors = 4;
+const float palettes[palette_count][palette_colors][4] = {
+    {{1.0f, 1.0f, 1.0f, 1.0f}, {0.9f, 0.9f, 0.9f, 1.0f}, {0.8f, 0.8f, 0.8f, 1.0f}, {0.7f, 0.7f, 0.7f, 1.0f}},
+    {{1.0f, 0.6f, 0.6f, 1.0f}, {1.0f, 0.8f, 0.5f, 1.0f}, {0.9f, 0.5f, 0.4f, 1.0f}, {1.0f, 0.7f, 0.7f, 1.0f}},
+    {{0.6f, 1.0f, 0.6f, 1.0f}, {0.5f, 0.9f, 0.8f, 1.0f}, {0.7f, 1.0f, 0.5f, 1.0f}, {0.6f, 0.8f, 0.6f, 1.0f}},
+    {{0.6f, 0.6f, 1.0f, 1.0f}, {0.8f, 0.5f, 1.0f, 1.0f}, {0.5f, 0.8f, 1.0f, 1.0f}, {0.7f, 0.7f, 0.9f, 1.0f}},
+};
+
+static VKAPI_ATTR VkBool32 VKAPI_CALL debugCallback(
+    VkDebugUtilsMessageSeverityFlagBitsEXT message_severity,
+    VkDebugUtilsMessageTypeFlagsEXT message_type,
+    const VkDebugUtilsMessengerCallbackDataEXT* p_callback_data,
+    void* p_user_data) {
+
+    std::cerr << "validation layer: " << p_callback_data->pMessage << std::endl;
+
+    if(message_severity == VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT 
+        || message_severity == VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT)
+    {
+        std::cout << "WARNING/ERROR" << std::endl;
+    }
+
+    return VK_FALSE;
+}
+
+VkResult CreateDebugUtilsMessengerEXT(VkInstance instance, const VkDebugUtilsMessengerCreateInfoEXT* pCreateInfo, const VkAllocationCallbacks* pAllocator, VkDebugUtilsMessengerEXT* pDebugMessenger) {
+    auto func = (PFN_vkCreateDebugUtilsMessengerEXT) vkGetInstanceProcAddr(instance, "vkCreateDebugUtilsMessengerEXT");
+    if (func != nullptr) {
+        return func(instance, pCreateInfo, pAllocator, pDebugMessenger);
+    } else {
+        return VK_ERROR_EXTENSION_NOT_PRESENT;
+    }
+}
+
+void DestroyDebugUtilsMessengerEXT(VkInstance instance, VkDebugUtilsMessengerEXT debugMessenger, const VkAllocationCallbacks* pAllocator) {
+    auto func = (PFN_vkDestroyDebugUtilsMessengerEXT) vkGetInstanceProcAddr(instance, "vkDestroyDebugUtilsMessengerEXT");
+    if (func != nullptr) {
+        func(instance, debugMessenger, pAllocator);
+    }
+}
+
+const char* latencyPolicyName(LatencyPolicy policy)
+{
+    switch(policy)
+    {
+        case LatencyPolicy::LowLatency:
+            return "low-latency";
+        case LatencyPolicy::PowerSaving:
+            return "power-saving";
+        case LatencyPolicy::Throughput:
+            return "throughput";
+    }
+    return "unknown";
+}
+
+const char* drawPathName(DrawPath path)
+{
+    switch(path)
+    {
+        case DrawPath::PerObject:
+            return "per-object";
+        case DrawPath::Indirect:
+            return "indirect";
+        case DrawPath::MultiIndirect:
+            return "multi-indirect";
+    }
+    return "unknown";
+}
+
+void Renderer::deferDestroy(std::function<void()> destroy)
+{
+    //Every frame submitted so far may still reference the object
+    DeferredDeletion deletion = {};
+    deletion.last_use = submitted_frames;
+    deletion.destroy = std::move(destroy);
+    deletion_queue.push_back(std::move(deletion));
+}
+
+void Renderer::collectRetiredObjects()
+{
+    //Frames retire in submission order, so the newest signaled fence covers every frame before it
+    for(uint32_t i = 0; i < max_frames_in_flight; i++)
+    {
+        if(frame_submit_indices[i] > completed_frames && vkGetFenceStatus(device, in_flight_fences[i]) == VK_SUCCESS)
+        {
+            completed_frames = frame_submit_indices[i];
+        }
+    }
+
+    while(!deletion_queue.empty() && deletion_queue.front().last_use <= completed_frames)
+    {
+        deletion_queue.front().destroy();
+        deletion_queue.pop_front();
+    }
+    upload_manager.collect(completed_frames);
+    capture.collect(completed_frames);
+}
+
+bool Renderer::createSyncObjects()
+{
+    frame_submit_indices.resize(max_frames_in_flight, 0);
+    image_available_semaphores.resize(max_frames_in_flight);
+    render_finished_semaphores.resize(max_frames_in_flight);
+    in_flight_fences.resize(max_frames_in_flight);
+    images_in_flight.resize(swap_chain_images.size(), VK_NULL_HANDLE);
+
+    VkSemaphoreCreateInfo semaphore_info = {};
+    semaphore_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+    VkFenceCreateInfo fence_info = {};
+    fence_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+    fence_info.flags = VK_FENCE_CREATE_SIGNALED_BIT; //If we don't do this, will hang on first pass of drawFrame()
+
+    for(uint32_t i = 0; i < max_frames_in_flight; i++)
+    {
+        if(vkCreateSemaphore(device, &semaphore_info, nullptr, &image_available_semaphores[i]) != VK_SUCCESS
+            || vkCreateSemaphore(device, &semaphore_info, nullptr, &render_finished_semaphores[i]) != VK_SUCCESS
+            || vkCreateFence(device, &fence_info, nullptr, &in_flight_fences[i]) != VK_SUCCESS)
+            {
+                std::cout << "Failed to create semaphores!" << std::endl;
+                return false;
+            }
+    }
+
+    if(async_compute)
+    {
+        VkSemaphoreTypeCreateInfo type_info = {};
+        type_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+        type_info.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+        type_info.initialValue = 0;
+        semaphore_info.pNext = &type_info;
+        if(vkCreateSemaphore(device, &semaphore_info, nullptr, &graphics_timeline) != VK_SUCCESS
+            || vkCreateSemaphore(device, &semaphore_info, nullptr, &compute_timeline) != VK_SUCCESS)
+        {
+            std::cout << "Failed to create timeline semaphores!" << std::endl;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool Renderer::submitAsyncCompute()
+{
+    VkCommandBuffer command_buffer = compute_command_buffers[current_frame];
+    vkResetCommandBuffer(command_buffer, 0);
+
+    VkCommandBufferBeginInfo begin_info = {};
+    begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    if(vkBeginCommandBuffer(command_buffer, &begin_info) != VK_SUCCESS)
+    {
+        std::cout << "Failed to begin recording compute command buffer!" << std::endl;
+        return false;
+    }
+    //The GPU profiler's queries belong to the graphics queue, so the cull has no scope of its own here
+    culling.recordCull(command_buffer, current_frame);
+    if(vkEndCommandBuffer(command_buffer) != VK_SUCCESS)
+    {
+        std::cout << "Failed to record compute command buffer!" << std::endl;
+        return false;
+    }
+
+    //The cull reads last frame's depth pyramid, signaled as soon as that is built, and instances the
+    //transfer queue may have just written. Its draw and count buffers belong to this frame slot, whose
+    //fence has been waited on. Both waits are on timelines, so neither needs a pairing signal.
+    if(!upload_manager.flush())
+    {
+        return false;
+    }
+    uint64_t frame_index = submitted_frames + 1;
+    VkSemaphore wait_semaphores[] = {graphics_timeline, upload_manager.timelineSemaphore()};
+    uint64_t wait_values[] = {submitted_frames, upload_manager.submittedValue()};
+    VkPipelineStageFlags wait_stages[] = {VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT};
+
+    VkTimelineSemaphoreSubmitInfo timeline_info = {};
+    timeline_info.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+    timeline_info.waitSemaphoreValueCount = 2;
+    timeline_info.pWaitSemaphoreValues = wait_values;
+    timeline_info.signalSemaphoreValueCount = 1;
+    timeline_info.pSignalSemaphoreValues = &frame_index;
+
+    VkSubmitInfo submit_info = {};
+    submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submit_info.pNext = &timeline_info;
+    submit_info.waitSemaphoreCount = 2;
+    submit_info.pWaitSemaphores = wait_semaphores;
+    submit_info.pWaitDstStageMask = wait_stages;
+    submit_info.commandBufferCount = 1;
+    submit_info.pCommandBuffers = &command_buffer;
+    submit_info.signalSemaphoreCount = 1;
+    submit_info.pSignalSemaphores = &compute_timeline;
+
+    VkResult submit_result = VK_SUCCESS;
+    {
+        ScopedTimer timer("compute_submit");
+        submit_result = vkQueueSubmit(compute_queue, 1, &submit_info, VK_NULL_HANDLE);
+    }
+    if(submit_result != VK_SUCCESS)
+    {
+        std::cout << "Failed to submit compute command buffer!" << std::endl;
+        return false;
+    }
+
+    //The graphics submission of the same frame draws what the cull wrote, and its depth pyramid pass
+    //rewrites the pyramid the cull is reading
+    frame_wait_semaphores.push_back(compute_timeline);
+    frame_wait_stages.push_back(VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT);
+    frame_wait_values.push_back(frame_index);
+    return true;
+}
+
+void Renderer::waitForPresents()
+{
+    if(!present_wait || presented_id >= present_id)
+    {
+        return;
+    }
+    //Waiting for the newest present covers the ones before it, checking goes through them in order
+    bool block = latency_policy != LatencyPolicy::Throughput;
+    ScopedTimer timer("present_wait", TraceCategory::PresentWait);
+    for(uint64_t id = block ? present_id : presented_id + 1; id <= present_id; id++)
+    {
+        VkResult result = wait_for_present(device, swap_chain, id, block ? present_wait_timeout : 0);
+        if(result == VK_TIMEOUT)
+        {
+            break;
+        }
+        if(result != VK_SUCCESS)
+        {
+            //Out of date or lost, the swap chain is recreated and its presents won't report anymore
+            framebuffer_resized = true;
+            presented_id = present_id;
+            presented_time = std::chrono::steady_clock::now();
+            break;
+        }
+        presented_id = id;
+        presented_time = std::chrono::steady_clock::now();
+    }
+}
+
+bool Renderer::drawFrame()
+{
+    waitForPresents();
+
+    // Wait until the GPU is done with the frame that last used this slot
+    {
+        ScopedTimer timer("fence_wait", TraceCategory::GpuWait);
+        vkWaitForFences(device, 1, &in_flight_fences[current_frame], VK_TRUE, UINT64_MAX);
+    }
+    collectRetiredObjects();
+    if(gpu_cull)
+    {
+        culling.readResults(current_frame);
+    }
+    if(hot_reload)
+    {
+        updateShaders();
+    }
+
+    if(framebuffer_resized)
+    {
+        if(!recreateSwapChain())
+        {
+            return false;
+        }
+        if(framebuffer_resized)
+        {
+            // Still minimized, nothing to draw into
+            return true;
+        }
+    }
+
+    // Acquire image from swapchain, or just cycle through the offscreen targets
+    uint32_t image_index = 0;
+    if(headless)
+    {
+        image_index = current_frame % static_cast<uint32_t>(swap_chain_images.size());
+    }
+    else
+    {
+        VkResult acquire_result = VK_SUCCESS;
+        {
+            ScopedTimer timer("acquire", TraceCategory::PresentWait);
+            acquire_result = vkAcquireNextImageKHR(device, swap_chain, UINT64_MAX, image_available_semaphores[current_frame], VK_NULL_HANDLE, &image_index);
+        }
+        if(acquire_result == VK_ERROR_OUT_OF_DATE_KHR)
+        {
+            // The fence hasn't been reset yet, so it is safe to bail out and try again next frame
+            framebuffer_resized = true;
+            return true;
+        }
+        else if(acquire_result != VK_SUCCESS && acquire_result != VK_SUBOPTIMAL_KHR)
+        {
+            std::cout << "Failed to acquire swap chain image!" << std::endl;
+            return false;
+        }
+    }
+
+    // The swap chain may hand back an image an older frame slot is still rendering to
+    if(images_in_flight[image_index] != VK_NULL_HANDLE)
+    {
+        ScopedTimer timer("image_fence_wait", TraceCategory::GpuWait);
+        vkWaitForFences(device, 1, &images_in_flight[image_index], VK_TRUE, UINT64_MAX);
+    }
+    images_in_flight[image_index] = in_flight_fences[current_frame];
+    vkResetFences(device, 1, &in_flight_fences[current_frame]);
+
+    // Record command buffer
+    VkCommandBuffer command_buffer = command_buffers[current_frame];
+    frame_wait_semaphores.clear();
+    frame_wait_stages.clear();
+    frame_wait_values.clear();
+    if(!headless)
+    {
+        frame_wait_semaphores.push_back(image_available_semaphores[current_frame]);
+        frame_wait_stages.push_back(VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT);
+        frame_wait_values.push_back(0);
+    }
+    if(async_compute && !submitAsyncCompute())
+    {
+        return false;
+    }
+    if(!writeFrameUniforms())
+    {
+        return false;
+    }
+    {
+        ScopedTimer timer("record");
+        auto record_start = std::chrono::steady_clock::now();
+        vkResetCommandBuffer(command_buffer, 0);
+        if(!recordCommandBuffer(command_buffer, image_index))
+        {
+            return false;
+        }
+        draw_stats.record_seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - record_start).count();
+    }
+
+    // Submit command buffer
+    VkSubmitInfo submit_infos[2] = {};
+    submit_infos[0].sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submit_infos[0].waitSemaphoreCount = static_cast<uint32_t>(frame_wait_semaphores.size());
+    submit_infos[0].pWaitSemaphores = frame_wait_semaphores.data();
+    submit_infos[0].pWaitDstStageMask = frame_wait_stages.data();
+    submit_infos[0].commandBufferCount = 1;
+    submit_infos[0].pCommandBuffers = &command_buffer;
+    submit_infos[0].signalSemaphoreCount = headless ? 0 : 1;
+    submit_infos[0].pSignalSemaphores = &render_finished_semaphores[current_frame];
+    VkTimelineSemaphoreSubmitInfo timeline_info = {};
+    if(capabilities.timeline_semaphore)
+    {
+        timeline_info.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+        timeline_info.waitSemaphoreValueCount = static_cast<uint32_t>(frame_wait_values.size());
+        timeline_info.pWaitSemaphoreValues = frame_wait_values.data();
+        submit_infos[0].pNext = &timeline_info;
+    }
+    uint32_t submit_count = 1;
+    uint64_t pyramid_value = submitted_frames + 1;
+    if(async_compute)
+    {
+        //The first batch ends with the depth pyramid and signals the next frame's cull right away instead
+        //of once the frame is done. The passes after it go in a batch of their own, which the present and
+        //the fence wait for.
+        submit_infos[0].signalSemaphoreCount = 1;
+        submit_infos[0].pSignalSemaphores = &graphics_timeline;
+        timeline_info.signalSemaphoreValueCount = 1;
+        timeline_info.pSignalSemaphoreValues = &pyramid_value;
+
+        submit_infos[1].sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        submit_infos[1].commandBufferCount = 1;
+        submit_infos[1].pCommandBuffers = &late_command_buffers[current_frame];
+        submit_infos[1].signalSemaphoreCount = headless ? 0 : 1;
+        submit_infos[1].pSignalSemaphores = &render_finished_semaphores[current_frame];
+        submit_count = 2;
+    }
+
+    VkResult submit_result = VK_SUCCESS;
+    {
+        ScopedTimer timer("submit");
+        submit_result = vkQueueSubmit(graphics_queue, submit_count, submit_infos, in_flight_fences[current_frame]);
+    }
+    if(submit_result != VK_SUCCESS)
+    {
+        std::cout << "Failed to submit draw command buffer!" << std::endl;
+        return false;
+    }
+    submitted_frames++;
+    frame_submit_indices[current_frame] = submitted_frames;
+    draw_stats.frames++;
+
+    // Presentation
+    if(headless)
+    {
+        current_frame = (current_frame + 1) % max_frames_in_flight;
+        return true;
+    }
+
+    VkPresentInfoKHR present_info = {};
+    present_info.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
+    present_info.waitSemaphoreCount = 1;
+    present_info.pWaitSemaphores = &render_finished_semaphores[current_frame];
+    VkSwapchainKHR swap_chains[] = {swap_chain};
+    present_info.swapchainCount = 1;
+    present_info.pSwapchains = swap_chains;
+    present_info.pImageIndices = &image_index;
+    present_info.pResults = nullptr;
+
+    VkPresentIdKHR present_id_info = {};
+    if(present_wait)
+    {
+        present_id++;
+        present_id_info.sType = VK_STRUCTURE_TYPE_PRESENT_ID_KHR;
+        present_id_info.swapchainCount = 1;
+        present_id_info.pPresentIds = &present_id;
+        present_info.pNext = &present_id_info;
+    }
+
+    VkResult present_result = VK_SUCCESS;
+    {
+        ScopedTimer timer("present", TraceCategory::PresentWait);
+        present_result = vkQueuePresentKHR(present_queue, &present_info);
+    }
+    if(present_result == VK_ERROR_OUT_OF_DATE_KHR || present_result == VK_SUBOPTIMAL_KHR)
+    {
+        framebuffer_resized = true;
+    }
+    else if(present_result != VK_SUCCESS)
+    {
+        std::cout << "Failed to present swap chain image!" << std::endl;
+        return false;
+    }
+
+    current_frame = (current_frame + 1) % max_frames_in_flight;
+
+    return true;
+}
+
+bool Renderer::recordCommandBuffer(VkCommandBuffer command_buffer, uint32_t image_index)
+{
+    VkCommandBufferBeginInfo begin_info = {};
+    begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+
+    if(vkBeginCommandBuffer(command_buffer, &begin_info) != VK_SUCCESS)
+    {
+        std::cout << "failed to begin recording command buffer!" << std::endl;
+        return false;
+    }
+
+    //This slot's fence was waited on before recording, so last time's timestamps are ready
+    gpu_profiler.beginFrame(command_buffer, current_frame);
+    uint32_t frame_scope = gpu_profiler.beginScope(command_buffer, "frame");
+
+    //Take over buffers written by the transfer queue since the last frame
+    if(!upload_manager.recordAcquireBarriers(command_buffer, submitted_frames + 1, frame_wait_semaphores, frame_wait_stages,
+        frame_wait_values))
+    {
+        return false;
+    }
+
+    //The swap chain image's old contents are discarded, only the acquire semaphore wait has to be chained to
+    RenderGraph::ResourceState color_state = {};
+    color_state.write_stages = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    render_graph.setImage(graph_resources.color, swap_chain_images[image_index], color_state);
+    render_graph.setBuffer(graph_resources.instances, instance_buffer);
+    render_graph.setBuffer(graph_resources.draws, gpu_cull ? culling.draw_buffers[current_frame] : indirect_buffer);
+    if(gpu_cull)
+    {
+        render_graph.setBuffer(graph_resources.draw_count, culling.count_buffers[current_frame]);
+    }
+    frame_image_index = image_index;
+    if(!async_compute)
+    {
+        if(!render_graph.execute(command_buffer))
+        {
+            return false;
+        }
+    }
+    else
+    {
+        //Split behind the depth pyramid, drawFrame submits the two halves as separate batches
+        if(!render_graph.execute(command_buffer, 0, late_graph_pass))
+        {
+            return false;
+        }
+        if(vkEndCommandBuffer(command_buffer) != VK_SUCCESS)
+        {
+            std::cout << "Failed to record command buffer!" << std::endl;
+            return false;
+        }
+        command_buffer = late_command_buffers[current_frame];
+        vkResetCommandBuffer(command_buffer, 0);
+        if(vkBeginCommandBuffer(command_buffer, &begin_info) != VK_SUCCESS)
+        {
+            std::cout << "failed to begin recording command buffer!" << std::endl;
+            return false;
+        }
+        if(!render_graph.execute(command_buffer, late_graph_pass))
+        {
+            return false;
+        }
+    }
+    gpu_profiler.endScope(command_buffer, frame_scope);
+
+    if(vkEndCommandBuffer(command_buffer) != VK_SUCCESS)
+    {
+        std::cout << "Failed to record command buffer!" << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+void Renderer::beginRendering(VkCommandBuffer command_buffer, bool secondary)
+{
+    VkClearValue clear_values[2] = {};
+    clear_values[0].color = {{0.0f, 0.0f, 1.0f, 1.0f}};
+    clear_values[1].depthStencil = {1.0f, 0};
+
+    if(dynamic_rendering)
+    {
+        //Same load and store ops the render pass would use
+        VkRenderingAttachmentInfoKHR color_attachment = {};
+        color_attachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR;
+        color_attachment.imageView = swap_chain_image_views[frame_image_index];
+        color_attachment.imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+        color_attachment.resolveMode = VK_RESOLVE_MODE_NONE;
+        color_attachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+        color_attachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+        color_attachment.clearValue = clear_values[0];
+
+        VkRenderingAttachmentInfoKHR depth_attachment = {};
+        depth_attachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR;
+        depth_attachment.imageView = render_graph.imageView(graph_resources.depth);
+        depth_attachment.imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+        depth_attachment.resolveMode = VK_RESOLVE_MODE_NONE;
+        depth_attachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+        depth_attachment.storeOp = gpu_cull ? VK_ATTACHMENT_STORE_OP_STORE : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        depth_attachment.clearValue = clear_values[1];
+
+        VkRenderingInfoKHR rendering_info = {};
+        rendering_info.sType = VK_STRUCTURE_TYPE_RENDERING_INFO_KHR;
+        rendering_info.flags = secondary ? VK_RENDERING_CONTENTS_SECONDARY_COMMAND_BUFFERS_BIT_KHR : 0;
+        rendering_info.renderArea.offset = {0, 0};
+        rendering_info.renderArea.extent = swap_chain_extent;
+        rendering_info.layerCount = 1;
+        rendering_info.colorAttachmentCount = 1;
+        rendering_info.pColorAttachments = &color_attachment;
+        rendering_info.pDepthAttachment = &depth_attachment;
+        cmd_begin_rendering(command_buffer, &rendering_info);
+        return;
+    }
+
+    VkRenderPassBeginInfo render_pass_info = {};
+    render_pass_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+    render_pass_info.renderPass = render_pass;
+    render_pass_info.framebuffer = swap_chain_frame_buffers[frame_image_index];
+    render_pass_info.renderArea.offset = {0, 0};
+    render_pass_info.renderArea.extent = swap_chain_extent;
+    render_pass_info.clearValueCount = 2;
+    render_pass_info.pClearValues = clear_values;
+    vkCmdBeginRenderPass(command_buffer, &render_pass_info,
+        secondary ? VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS : VK_SUBPASS_CONTENTS_INLINE);
+}
+
+void Renderer::endRendering(VkCommandBuffer command_buffer)
+{
+    if(dynamic_rendering)
+    {
+        cmd_end_rendering(command_buffer);
+    }
+    else
+    {
+        vkCmdEndRenderPass(command_buffer);
+    }
+}
+
+bool Renderer::recordObjectsPass(VkCommandBuffer command_buffer)
+{
+    uint32_t render_pass_scope = gpu_profiler.beginScope(command_buffer, "render_pass");
+    if(record_threads == 0)
+    {
+        beginRendering(command_buffer, false);
+        uint32_t draw_scope = gpu_profiler.beginScope(command_buffer, "objects");
+        draw_stats.draw_calls += recordDraws(command_buffer, 0, drawListSize());
+        gpu_profiler.endScope(command_buffer, draw_scope);
+    }
+    else
+    {
+        //Every worker records a contiguous slice of the draw list into its own secondary buffer
+        beginRendering(command_buffer, true);
+
+        //Dynamic rendering has no render pass to inherit, the secondaries get the attachment formats instead
+        VkCommandBufferInheritanceRenderingInfoKHR inheritance_rendering_info = {};
+        inheritance_rendering_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_RENDERING_INFO_KHR;
+        inheritance_rendering_info.colorAttachmentCount = 1;
+        inheritance_rendering_info.pColorAttachmentFormats = &swap_chain_image_format;
+        inheritance_rendering_info.depthAttachmentFormat = depth_format;
+        inheritance_rendering_info.stencilAttachmentFormat = VK_FORMAT_UNDEFINED;
+        inheritance_rendering_info.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+        VkCommandBufferInheritanceInfo inheritance_info = {};
+        inheritance_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+        if(dynamic_rendering)
+        {
+            inheritance_info.pNext = &inheritance_rendering_info;
+        }
+        else
+        {
+            inheritance_info.renderPass = render_pass;
+            inheritance_info.subpass = 0;
+            inheritance_info.framebuffer = swap_chain_frame_buffers[frame_image_index];
+        }
+
+        uint32_t list_size = drawListSize();
+        uint32_t thread_count = parallel_recorder.threadCount();
+        std::vector<uint32_t> worker_draw_calls(thread_count, 0);
+        auto record_slice = [this, list_size, thread_count, &worker_draw_calls](uint32_t worker, VkCommandBuffer secondary)
+        {
+            uint32_t first = static_cast<uint32_t>(static_cast<uint64_t>(list_size) * worker / thread_count);
+            uint32_t last = static_cast<uint32_t>(static_cast<uint64_t>(list_size) * (worker + 1) / thread_count);
+            worker_draw_calls[worker] = recordDraws(secondary, first, last - first);
+            return true;
+        };
+        if(!parallel_recorder.record(current_frame, inheritance_info, record_slice, &secondary_command_buffers))
+        {
+            return false;
+        }
+        vkCmdExecuteCommands(command_buffer, static_cast<uint32_t>(secondary_command_buffers.size()), secondary_command_buffers.data());
+        for(uint32_t draw_calls : worker_draw_calls)
+        {
+            draw_stats.draw_calls += draw_calls;
+        }
+    }
+    draw_stats.objects += object_count;
+
+    endRendering(command_buffer);
+    gpu_profiler.endScope(command_buffer, render_pass_scope);
+    return true;
+}
+
+uint32_t Renderer::drawListSize() const
+{
+    if(gpu_cull)
+    {
+        //The compacted list is a single count draw, otherwise there is one command per object
+        return culling.compact ? 1 : object_count;
+    }
+    return draw_path == DrawPath::PerObject ? object_count : indirect_draw_count;
+}
+
+uint32_t Renderer::recordDraws(VkCommandBuffer command_buffer, uint32_t first_draw, uint32_t draw_count)
+{
+    if(draw_count == 0)
+    {
+        return 0;
+    }
+
+    //Secondary command buffers don't inherit dynamic state, every recording sets it
+    VkViewport viewport = {};
+    viewport.x = 0.0f;
+    viewport.y = 0.0f;
+    viewport.width = static_cast<float>(swap_chain_extent.width);
+    viewport.height = static_cast<float>(swap_chain_extent.height);
+    viewport.minDepth = 0.0f;
+    viewport.maxDepth = 1.0f;
+    vkCmdSetViewport(command_buffer, 0, 1, &viewport);
+
+    VkRect2D scissor = {};
+    scissor.offset = {0, 0};
+    scissor.extent = swap_chain_extent;
+    vkCmdSetScissor(command_buffer, 0, 1, &scissor);
+
+    VkBuffer vertex_buffers[] = {vertex_buffer, instance_buffer};
+    VkDeviceSize offsets[] = {0, 0};
+    vkCmdBindVertexBuffers(command_buffer, 0, 2, vertex_buffers, offsets);
+    vkCmdBindIndexBuffer(command_buffer, index_buffer, 0, VK_INDEX_TYPE_UINT16);
+    //Every variant has the same layout, so this stays bound across pipeline switches. So does the heap.
+    if(bindless)
+    {
+        VkDescriptorSet sets[] = {frame_descriptor_set, bindless_heap.set};
+        vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphics_layout.pipeline_layout, 0, 2,
+            sets, 1, &frame_uniform_offset);
+    }
+    else
+    {
+        vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphics_layout.pipeline_layout, 0, 1,
+            &frame_descriptor_set, 1, &frame_uniform_offset);
+    }
+
+    //Every variant draws a contiguous group of the draw list
+    uint64_t list_size = drawListSize();
+    uint32_t variant_count = static_cast<uint32_t>(pipeline_variants.size());
+    uint32_t last_draw = first_draw + draw_count;
+    uint32_t draw_calls = 0;
+    VkPipeline bound_pipeline = VK_NULL_HANDLE;
+    for(uint32_t variant = 0; variant < variant_count; variant++)
+    {
+        uint32_t group_first = std::max(first_draw, static_cast<uint32_t>(list_size * variant / variant_count));
+        uint32_t group_last = std::min(last_draw, static_cast<uint32_t>(list_size * (variant + 1) / variant_count));
+        if(group_first >= group_last)
+        {
+            continue;
+        }
+        //Variants that are still compiling draw with the fallback
+        VkPipeline pipeline = pso_cache.get(pipeline_variants[variant], pipeline_variant_hashes[variant]);
+        if(pipeline == VK_NULL_HANDLE)
+        {
+            pipeline = graphics_pipeline;
+        }
+        if(pipeline != bound_pipeline)
+        {
+            vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+            bound_pipeline = pipeline;
+        }
+        uint32_t palette = variant % palette_count;
+        DrawData draw_data = {};
+        draw_data.phase = 0.7f * variant;
+        if(bindless)
+        {
+            draw_data.palette = palette_slots[palette];
+        }
+        else
+        {
+            draw_data.palette = palette;
+            vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphics_layout.pipeline_layout, 1, 1,
+                &palette_descriptor_sets[palette], 0, nullptr);
+        }
+        vkCmdPushConstants(command_buffer, graphics_layout.pipeline_layout, graphics_layout.push_constants.stageFlags, 0,
+            sizeof(draw_data), &draw_data);
+        draw_calls += recordDrawRange(command_buffer, group_first, group_last - group_first);
+    }
+
+    return draw_calls;
+}
+
+uint32_t Renderer::recordDrawRange(VkCommandBuffer command_buffer, uint32_t first_draw, uint32_t draw_count)
+{
+    //Draw a lot of triangles!
+    uint32_t index_count = static_cast<uint32_t>(vertex_indices.size());
+    uint32_t stride = sizeof(VkDrawIndexedIndirectCommand);
+    uint32_t last_draw = first_draw + draw_count;
+    uint32_t draw_calls = 0;
+    VkBuffer draw_buffer = gpu_cull ? culling.draw_buffers[current_frame] : indirect_buffer;
+    if(gpu_cull && culling.compact)
+    {
+        cmd_draw_indexed_indirect_count(command_buffer, draw_buffer, 0, culling.count_buffers[current_frame], 0, object_count, stride);
+        draw_calls = 1;
+    }
+    else if(draw_path == DrawPath::PerObject && !gpu_cull)
+    {
+        for(uint32_t i = first_draw; i < last_draw; i++)
+        {
+            vkCmdDrawIndexed(command_buffer, index_count, 1, 0, 0, i);
+        }
+        draw_calls = draw_count;
+    }
+    else if(draw_path == DrawPath::MultiIndirect)
+    {
+        //maxDrawIndirectCount may be lower than the number of batches
+        for(uint32_t first = first_draw; first < last_draw; first += capabilities.max_draw_indirect_count)
+        {
+            uint32_t count = std::min(capabilities.max_draw_indirect_count, last_draw - first);
+            vkCmdDrawIndexedIndirect(command_buffer, draw_buffer, first * stride, count, stride);
+            draw_calls++;
+        }
+    }
+    else
+    {
+        for(uint32_t i = first_draw; i < last_draw; i++)
+        {
+            if(!capabilities.draw_indirect_first_instance)
+            {
+                //firstInstance has to be 0 in the command, offset the instance buffer instead
+                VkDeviceSize instance_offset = draw_first_instances[i] * sizeof(InstanceData);
+                vkCmdBindVertexBuffers(command_buffer, 1, 1, &instance_buffer, &instance_offset);
+            }
+            vkCmdDrawIndexedIndirect(command_buffer, draw_buffer, i * stride, 1, stride);
+        }
+        draw_calls = draw_count;
+    }
+
+    return draw_calls;
+}
+
+bool Renderer::createCommandBuffers()
+{
+    command_buffers.resize(max_frames_in_flight);
+
+    VkCommandBufferAllocateInfo alloc_info = {};
+    alloc_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    alloc_info.commandPool = command_pool;
+    alloc_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    alloc_info.commandBufferCount = static_cast<uint32_t>(command_buffers.size());
+
+    if(vkAllocateCommandBuffers(device, &alloc_info, command_buffers.data()) != VK_SUCCESS)
+    {
+        std::cout << "Failed to allocate command buffers!" << std::endl;
+        return false;
+    }
+
+    if(async_compute)
+    {
+        late_command_buffers.resize(max_frames_in_flight);
+        if(vkAllocateCommandBuffers(device, &alloc_info, late_command_buffers.data()) != VK_SUCCESS)
+        {
+            std::cout << "Failed to allocate command buffers!" << std::endl;
+            return false;
+        }
+        compute_command_buffers.resize(max_frames_in_flight);
+        alloc_info.commandPool = compute_command_pool;
+        if(vkAllocateCommandBuffers(device, &alloc_info, compute_command_buffers.data()) != VK_SUCCESS)
+        {
+            std::cout << "Failed to allocate compute command buffers!" << std::endl;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool Renderer::createGeometryBuffers()
+{
+    VkDeviceSize vertex_size = sizeof(vertices[0]) * vertices.size();
+    VkDeviceSize index_size = sizeof(vertex_indices[0]) * vertex_indices.size();
+
+    //Exclusive to one family at a time, the upload manager hands ownership over to graphics
+    VkBufferCreateInfo buffer_info = {};
+    buffer_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    buffer_info.size = vertex_size;
+    buffer_info.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
+    buffer_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    if(!allocator.createBuffer(buffer_info, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 0, &vertex_buffer, &vertex_buffer_allocation))
+    {
+        std::cout << "Failed to create vertex buffer!" << std::endl;
+        return false;
+    }
+
+    buffer_info.size = index_size;
+    buffer_info.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT;
+    if(!allocator.createBuffer(buffer_info, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 0, &index_buffer, &index_buffer_allocation))
+    {
+        std::cout << "Failed to create index buffer!" << std::endl;
+        return false;
+    }
+
+    if(!upload_manager.uploadBuffer(vertex_buffer, 0, vertices.data(), vertex_size,
+            VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT, false)
+        || !upload_manager.uploadBuffer(index_buffer, 0, vertex_indices.data(), index_size,
+            VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_INDEX_READ_BIT, false))
+    {
+        std::cout << "Failed to upload geometry!" << std::endl;
+        return false;
+    }
+
+    return upload_manager.flush();
+}
+
+bool Renderer::drawPathSupported(DrawPath path) const
+{
+    //Without drawIndirectFirstInstance every batch in a multi draw would read the same instances
+    if(path == DrawPath::MultiIndirect)
+    {
+        return capabilities.multi_draw_indirect && capabilities.draw_indirect_first_instance;
+    }
+    return true;
+}
+
+bool Renderer::createObjectBuffers()
+{
+    object_count = std::max(object_count, 1u);
+    instances_per_draw = std::max(instances_per_draw, 1u);
+    if(!drawPathSupported(draw_path))
+    {
+        std::cout << "multiDrawIndirect is not supported, falling back to one indirect draw per batch" << std::endl;
+        draw_path = DrawPath::Indirect;
+    }
+    if(gpu_cull && draw_path == DrawPath::PerObject)
+    {
+        //Culled draws only exist on the GPU
+        draw_path = DrawPath::Indirect;
+    }
+
+    //Lay the objects out on a square grid in clip space, each at its own depth
+    uint32_t columns = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<double>(object_count))));
+    float cell_size = 2.0f * scene_extent / columns;
+    std::vector<InstanceData> instances(object_count);
+    uint32_t depth_seed = 1;
+    for(uint32_t i = 0; i < object_count; i++)
+    {
+        depth_seed = depth_seed * 1664525u + 1013904223u;
+        instances[i].offset[0] = -scene_extent + cell_size * ((i % columns) + 0.5f);
+        instances[i].offset[1] = -scene_extent + cell_size * ((i / columns) + 0.5f);
+        instances[i].offset[2] = 0.1f + 0.8f * static_cast<float>(depth_seed >> 8) / static_cast<float>(1u << 24);
+        instances[i].scale = cell_size * 0.5f;
+    }
+
+    indirect_draw_count = (object_count + instances_per_draw - 1) / instances_per_draw;
+    std::vector<VkDrawIndexedIndirectCommand> draw_commands(indirect_draw_count);
+    draw_first_instances.resize(indirect_draw_count);
+    for(uint32_t i = 0; i < indirect_draw_count; i++)
+    {
+        uint32_t first_instance = i * instances_per_draw;
+        draw_commands[i].indexCount = static_cast<uint32_t>(vertex_indices.size());
+        draw_commands[i].instanceCount = std::min(instances_per_draw, object_count - first_instance);
+        draw_commands[i].firstIndex = 0;
+        draw_commands[i].vertexOffset = 0;
+        draw_commands[i].firstInstance = capabilities.draw_indirect_first_instance ? first_instance : 0;
+        draw_first_instances[i] = first_instance;
+    }
+
+    //Frames already submitted may still draw from the old buffers. Pending copies into them are only
+    //acquired by the next frame, so that is the last frame that can touch them.
+    if(instance_buffer != VK_NULL_HANDLE)
+    {
+        DeviceAllocator* allocator_ptr = &allocator;
+        VkBuffer old_instance_buffer = instance_buffer;
+        MemoryAllocation old_instance_allocation = instance_buffer_allocation;
+        VkBuffer old_indirect_buffer = indirect_buffer;
+        MemoryAllocation old_indirect_allocation = indirect_buffer_allocation;
+        DeferredDeletion deletion = {};
+        deletion.last_use = submitted_frames + 1;
+        deletion.destroy = [allocator_ptr, old_instance_buffer, old_instance_allocation, old_indirect_buffer, old_indirect_allocation]() mutable
+        {
+            allocator_ptr->destroyBuffer(old_instance_buffer, old_instance_allocation);
+            allocator_ptr->destroyBuffer(old_indirect_buffer, old_indirect_allocation);
+        };
+        deletion_queue.push_back(std::move(deletion));
+        instance_buffer = VK_NULL_HANDLE;
+        indirect_buffer = VK_NULL_HANDLE;
+    }
+
+    VkDeviceSize instance_size = sizeof(InstanceData) * instances.size();
+    VkDeviceSize indirect_size = sizeof(VkDrawIndexedIndirectCommand) * draw_commands.size();
+
+    VkBufferCreateInfo buffer_info = {};
+    buffer_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    buffer_info.size = instance_size;
+    buffer_info.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+    buffer_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    //The async cull reads the instances on another family, share them rather than juggle ownership
+    std::set<uint32_t> unique_sharing_families = {indices.graphics_family, indices.compute_family, indices.transfer_family};
+    std::vector<uint32_t> sharing_families(unique_sharing_families.begin(), unique_sharing_families.end());
+    if(async_compute)
+    {
+        buffer_info.sharingMode = VK_SHARING_MODE_CONCURRENT;
+        buffer_info.queueFamilyIndexCount = static_cast<uint32_t>(sharing_families.size());
+        buffer_info.pQueueFamilyIndices = sharing_families.data();
+    }
+    if(!allocator.createBuffer(buffer_info, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 0, &instance_buffer, &instance_buffer_allocation))
+    {
+        std::cout << "Failed to create instance buffer!" << std::endl;
+        return false;
+    }
+
+    buffer_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    buffer_info.queueFamilyIndexCount = 0;
+    buffer_info.pQueueFamilyIndices = nullptr;
+    buffer_info.size = indirect_size;
+    buffer_info.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT;
+    if(!allocator.createBuffer(buffer_info, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 0, &indirect_buffer, &indirect_buffer_allocation))
+    {
+        std::cout << "Failed to create indirect draw buffer!" << std::endl;
+        return false;
+    }
+
+    VkPipelineStageFlags instance_stages = VK_PIPELINE_STAGE_VERTEX_INPUT_BIT;
+    VkAccessFlags instance_access = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT;
+    if(gpu_cull && !async_compute)
+    {
+        instance_stages |= VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+        instance_access |= VK_ACCESS_SHADER_READ_BIT;
+    }
+    if(!upload_manager.uploadBuffer(instance_buffer, 0, instances.data(), instance_size, instance_stages, instance_access, async_compute)
+        || !upload_manager.uploadBuffer(indirect_buffer, 0, draw_commands.data(), indirect_size,
+            VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT, false))
+    {
+        std::cout << "Failed to upload object data!" << std::endl;
+        return false;
+    }
+
+    if(gpu_cull && !culling.setObjects(instance_buffer, object_count, static_cast<uint32_t>(vertex_indices.size()), mesh_half_extent))
+    {
+        return false;
+    }
+
+    return upload_manager.flush();
+}
+
+bool Renderer::createFrameUniforms()
+{
+    //Room for storage data too, anything per frame can be bump allocated next to FrameData
+    if(!frame_uniforms.init(allocator, device, uniform_ring_size, max_frames_in_flight,
+        VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, capabilities.min_buffer_offset_alignment))
+    {
+        std::cout << "Failed to create uniform ring!" << std::endl;
+        return false;
+    }
+
+    VkDescriptorPoolSize pool_size = {};
+    pool_size.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+    pool_size.descriptorCount = 1;
+
+    VkDescriptorPoolCreateInfo pool_info = {};
+    pool_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    pool_info.maxSets = 1;
+    pool_info.poolSizeCount = 1;
+    pool_info.pPoolSizes = &pool_size;
+    if(vkCreateDescriptorPool(device, &pool_info, nullptr, &frame_descriptor_pool) != VK_SUCCESS)
+    {
+        std::cout << "Failed to create frame descriptor pool!" << std::endl;
+        return false;
+    }
+
+    //The layout comes from the reflected shaders, hot reloaded ones have to keep it
+    frame_descriptor_set_layout = graphics_layout.set_layouts[0];
+    VkDescriptorSetAllocateInfo alloc_info = {};
+    alloc_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    alloc_info.descriptorPool = frame_descriptor_pool;
+    alloc_info.descriptorSetCount = 1;
+    alloc_info.pSetLayouts = &frame_descriptor_set_layout;
+    if(vkAllocateDescriptorSets(device, &alloc_info, &frame_descriptor_set) != VK_SUCCESS)
+    {
+        std::cout << "Failed to allocate frame descriptor set!" << std::endl;
+        return false;
+    }
+
+    //Written once, the dynamic offset picks the frame's data
+    VkDescriptorBufferInfo buffer_info = {};
+    buffer_info.buffer = frame_uniforms.buffer;
+    buffer_info.offset = 0;
+    buffer_info.range = sizeof(FrameData);
+
+    VkWriteDescriptorSet write = {};
+    write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    write.dstSet = frame_descriptor_set;
+    write.dstBinding = 0;
+    write.descriptorCount = 1;
+    write.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+    write.pBufferInfo = &buffer_info;
+    vkUpdateDescriptorSets(device, 1, &write, 0, nullptr);
+    return true;
+}
+
+bool Renderer::createPalettes()
+{
+    //Each palette starts on an offset any descriptor can point at
+    VkDeviceSize palette_size = sizeof(palettes[0]);
+    VkDeviceSize alignment = capabilities.min_buffer_offset_alignment;
+    palette_stride = (palette_size + alignment - 1) / alignment * alignment;
+    std::vector<char> palette_data(palette_stride * palette_count, 0);
+    for(uint32_t palette = 0; palette < palette_count; palette++)
+    {
+        memcpy(palette_data.data() + palette_stride * palette, palettes[palette], palette_size);
+    }
+
+    VkBufferCreateInfo buffer_info = {};
+    buffer_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    buffer_info.size = palette_data.size();
+    buffer_info.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+    buffer_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    if(!allocator.createBuffer(buffer_info, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 0, &palette_buffer, &palette_buffer_allocation))
+    {
+        std::cout << "Failed to create palette buffer!" << std::endl;
+        return false;
+    }
+    if(!upload_manager.uploadBuffer(palette_buffer, 0, palette_data.data(), palette_data.size(),
+        VK_PIPELINE_STAGE_VERTEX_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, false))
+    {
+        std::cout << "Failed to upload palettes!" << std::endl;
+        return false;
+    }
+
+    if(bindless)
+    {
+        for(uint32_t palette = 0; palette < palette_count; palette++)
+        {
+            uint32_t slot = bindless_heap.addBuffer(palette_buffer, palette_stride * palette, palette_size);
+            if(slot == BindlessHeap::invalid_slot)
+            {
+                return false;
+            }
+            palette_slots.push_back(slot);
+        }
+        return upload_manager.flush();
+    }
+
+    VkDescriptorPoolSize pool_size = {};
+    pool_size.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    pool_size.descriptorCount = palette_count;
+
+    VkDescriptorPoolCreateInfo pool_info = {};
+    pool_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    pool_info.maxSets = palette_count;
+    pool_info.poolSizeCount = 1;
+    pool_info.pPoolSizes = &pool_size;
+    if(vkCreateDescriptorPool(device, &pool_info, nullptr, &palette_descriptor_pool) != VK_SUCCESS)
+    {
+        std::cout << "Failed to create palette descriptor pool!" << std::endl;
+        return false;
+    }
+
+    std::vector<VkDescriptorSetLayout> set_layouts(palette_count, graphics_layout.set_layouts[1]);
+    palette_descriptor_sets.resize(palette_count);
+    VkDescriptorSetAllocateInfo alloc_info = {};
+    alloc_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    alloc_info.descriptorPool = palette_descriptor_pool;
+    alloc_info.descriptorSetCount = palette_count;
+    alloc_info.pSetLayouts = set_layouts.data();
+    if(vkAllocateDescriptorSets(device, &alloc_info, palette_descriptor_sets.data()) != VK_SUCCESS)
+    {
+        std::cout << "Failed to allocate palette descriptor sets!" << std::endl;
+        return false;
+    }
+
+    std::vector<VkDescriptorBufferInfo> buffer_infos(palette_count);
+    std::vector<VkWriteDescriptorSet> writes(palette_count);
+    for(uint32_t palette = 0; palette < palette_count; palette++)
+    {
+        buffer_infos[palette].buffer = palette_buffer;
+        buffer_infos[palette].offset = palette_stride * palette;
+        buffer_infos[palette].range = palette_size;
+
+        writes[palette] = {};
+        writes[palette].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        writes[palette].dstSet = palette_descriptor_sets[palette];
+        writes[palette].dstBinding = 0;
+        writes[palette].descriptorCount = 1;
+        writes[palette].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        writes[palette].pBufferInfo = &buffer_infos[palette];
+    }
+    vkUpdateDescriptorSets(device, palette_count, writes.data(), 0, nullptr);
+    return upload_manager.flush();
+}
+
+bool Renderer::writeFrameUniforms()
+{
+    //The fence of this frame slot has been waited on, so its segment is free again
+    frame_uniforms.beginFrame(current_frame);
+    VkDeviceSize offset = 0;
+    FrameData* frame_data = static_cast<FrameData*>(frame_uniforms.allocate(sizeof(FrameData), &offset));
+    if(frame_data == nullptr)
+    {
+        std::cout << "Failed to allocate frame uniforms!" << std::endl;
+        return false;
+    }
+    frame_data->time = scene_time;
+    frame_data->pulse = frame_pulse;
+    frame_uniform_offset = static_cast<uint32_t>(offset);
+    return true;
+}
+
+bool Renderer::createCommandPool()
+{
+    VkCommandPoolCreateInfo pool_info = {};
+    pool_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    pool_info.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+    pool_info.queueFamilyIndex = indices.graphics_family;
+
+    if(vkCreateCommandPool(device, &pool_info, nullptr, &command_pool) != VK_SUCCESS)
+    {
+        std::cout << "Failed to create command pool!" << std::endl;
+        return false;
+    }
+
+    if(async_compute)
+    {
+        pool_info.queueFamilyIndex = indices.compute_family;
+        if(vkCreateCommandPool(device, &pool_info, nullptr, &compute_command_pool) != VK_SUCCESS)
+        {
+            std::cout << "Failed to create compute command pool!" << std::endl;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool Renderer::createFrameBuffers()
+{
+    //Dynamic rendering names the attachment views when recording
+    if(dynamic_rendering)
+    {
+        return true;
+    }
+
+    swap_chain_frame_buffers.resize(swap_chain_image_views.size());
+
+    for(size_t i = 0; i < swap_chain_image_views.size(); i++)
+    {
+        //The depth buffer is shared, frames are serialized on the graphics queue
+        VkImageView attachments[] = {swap_chain_image_views[i], render_graph.imageView(graph_resources.depth)};
+
+        VkFramebufferCreateInfo framebuffer_info = {};
+        framebuffer_info.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+        framebuffer_info.renderPass = render_pass;
+        framebuffer_info.attachmentCount = 2;
+        framebuffer_info.pAttachments = attachments;
+        framebuffer_info.width = swap_chain_extent.width;
+        framebuffer_info.height = swap_chain_extent.height;
+        framebuffer_info.layers = 1;
+
+        if(vkCreateFramebuffer(device, &framebuffer_info, nullptr, &swap_chain_frame_buffers[i]) != VK_SUCCESS)
+        {
+            std::cout << "Failed to create framebuffer!" << std::endl;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool Renderer::createRenderPass()
+{
+    if(dynamic_rendering)
+    {
+        return true;
+    }
+
+    VkAttachmentDescription color_attachment = {};
+    color_attachment.format = swap_chain_image_format;
+    color_attachment.samples = VK_SAMPLE_COUNT_1_BIT;
+    color_attachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    color_attachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+    color_attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    color_attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    //The render graph transitions the attachments around the pass
+    color_attachment.initialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    color_attachment.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+    //Depth is only kept past the pass when the depth pyramid is built from it
+    VkAttachmentDescription depth_attachment = {};
+    depth_attachment.format = depth_format;
+    depth_attachment.samples = VK_SAMPLE_COUNT_1_BIT;
+    depth_attachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    depth_attachment.storeOp = gpu_cull ? VK_ATTACHMENT_STORE_OP_STORE : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    depth_attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    depth_attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    depth_attachment.initialLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+    depth_attachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+    VkAttachmentReference color_attachment_ref = {};
+    color_attachment_ref.attachment = 0;
+    color_attachment_ref.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+    VkAttachmentReference depth_attachment_ref = {};
+    depth_attachment_ref.attachment = 1;
+    depth_attachment_ref.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+    VkSubpassDescription subpass = {};
+    subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+    subpass.colorAttachmentCount = 1;
+    subpass.pColorAttachments = &color_attachment_ref;
+    subpass.pDepthStencilAttachment = &depth_attachment_ref;
+
+    VkAttachmentDescription attachments[] = {color_attachment, depth_attachment};
+    VkRenderPassCreateInfo render_pass_info = {};
+    render_pass_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+    render_pass_info.attachmentCount = 2;
+    render_pass_info.pAttachments = attachments;
+    render_pass_info.subpassCount = 1;
+    render_pass_info.pSubpasses = &subpass;
+    //No subpass dependencies, the render graph puts barriers in front of the pass
+
+    if(vkCreateRenderPass(device, &render_pass_info, nullptr, &render_pass) != VK_SUCCESS)
+    {
+        std::cout << "Failed to create render pass!" << std::endl;
+        return false;
+    }
+
+    return true;
+
+}
+
+bool Renderer::createPipelineCache()
+{
+    std::vector<char> cache_data = {};
+    if(!pipeline_cache_path.empty())
+    {
+        std::ifstream file(pipeline_cache_path, std::ios::ate | std::ios::binary);
+        if(file.is_open())
+        {
+            cache_data.resize((size_t) file.tellg());
+            file.seekg(0);
+            file.read(cache_data.data(), cache_data.size());
+        }
+    }
+
+    //Only hand the driver data that was written by this exact device and driver build
+    if(!cache_data.empty())
+    {
+        VkPhysicalDeviceProperties device_properties = {};
+        vkGetPhysicalDeviceProperties(physical_device, &device_properties);
+
+        VkPipelineCacheHeaderVersionOne header = {};
+        bool valid = cache_data.size() >= sizeof(header);
+        if(valid)
+        {
+            memcpy(&header, cache_data.data(), sizeof(header));
+            valid = header.headerSize >= sizeof(header)
+                && header.headerSize <= cache_data.size()
+                && header.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE
+                && header.vendorID == device_properties.vendorID
+                && header.deviceID == device_properties.deviceID
+                && memcmp(header.pipelineCacheUUID, device_properties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+        }
+        if(!valid)
+        {
+            std::cout << "Ignoring stale or corrupt pipeline cache " << pipeline_cache_path << std::endl;
+            cache_data.clear();
+        }
+    }
+
+    VkPipelineCacheCreateInfo cache_info = {};
+    cache_info.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+    cache_info.initialDataSize = cache_data.size();
+    cache_info.pInitialData = cache_data.empty() ? nullptr : cache_data.data();
+
+    if(vkCreatePipelineCache(device, &cache_info, nullptr, &pipeline_cache) != VK_SUCCESS)
+    {
+        //The driver may still reject the data, retry with an empty cache before giving up
+        cache_info.initialDataSize = 0;
+        cache_info.pInitialData = nullptr;
+        cache_data.clear();
+        if(vkCreatePipelineCache(device, &cache_info, nullptr, &pipeline_cache) != VK_SUCCESS)
+        {
+            std::cout << "Failed to create pipeline cache!" << std::endl;
+            return false;
+        }
+    }
+
+    pipeline_cache_warm = !cache_data.empty();
+    return true;
+}
+
+bool Renderer::savePipelineCache()
+{
+    if(pipeline_cache == VK_NULL_HANDLE || pipeline_cache_path.empty())
+    {
+        return true;
+    }
+
+    size_t data_size = 0;
+    if(vkGetPipelineCacheData(device, pipeline_cache, &data_size, nullptr) != VK_SUCCESS || data_size == 0)
+    {
+        return false;
+    }
+    std::vector<char> cache_data(data_size);
+    if(vkGetPipelineCacheData(device, pipeline_cache, &data_size, cache_data.data()) != VK_SUCCESS)
+    {
+        std::cout << "Failed to read back pipeline cache data!" << std::endl;
+        return false;
+    }
+
+    //Write to a temporary file first so a crash mid-write can't leave a truncated cache behind
+    std::string temp_path = pipeline_cache_path + ".tmp";
+    {
+        std::ofstream file(temp_path, std::ios::binary | std::ios::trunc);
+        if(!file.is_open())
+        {
+            std::cout << "Failed to open file: " << temp_path << std::endl;
+            return false;
+        }
+        file.write(cache_data.data(), data_size);
+        if(!file.good())
+        {
+            std::cout << "Failed to write pipeline cache " << temp_path << std::endl;
+            return false;
+        }
+    }
+    if(std::rename(temp_path.c_str(), pipeline_cache_path.c_str()) != 0)
+    {
+        std::cout << "Failed to replace pipeline cache " << pipeline_cache_path << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+bool Renderer::createGraphicsPipeline()
+{
+    const char* vert_path = bindless ? "shaders/vert_bindless.spv" : "shaders/vert.spv";
+    if(!assets.load(vert_path, &vert_shader_code) || !assets.load("shaders/frag.spv", &frag_shader_code))
+    {
+        return false;
+    }
+
+    if(!buildPipelineVariants(&pipeline_variants, &pipeline_variant_hashes, &graphics_layout))
+    {
+        return false;
+    }
+
+    //The first variant is the fallback the others draw with while they compile, so it has to exist now
+    auto pipeline_start = std::chrono::steady_clock::now();
+    graphics_pipeline = pso_cache.getBlocking(pipeline_variants[0], pipeline_variant_hashes[0]);
+    if(graphics_pipeline == VK_NULL_HANDLE)
+    {
+        return false;
+    }
+    double pipeline_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - pipeline_start).count();
+    std::cout << "Graphics pipeline created in " << pipeline_ms << " ms ("
+        << (pipeline_cache_warm ? "warm" : "cold") << " pipeline cache)" << std::endl;
+
+    //Start compiling the rest in the background
+    for(uint32_t variant = 1; variant < pipeline_variant_count; variant++)
+    {
+        pso_cache.get(pipeline_variants[variant], pipeline_variant_hashes[variant]);
+    }
+
+    return true;
+}
+
+bool Renderer::buildPipelineVariants(std::vector<PipelineStateCache::PipelineState>* variants, std::vector<uint64_t>* hashes,
+    LayoutCache::Layout* layout)
+{
+    ShaderReflection vert_reflection = {};
+    ShaderReflection frag_reflection = {};
+    if(!ShaderReflection::reflect(vert_shader_code, &vert_reflection) || !ShaderReflection::reflect(frag_shader_code, &frag_reflection))
+    {
+        return false;
+    }
+    vert_reflection.makeDynamic(0, 0);
+    frag_reflection.makeDynamic(0, 0);
+    //Reflection can't tell the heap's array is update after bind, so set 1 takes the heap's own layout
+    std::vector<VkDescriptorSetLayout> external_set_layouts = {};
+    if(bindless)
+    {
+        external_set_layouts = {VK_NULL_HANDLE, bindless_heap.set_layout};
+    }
+    if(!layout_cache.getLayout({&vert_reflection, &frag_reflection}, layout, external_set_layouts))
+    {
+        return false;
+    }
+    //The frame's and palettes' descriptor sets are allocated once, so every shader version has to bind the same things
+    bool sets_match = layout->set_layouts.size() == 2
+        && (frame_descriptor_set_layout == VK_NULL_HANDLE || layout->set_layouts[0] == frame_descriptor_set_layout)
+        && (graphics_layout.pipeline_layout == VK_NULL_HANDLE || layout->set_layouts[1] == graphics_layout.set_layouts[1]);
+    if(!sets_match || layout->push_constants.offset != 0 || layout->push_constants.size < sizeof(DrawData))
+    {
+        std::cout << "Shaders have to declare FrameData at set 0 binding 0, palettes at set 1 and push DrawData!" << std::endl;
+        return false;
+    }
+
+    PipelineStateCache::PipelineState state = {};
+    std::vector<ShaderReflection::VertexStream> streams(2);
+    streams[0].binding = 0;
+    streams[0].input_rate = VK_VERTEX_INPUT_RATE_VERTEX;
+    streams[0].first_location = 0;
+    streams[1].binding = 1;
+    streams[1].input_rate = VK_VERTEX_INPUT_RATE_INSTANCE;
+    streams[1].first_location = instance_first_location;
+    if(!vert_reflection.buildVertexInput(streams, &state.bindings, &state.attributes))
+    {
+        return false;
+    }
+    if(state.bindings[0].stride != sizeof(Vertex) || state.bindings[1].stride != sizeof(InstanceData))
+    {
+        std::cout << "Vertex shader inputs don't match the Vertex and InstanceData layouts!" << std::endl;
+        return false;
+    }
+
+    PipelineStateCache::ShaderStage vert_stage = {};
+    vert_stage.stage = VK_SHADER_STAGE_VERTEX_BIT;
+    vert_stage.code = vert_shader_code;
+    vert_stage.code_hash = PipelineStateCache::hashCode(vert_shader_code.data, vert_shader_code.size);
+
+    PipelineStateCache::ShaderStage frag_stage = {};
+    frag_stage.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+    frag_stage.code = frag_shader_code;
+    frag_stage.code_hash = PipelineStateCache::hashCode(frag_shader_code.data, frag_shader_code.size);
+
+    state.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+    state.cull_mode = VK_CULL_MODE_BACK_BIT;
+    state.front_face = VK_FRONT_FACE_CLOCKWISE;
+    state.depth_test = true;
+    state.depth_write = true;
+    state.depth_compare = VK_COMPARE_OP_LESS;
+    state.render_pass = render_pass;
+    state.color_format = swap_chain_image_format;
+    state.depth_format = depth_format;
+    state.layout = layout->pipeline_layout;
+
+    //Variants only differ in the tint specialization constant of the fragment shader, which darkens
+    //each variant's group of draws a bit more than the last
+    variants->clear();
+    hashes->clear();
+    for(uint32_t variant = 0; variant < pipeline_variant_count; variant++)
+    {
+        float tint = 1.0f - 0.5f * variant / pipeline_variant_count;
+        uint32_t tint_bits = 0;
+        memcpy(&tint_bits, &tint, sizeof(tint_bits));
+        frag_stage.constants = {tint_bits};
+        state.stages = {vert_stage, frag_stage};
+        variants->push_back(state);
+        hashes->push_back(PipelineStateCache::hashState(state));
+    }
+    return true;
+}
+
+void Renderer::updateShaders()
+{
+    bool changed = false;
+    for(const auto& update : shader_manager.takeUpdates())
+    {
+        if(update.source == vert_shader_source)
+        {
+            vert_shader_code = update.code;
+        }
+        else if(update.source == "shader.frag")
+        {
+            frag_shader_code = update.code;
+        }
+        changed = true;
+    }
+
+    if(changed)
+    {
+        //Another edit before the last one was swapped in replaces it
+        std::vector<PipelineStateCache::PipelineState> variants = {};
+        std::vector<uint64_t> hashes = {};
+        LayoutCache::Layout layout = {};
+        if(!buildPipelineVariants(&variants, &hashes, &layout))
+        {
+            std::cout << "Reloaded shaders don't fit the renderer's vertex and descriptor layout, keeping the old ones" << std::endl;
+            return;
+        }
+        for(uint64_t hash : pending_pipeline_variant_hashes)
+        {
+            if(std::find(hashes.begin(), hashes.end(), hash) == hashes.end()
+                && std::find(pipeline_variant_hashes.begin(), pipeline_variant_hashes.end(), hash) == pipeline_variant_hashes.end())
+            {
+                retirePipeline(hash);
+            }
+        }
+        pending_pipeline_variants = std::move(variants);
+        pending_pipeline_variant_hashes = std::move(hashes);
+        pending_graphics_layout = layout;
+        //Compiled by the pipeline cache threads, the render thread keeps drawing with the old set
+        for(size_t i = 0; i < pending_pipeline_variants.size(); i++)
+        {
+            pso_cache.get(pending_pipeline_variants[i], pending_pipeline_variant_hashes[i]);
+        }
+    }
+
+    if(pending_pipeline_variants.empty())
+    {
+        return;
+    }
+
+    //Swap the whole set in once its fallback is ready, the other variants draw with it until they are
+    if(pso_cache.hasFailed(pending_pipeline_variant_hashes[0]))
+    {
+        std::cout << "Reloaded shaders don't make a valid pipeline, keeping the old ones" << std::endl;
+        for(uint64_t hash : pending_pipeline_variant_hashes)
+        {
+            retirePipeline(hash);
+        }
+        pending_pipeline_variants.clear();
+        pending_pipeline_variant_hashes.clear();
+        return;
+    }
+    VkPipeline fallback = pso_cache.get(pending_pipeline_variants[0], pending_pipeline_variant_hashes[0]);
+    if(fallback == VK_NULL_HANDLE)
+    {
+        return;
+    }
+
+    for(uint64_t hash : pipeline_variant_hashes)
+    {
+        if(std::find(pending_pipeline_variant_hashes.begin(), pending_pipeline_variant_hashes.end(), hash)
+            == pending_pipeline_variant_hashes.end())
+        {
+            retirePipeline(hash);
+        }
+    }
+    pipeline_variants = std::move(pending_pipeline_variants);
+    pipeline_variant_hashes = std::move(pending_pipeline_variant_hashes);
+    pending_pipeline_variants.clear();
+    pending_pipeline_variant_hashes.clear();
+    graphics_pipeline = fallback;
+    graphics_layout = pending_graphics_layout;
+    std::cout << "Shaders reloaded" << std::endl;
+}
+
+void Renderer::retirePipeline(uint64_t hash)
+{
+    VkPipeline pipeline = pso_cache.release(hash);
+    if(pipeline == VK_NULL_HANDLE)
+    {
+        return;
+    }
+    VkDevice device_handle = device;
+    deferDestroy([device_handle, pipeline]()
+    {
+        vkDestroyPipeline(device_handle, pipeline, nullptr);
+    });
+}
+
+bool Renderer::findDepthFormat()
+{
+    //Sampled support is needed for the depth pyramid, D16 is guaranteed to have it
+    const VkFormat candidates[] = {VK_FORMAT_D32_SFLOAT, VK_FORMAT_D32_SFLOAT_S8_UINT, VK_FORMAT_D24_UNORM_S8_UINT, VK_FORMAT_D16_UNORM};
+    VkFormatFeatureFlags required = VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT;
+    if(gpu_cull)
+    {
+        required |= VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT;
+    }
+    for(VkFormat format : candidates)
+    {
+        VkFormatProperties properties = {};
+        vkGetPhysicalDeviceFormatProperties(physical_device, format, &properties);
+        if((properties.optimalTilingFeatures & required) == required)
+        {
+            depth_format = format;
+            return true;
+        }
+    }
+
+    std::cout << "Failed to find a supported depth format!" << std::endl;
+    return false;
+}
+
+bool Renderer::buildRenderGraph()
+{
+    //Buffers and the swap chain image are pointed at every frame in recordCommandBuffer
+    render_graph.reset();
+    graph_resources.color = render_graph.importImage("swap_chain", VK_NULL_HANDLE, VK_IMAGE_ASPECT_COLOR_BIT);
+    graph_resources.instances = render_graph.importBuffer("instances", VK_NULL_HANDLE);
+    graph_resources.draws = render_graph.importBuffer("draws", VK_NULL_HANDLE);
+    graph_resources.draw_count = render_graph.importBuffer("draw_count", VK_NULL_HANDLE);
+
+    RenderGraph::ImageDesc depth_desc = {};
+    depth_desc.format = depth_format;
+    depth_desc.extent = swap_chain_extent;
+    depth_desc.aspect = VK_IMAGE_ASPECT_DEPTH_BIT;
+    if(depth_format == VK_FORMAT_D32_SFLOAT_S8_UINT || depth_format == VK_FORMAT_D24_UNORM_S8_UINT)
+    {
+        depth_desc.aspect |= VK_IMAGE_ASPECT_STENCIL_BIT;
+    }
+    graph_resources.depth = render_graph.createImage("depth", depth_desc);
+
+    //On the async compute queue the cull is ordered by timeline semaphores instead
+    if(gpu_cull && !async_compute)
+    {
+        uint32_t cull = render_graph.addPass("cull", [this](VkCommandBuffer command_buffer)
+        {
+            uint32_t cull_scope = gpu_profiler.beginScope(command_buffer, "cull");
+            culling.recordCull(command_buffer, current_frame);
+            gpu_profiler.endScope(command_buffer, cull_scope, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+            return true;
+        });
+        render_graph.use(cull, graph_resources.instances, RenderGraph::Access::ComputeStorageRead);
+        render_graph.use(cull, graph_resources.draws, RenderGraph::Access::ComputeStorageWrite);
+        //The count is cleared with a fill before the shader appends to it
+        render_graph.use(cull, graph_resources.draw_count, RenderGraph::Access::TransferWrite);
+        render_graph.use(cull, graph_resources.draw_count, RenderGraph::Access::ComputeStorageWrite);
+    }
+
+    uint32_t objects = render_graph.addPass("objects", [this](VkCommandBuffer command_buffer)
+    {
+        return recordObjectsPass(command_buffer);
+    });
+    render_graph.use(objects, graph_resources.color, RenderGraph::Access::ColorAttachmentWrite);
+    render_graph.use(objects, graph_resources.depth, RenderGraph::Access::DepthAttachmentWrite);
+    render_graph.use(objects, graph_resources.instances, RenderGraph::Access::VertexRead);
+    if(draw_path != DrawPath::PerObject || gpu_cull)
+    {
+        render_graph.use(objects, graph_resources.draws, RenderGraph::Access::IndirectRead);
+    }
+    if(gpu_cull && culling.compact)
+    {
+        render_graph.use(objects, graph_resources.draw_count, RenderGraph::Access::IndirectRead);
+    }
+
+    if(gpu_cull)
+    {
+        uint32_t pyramid = render_graph.addPass("depth_pyramid", [this](VkCommandBuffer command_buffer)
+        {
+            uint32_t pyramid_scope = gpu_profiler.beginScope(command_buffer, "depth_pyramid");
+            culling.recordDepthPyramid(command_buffer);
+            gpu_profiler.endScope(command_buffer, pyramid_scope, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+            return true;
+        });
+        render_graph.use(pyramid, graph_resources.depth, RenderGraph::Access::ComputeSampledRead);
+        //Nothing in this frame reads the pyramid, the next frame's cull does
+        render_graph.keep(pyramid);
+        late_graph_pass = pyramid + 1;
+    }
+
+    //Copied out once everything has drawn into it, before it is presented
+    if(!capture_path.empty())
+    {
+        uint32_t copy = render_graph.addPass("capture", [this](VkCommandBuffer command_buffer)
+        {
+            uint32_t capture_scope = gpu_profiler.beginScope(command_buffer, "capture");
+            bool recorded = capture.recordCopy(command_buffer, swap_chain_images[frame_image_index], swap_chain_extent,
+                submitted_frames + 1);
+            gpu_profiler.endScope(command_buffer, capture_scope, VK_PIPELINE_STAGE_TRANSFER_BIT);
+            return recorded;
+        });
+        render_graph.use(copy, graph_resources.color, RenderGraph::Access::TransferRead);
+        //Nothing in the graph reads what it writes, the writer thread does
+        render_graph.keep(copy);
+    }
+
+    //Without a swap chain there is no present layout; leave the image ready to be copied out
+    render_graph.markOutput(graph_resources.color,
+        headless ? RenderGraph::Access::TransferRead : RenderGraph::Access::Present);
+    if(!render_graph.compile())
+    {
+        return false;
+    }
+
+    if(gpu_cull)
+    {
+        return culling.setDepthBuffer(render_graph.imageView(graph_resources.depth), swap_chain_extent);
+    }
+    return true;
+}
+
+bool Renderer::createImageViews()
+{
+    swap_chain_image_views.resize(swap_chain_images.size());
+
+    for(size_t i = 0; i < swap_chain_images.size(); i++)
+    {
+        VkImageViewCreateInfo create_info = {};
+        create_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+        create_info.image = swap_chain_images[i];
+        create_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        create_info.format = swap_chain_image_format;
+        create_info.components.r = VK_COMPONENT_SWIZZLE_IDENTITY;
+        create_info.components.g = VK_COMPONENT_SWIZZLE_IDENTITY;
+        create_info.components.b = VK_COMPONENT_SWIZZLE_IDENTITY;
+        create_info.components.a = VK_COMPONENT_SWIZZLE_IDENTITY;
+        create_info.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        create_info.subresourceRange.baseMipLevel = 0;
+        create_info.subresourceRange.levelCount = 1;
+        create_info.subresourceRange.baseArrayLayer = 0;
+        create_info.subresourceRange.layerCount = 1;
+
+        if(vkCreateImageView(device, &create_info, nullptr, &swap_chain_image_views[i]) != VK_SUCCESS)
+        {
+            std::cout << "Failed to create image views!" << std::endl;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+VkSurfaceFormatKHR chooseSwapSurfaceFormat(const std::vector<VkSurfaceFormatKHR>& available_formats)
+{
+    for(const auto& available_format : available_formats)
+    {
+        if(available_format.format == VK_FORMAT_B8G8R8A8_SRGB && available_format.colorSpace == VK_COLOR_SPACE_SRGB_NONLINEAR_KHR)
+        {
+            return available_format;
+        }
+    }
+
+    return available_formats[0];
+}
+
+VkPresentModeKHR chooseSwapPresentMode(const std::vector<VkPresentModeKHR>& available_present_modes, LatencyPolicy policy)
+{
+    std::vector<VkPresentModeKHR> preferred_modes = {};
+    if(policy == LatencyPolicy::LowLatency)
+    {
+        preferred_modes = {VK_PRESENT_MODE_IMMEDIATE_KHR, VK_PRESENT_MODE_MAILBOX_KHR};
+    }
+    else if(policy == LatencyPolicy::Throughput)
+    {
+        preferred_modes = {VK_PRESENT_MODE_MAILBOX_KHR};
+    }
+    for(VkPresentModeKHR preferred_mode : preferred_modes)
+    {
+        if(std::find(available_present_modes.begin(), available_present_modes.end(), preferred_mode) != available_present_modes.end())
+        {
+            return preferred_mode;
+        }
+    }
+    //Always supported
+    return VK_PRESENT_MODE_FIFO_KHR;
+}
+
+VkExtent2D Renderer::chooseSwapExtent(const VkSurfaceCapabilitiesKHR& capabilities)
+{
+    if(capabilities.currentExtent.width != std::numeric_limits<uint32_t>::max())
+    {
+        return capabilities.currentExtent;
+    }
+    else
+    {
+        int width = 0;
+        int height = 0;
+        SDL_Vulkan_GetDrawableSize(sdl_window, &width, &height);
+
+        VkExtent2D actual_extent = {static_cast<uint32_t>(width), static_cast<uint32_t>(height)};
+        actual_extent.width = std::clamp(actual_extent.width, capabilities.minImageExtent.width,
+                                swap_chain_support.capabilities.maxImageExtent.width);
+        actual_extent.height = std::clamp(actual_extent.height, capabilities.minImageExtent.height,
+                                swap_chain_support.capabilities.maxImageExtent.height);
+
+        return actual_extent;
+
+    }
+
+}
+
+SwapChainSupportDetails Renderer::querySwapChainSupport(VkPhysicalDevice device)
+{
+    SwapChainSupportDetails details = {};
+    vkGetPhysicalDeviceSurfaceCapabilitiesKHR(device, surface, &details.capabilities);
+
+    uint32_t format_count = 0;
+    vkGetPhysicalDeviceSurfaceFormatsKHR(device, surface, &format_count, nullptr);
+    if(format_count != 0)
+    {
+        details.formats.resize(format_count);
+        vkGetPhysicalDeviceSurfaceFormatsKHR(device, surface, &format_count, details.formats.data());
+    }
+
+    uint32_t present_mode_count = 0;
+    vkGetPhysicalDeviceSurfacePresentModesKHR(device, surface, &present_mode_count, nullptr);
+    if(present_mode_count != 0)
+    {
+        details.present_modes.resize(present_mode_count);
+        vkGetPhysicalDeviceSurfacePresentModesKHR(device, surface, &present_mode_count, details.present_modes.data());
+    }
+
+    return details;
+}
+
+bool Renderer::createSwapChain()
+{
+    swap_chain_support = querySwapChainSupport(physical_device);
+
+    VkSurfaceFormatKHR surface_format = chooseSwapSurfaceFormat(swap_chain_support.formats);
+    VkPresentModeKHR present_mode = chooseSwapPresentMode(swap_chain_support.present_modes, latency_policy);
+    swap_chain_extent = chooseSwapExtent(swap_chain_support.capabilities);
+    swap_chain_image_format = surface_format.format;
+
+    //Every image beyond the minimum is another frame that can queue up in front of the display
+    uint32_t image_count = swap_chain_support.capabilities.minImageCount;
+    if(latency_policy == LatencyPolicy::Throughput)
+    {
+        image_count++;
+    }
+    if(swap_chain_support.capabilities.maxImageCount > 0 && image_count > swap_chain_support.capabilities.maxImageCount)
+    {
+        image_count = swap_chain_support.capabilities.maxImageCount;
+    }
+
+    VkSwapchainCreateInfoKHR create_info = {};
+    create_info.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR;
+    create_info.surface = surface;
+    create_info.minImageCount = image_count;
+    create_info.imageFormat = surface_format.format;
+    create_info.imageColorSpace = surface_format.colorSpace;
+    create_info.imageExtent = swap_chain_extent;
+    create_info.imageArrayLayers = 1;
+    create_info.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+    if(!capture_path.empty())
+    {
+        if(swap_chain_support.capabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_SRC_BIT)
+        {
+            create_info.imageUsage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+        }
+        else
+        {
+            std::cout << "Swap chain images can't be copied from, capture disabled" << std::endl;
+            capture_path.clear();
+        }
+    }
+
+    uint32_t queue_family_indices[] = {indices.graphics_family, indices.present_family};
+    if(indices.graphics_family != indices.present_family)
+    {
+        create_info.imageSharingMode = VK_SHARING_MODE_CONCURRENT;
+        create_info.queueFamilyIndexCount = 2;
+        create_info.pQueueFamilyIndices = queue_family_indices;
+    }
+    else
+    {
+        create_info.imageSharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        create_info.queueFamilyIndexCount = 0;
+        create_info.pQueueFamilyIndices = nullptr;
+    }
+    create_info.preTransform = swap_chain_support.capabilities.currentTransform;
+    create_info.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
+    create_info.presentMode = present_mode;
+    create_info.clipped = VK_TRUE;
+    //Lets the driver hand resources over from the swap chain being replaced, if any
+    create_info.oldSwapchain = swap_chain;
+
+    VkSwapchainKHR new_swap_chain = VK_NULL_HANDLE;
+    if(vkCreateSwapchainKHR(device, &create_info, nullptr, &new_swap_chain) != VK_SUCCESS)
+    {
+        std::cout << "Failed to create swap chain!" << std::endl;
+        return false;
+    }
+    if(swap_chain == VK_NULL_HANDLE)
+    {
+        const char* mode_names[] = {"immediate", "mailbox", "fifo", "fifo relaxed"};
+        std::cout << "Latency policy " << latencyPolicyName(latency_policy) << ": "
+            << (present_mode <= VK_PRESENT_MODE_FIFO_RELAXED_KHR ? mode_names[present_mode] : "other") << " present mode, "
+            << image_count << " swap chain images" << (present_wait ? ", present wait" : "") << std::endl;
+    }
+    swap_chain = new_swap_chain;
+    //Ids presented to the old swap chain will never report on the new one
+    presented_id = present_id;
+    presented_time = std::chrono::steady_clock::now();
+
+    //Retrieve swap chain images
+    vkGetSwapchainImagesKHR(device, swap_chain, &image_count, nullptr);
+    swap_chain_images.resize(image_count);
+    vkGetSwapchainImagesKHR(device, swap_chain, &image_count, swap_chain_images.data());
+
+    return true;
+}
+
+bool Renderer::recreateSwapChain()
+{
+    int width = 0;
+    int height = 0;
+    SDL_Vulkan_GetDrawableSize(sdl_window, &width, &height);
+    if(width == 0 || height == 0)
+    {
+        //Minimized, try again once the window has a size
+        framebuffer_resized = true;
+        return true;
+    }
+    framebuffer_resized = false;
+
+    //Frames still in flight keep using the old objects, hand them to the deletion queue instead of idling the device
+    VkSwapchainKHR old_swap_chain = swap_chain;
+    std::vector<VkImageView> old_image_views = swap_chain_image_views;
+    std::vector<VkFramebuffer> old_frame_buffers = swap_chain_frame_buffers;
+    VkFormat old_format = swap_chain_image_format;
+
+    if(!createSwapChain())
+    {
+        return false;
+    }
+
+    VkDevice device_handle = device;
+    deferDestroy([device_handle, old_swap_chain, old_image_views, old_frame_buffers]()
+    {
+        for(auto frame_buffer : old_frame_buffers)
+        {
+            vkDestroyFramebuffer(device_handle, frame_buffer, nullptr);
+        }
+        for(auto image_view : old_image_views)
+        {
+            vkDestroyImageView(device_handle, image_view, nullptr);
+        }
+        vkDestroySwapchainKHR(device_handle, old_swap_chain, nullptr);
+    });
+
+    if(swap_chain_image_format != old_format)
+    {
+        std::cout << "Swap chain format changed on recreation, this is not supported!" << std::endl;
+        return false;
+    }
+
+    //The depth buffer follows the swap chain size, the graph only recreates it when the extent changed
+    if(!buildRenderGraph())
+    {
+        return false;
+    }
+
+    if(!createImageViews() || !createFrameBuffers())
+    {
+        return false;
+    }
+
+    images_in_flight.assign(swap_chain_images.size(), VK_NULL_HANDLE);
+
+    return true;
+}
+
+bool Renderer::createOffscreenTargets()
+{
+    //Stand-ins for swap chain images: one per frame in flight, sized like the window would be
+    swap_chain_image_format = VK_FORMAT_R8G8B8A8_UNORM;
+    swap_chain_extent = {static_cast<uint32_t>(window_width), static_cast<uint32_t>(window_height)};
+    swap_chain_images.resize(max_frames_in_flight);
+    offscreen_image_allocations.resize(max_frames_in_flight);
+
+    for(size_t i = 0; i < swap_chain_images.size(); i++)
+    {
+        VkImageCreateInfo image_info = {};
+        image_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        image_info.imageType = VK_IMAGE_TYPE_2D;
+        image_info.format = swap_chain_image_format;
+        image_info.extent = {swap_chain_extent.width, swap_chain_extent.height, 1};
+        image_info.mipLevels = 1;
+        image_info.arrayLayers = 1;
+        image_info.samples = VK_SAMPLE_COUNT_1_BIT;
+        image_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+        image_info.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+        image_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        image_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+        if(!allocator.createImage(image_info, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 0, &swap_chain_images[i], &offscreen_image_allocations[i]))
+        {
+            std::cout << "Failed to create offscreen image!" << std::endl;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void populateDebugMessengerCreateInfo(VkDebugUtilsMessengerCreateInfoEXT& create_info)
+{
+    create_info = {};
+    create_info.sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_MESSENGER_CREATE_INFO_EXT;
+    create_info.messageSeverity = VK_DEBUG_UTILS_MESSAGE_SEVERITY_VERBOSE_BIT_EXT 
+                                | VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT 
+                                | VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT;
+    create_info.messageType = VK_DEBUG_UTILS_MESSAGE_TYPE_GENERAL_BIT_EXT 
+                            | VK_DEBUG_UTILS_MESSAGE_TYPE_VALIDATION_BIT_EXT 
+                            |VK_DEBUG_UTILS_MESSAGE_TYPE_PERFORMANCE_BIT_EXT;
+    create_info.pfnUserCallback = debugCallback;
+    create_info.pUserData = nullptr; //Optional
+}
+
+bool Renderer::setupDebugMessenger()
+{
+    if(enable_validation_layers)
+    {
+        VkDebugUtilsMessengerCreateInfoEXT create_info;
+        populateDebugMessengerCreateInfo(create_info);
+        if(CreateDebugUtilsMessengerEXT(instance, &create_info, nullptr, &debug_messenger))
+        {
+            std::cout << "Failed to set up debug messenger. " << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+bool checkValidationLayerSupport(const std::vector<const char*> validation_layers)
+{
+    uint32_t layer_count = 0;
+    vkEnumerateInstanceLayerProperties(&layer_count, nullptr);
+
+    std::vector<VkLayerProperties> available_layers(layer_count);
+    vkEnumerateInstanceLayerProperties(&layer_count, available_layers.data());
+
+    for(const char* layer_name : validation_layers)
+    {
+        bool layer_found = false;
+        for(const auto& layer_properties : available_layers)
+        {
+            if(strcmp(layer_name, layer_properties.layerName) == 0)
+            {
+                layer_found = true;
+                break;
+            }
+        }
+
+        if(!layer_found)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool Renderer::enableValidationLayer()
+{
+    #ifdef NDEBUG
+        enable_validation_layers = false;
+    #else
+        enable_validation_layers = true;
+    #endif
+
+    if(enable_validation_layers && !checkValidationLayerSupport(validation_layers))
+    {
+        std::cout << "Validation layers requested, but not available." << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool Renderer::createSurface()
+{
+    if(!SDL_Vulkan_CreateSurface(sdl_window, instance, &surface))
+    {
+        std::cout << "Failed to create SDL Vulkan surface! " << SDL_GetError() << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool Renderer::queryExtensions()
+{
+    if(headless)
+    {
+        //No window, so no surface extensions either
+        extensions.clear();
+        if(enable_validation_layers)
+        {
+            extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
+        }
+        return true;
+    }
+
+    unsigned int extension_count = 0;
+    if(!SDL_Vulkan_GetInstanceExtensions(sdl_window, &extension_count, nullptr))
+    {
+        std::cout << "Could not get Vulkan instance extensions: " << SDL_GetError() << std::endl;
+        return false;
+    }
+    extensions.resize(extension_count);
+    if(!SDL_Vulkan_GetInstanceExtensions(sdl_window, &extension_count, extensions.data()))
+    {
+        std::cout << "Could not get Vulkan instance extensions: " << SDL_GetError() << std::endl;
+        return false;
+    }
+    //extensions.push_back(VK_KHR_surface);
+    if(enable_validation_layers)
+    {
+        extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
+    }
+    return true;
+}
+
+bool Renderer::createInstance()
+{
+    VkApplicationInfo app_info = {};
+    app_info.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
+    app_info.pApplicationName = "Hello Triangle";
+    app_info.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
+    app_info.pEngineName = "No Engine";
+    app_info.engineVersion = VK_MAKE_VERSION(1, 0, 0);
+    //Ask for 1.2 when the loader has it, that makes timeline semaphores core. A 1.0 loader has no
+    //vkEnumerateInstanceVersion at all.
+    instance_api_version = VK_API_VERSION_1_0;
+    auto enumerate_instance_version = (PFN_vkEnumerateInstanceVersion) vkGetInstanceProcAddr(nullptr, "vkEnumerateInstanceVersion");
+    uint32_t loader_version = VK_API_VERSION_1_0;
+    if(enumerate_instance_version != nullptr && enumerate_instance_version(&loader_version) == VK_SUCCESS)
+    {
+        instance_api_version = std::min(loader_version, static_cast<uint32_t>(VK_API_VERSION_1_2));
+    }
+    app_info.apiVersion = instance_api_version;
+
+    VkInstanceCreateInfo create_instance_info = {};
+    create_instance_info.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
+    create_instance_info.enabledExtensionCount = static_cast<uint32_t>(extensions.size());
+    create_instance_info.ppEnabledExtensionNames = extensions.data();
+    create_instance_info.pApplicationInfo = &app_info;
+
+    VkDebugUtilsMessengerCreateInfoEXT debug_create_info = {};
+    if(enable_validation_layers)
+    {
+        create_instance_info.enabledLayerCount = static_cast<uint32_t>(validation_layers.size());
+        create_instance_info.ppEnabledLayerNames = validation_layers.data();
+        populateDebugMessengerCreateInfo(debug_create_info);
+        create_instance_info.pNext = (VkDebugUtilsMessengerCreateInfoEXT*) &debug_create_info;
+    }
+    else
+    {
+        create_instance_info.enabledLayerCount = 0;
+        create_instance_info.pNext = nullptr;
+    }
+
+    if(vkCreateInstance(&create_instance_info, nullptr, &instance) != VK_SUCCESS)
+    {
+        std::cout << "Failed to create Vulkan instance." << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+bool Renderer::initAndCreateSDLWindow()
+{
+    //SDL open window
+    if(SDL_Init(SDL_INIT_VIDEO) < 0)
+    {
+        std::cout << "SDL could not initialize! Error: " << SDL_GetError() << std::endl;
+        return false;
+    }
+
+    sdl_window = SDL_CreateWindow("Vulkan Intro", SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED, window_width, window_height, SDL_WINDOW_SHOWN | SDL_WINDOW_VULKAN | SDL_WINDOW_RESIZABLE);
+    if(sdl_window == nullptr)
+    {
+        std::cout << "Could not create window: " << SDL_GetError() << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool Renderer::createLogicalDevice()
+{
+    std::vector<VkDeviceQueueCreateInfo> queue_create_infos = {};
+    std::set<uint32_t> unique_queue_families = {indices.graphics_family, indices.present_family, indices.transfer_family,
+        indices.compute_family};
+    const float queue_priorities[] = {1.0f, 1.0f};
+    for(uint32_t queue_family : unique_queue_families)
+    {
+        VkDeviceQueueCreateInfo queue_create_info = {};
+        queue_create_info.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+        queue_create_info.queueFamilyIndex = queue_family;
+        queue_create_info.queueCount = queue_family == indices.transfer_family ? indices.transfer_queue_index + 1 : 1;
+        queue_create_info.pQueuePriorities = queue_priorities;
+        queue_create_infos.push_back(queue_create_info);
+    }
+
+    //Turn on the optional features the draw paths can use, and remember which ones we got
+    VkPhysicalDeviceFeatures supported_features = {};
+    vkGetPhysicalDeviceFeatures(physical_device, &supported_features);
+    VkPhysicalDeviceProperties device_properties = {};
+    vkGetPhysicalDeviceProperties(physical_device, &device_properties);
+
+    VkPhysicalDeviceFeatures device_features = {};
+    device_features.multiDrawIndirect = supported_features.multiDrawIndirect;
+    device_features.drawIndirectFirstInstance = supported_features.drawIndirectFirstInstance;
+    capabilities.multi_draw_indirect = supported_features.multiDrawIndirect == VK_TRUE;
+    capabilities.draw_indirect_first_instance = supported_features.drawIndirectFirstInstance == VK_TRUE;
+    capabilities.max_draw_indirect_count = std::max(device_properties.limits.maxDrawIndirectCount, 1u);
+    capabilities.min_buffer_offset_alignment = std::max(device_properties.limits.minUniformBufferOffsetAlignment,
+        device_properties.limits.minStorageBufferOffsetAlignment);
+
+    //Optional extensions, enabled when the device has them
+    uint32_t extension_count = 0;
+    vkEnumerateDeviceExtensionProperties(physical_device, nullptr, &extension_count, nullptr);
+    std::vector<VkExtensionProperties> available_extensions(extension_count);
+    vkEnumerateDeviceExtensionProperties(physical_device, nullptr, &extension_count, available_extensions.data());
+    std::vector<const char*> enabled_extensions = device_extensions;
+    bool timeline_extension = false;
+    bool dynamic_rendering_extension = false;
+    bool descriptor_indexing_extension = false;
+    bool present_id_extension = false;
+    bool present_wait_extension = false;
+    for(const auto& extension : available_extensions)
+    {
+        if(strcmp(extension.extensionName, VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME) == 0)
+        {
+            enabled_extensions.push_back(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+            capabilities.draw_indirect_count = true;
+        }
+        if(strcmp(extension.extensionName, VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME) == 0)
+        {
+            timeline_extension = true;
+        }
+        if(strcmp(extension.extensionName, VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME) == 0)
+        {
+            dynamic_rendering_extension = true;
+        }
+        if(strcmp(extension.extensionName, VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME) == 0)
+        {
+            descriptor_indexing_extension = true;
+        }
+        if(strcmp(extension.extensionName, VK_KHR_PRESENT_ID_EXTENSION_NAME) == 0)
+        {
+            present_id_extension = true;
+        }
+        if(strcmp(extension.extensionName, VK_KHR_PRESENT_WAIT_EXTENSION_NAME) == 0)
+        {
+            present_wait_extension = true;
+        }
+    }
+
+    //Timeline semaphores are core in 1.2 and VK_KHR_timeline_semaphore before that, either way the feature
+    //has to be queried and enabled through the 1.1 features2 chain. The same goes for dynamic rendering,
+    //which is only used from 1.2 on where the extensions it builds on are core, descriptor indexing and
+    //present id/wait.
+    uint32_t device_api_version = std::min(instance_api_version, device_properties.apiVersion);
+    VkPhysicalDeviceTimelineSemaphoreFeatures timeline_features = {};
+    timeline_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES;
+    VkPhysicalDeviceDynamicRenderingFeaturesKHR dynamic_rendering_features = {};
+    dynamic_rendering_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES_KHR;
+    bool query_timeline = device_api_version >= VK_API_VERSION_1_1
+        && (device_api_version >= VK_API_VERSION_1_2 || timeline_extension);
+    bool query_dynamic_rendering = device_api_version >= VK_API_VERSION_1_2 && dynamic_rendering_extension;
+    VkPhysicalDeviceDescriptorIndexingFeatures indexing_features = {};
+    indexing_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES;
+    bool query_indexing = device_api_version >= VK_API_VERSION_1_1
+        && (device_api_version >= VK_API_VERSION_1_2 || descriptor_indexing_extension);
+    VkPhysicalDevicePresentIdFeaturesKHR present_id_features = {};
+    present_id_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR;
+    VkPhysicalDevicePresentWaitFeaturesKHR present_wait_features = {};
+    present_wait_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR;
+    bool query_present_wait = device_api_version >= VK_API_VERSION_1_1 && present_id_extension && present_wait_extension;
+    if(query_timeline || query_dynamic_rendering || query_indexing || query_present_wait)
+    {
+        VkPhysicalDeviceFeatures2 features2 = {};
+        features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+        features2.pNext = &timeline_features;
+        timeline_features.pNext = &indexing_features;
+        if(query_dynamic_rendering)
+        {
+            indexing_features.pNext = &dynamic_rendering_features;
+        }
+        if(query_present_wait)
+        {
+            present_id_features.pNext = &present_wait_features;
+            present_wait_features.pNext = features2.pNext;
+            features2.pNext = &present_id_features;
+        }
+        vkGetPhysicalDeviceFeatures2(physical_device, &features2);
+        capabilities.timeline_semaphore = timeline_features.timelineSemaphore == VK_TRUE;
+        capabilities.dynamic_rendering = dynamic_rendering_features.dynamicRendering == VK_TRUE;
+        //The bindless shader indexes the palette buffer array with a push constant, not a constant expression
+        capabilities.descriptor_indexing = indexing_features.runtimeDescriptorArray == VK_TRUE
+            && supported_features.shaderStorageBufferArrayDynamicIndexing == VK_TRUE
+            && indexing_features.descriptorBindingPartiallyBound == VK_TRUE
+            && indexing_features.descriptorBindingSampledImageUpdateAfterBind == VK_TRUE
+            && indexing_features.descriptorBindingStorageBufferUpdateAfterBind == VK_TRUE;
+        capabilities.present_wait = present_id_features.presentId == VK_TRUE && present_wait_features.presentWait == VK_TRUE;
+        timeline_features.pNext = nullptr;
+        present_id_features.pNext = nullptr;
+        present_wait_features.pNext = nullptr;
+        indexing_features.pNext = nullptr;
+        dynamic_rendering_features.pNext = nullptr;
+    }
+    if(capabilities.descriptor_indexing)
+    {
+        VkPhysicalDeviceDescriptorIndexingProperties indexing_properties = {};
+        indexing_properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES;
+        VkPhysicalDeviceProperties2 properties2 = {};
+        properties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+        properties2.pNext = &indexing_properties;
+        vkGetPhysicalDeviceProperties2(physical_device, &properties2);
+        capabilities.max_bindless_images = std::min(indexing_properties.maxDescriptorSetUpdateAfterBindSampledImages,
+            indexing_properties.maxPerStageDescriptorUpdateAfterBindSampledImages);
+        capabilities.max_bindless_buffers = std::min(indexing_properties.maxDescriptorSetUpdateAfterBindStorageBuffers,
+            indexing_properties.maxPerStageDescriptorUpdateAfterBindStorageBuffers);
+    }
+    if(capabilities.timeline_semaphore && device_api_version < VK_API_VERSION_1_2)
+    {
+        enabled_extensions.push_back(VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME);
+    }
+
+    if(dynamic_rendering && !capabilities.dynamic_rendering)
+    {
+        std::cout << "VK_KHR_dynamic_rendering is not supported, rendering through a render pass" << std::endl;
+        dynamic_rendering = false;
+    }
+    //Only chain the features that get enabled
+    void* enabled_features = nullptr;
+    if(capabilities.timeline_semaphore)
+    {
+        enabled_features = &timeline_features;
+    }
+    if(dynamic_rendering)
+    {
+        enabled_extensions.push_back(VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME);
+        dynamic_rendering_features.pNext = enabled_features;
+        enabled_features = &dynamic_rendering_features;
+    }
+    if(bindless && !capabilities.descriptor_indexing)
+    {
+        std::cout << "Descriptor indexing is not supported, binding a descriptor set per palette" << std::endl;
+        bindless = false;
+    }
+    //Only the parts the heap uses
+    VkPhysicalDeviceDescriptorIndexingFeatures enabled_indexing_features = {};
+    enabled_indexing_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES;
+    if(bindless)
+    {
+        if(device_api_version < VK_API_VERSION_1_2)
+        {
+            enabled_extensions.push_back(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME);
+        }
+        device_features.shaderStorageBufferArrayDynamicIndexing = VK_TRUE;
+        enabled_indexing_features.runtimeDescriptorArray = VK_TRUE;
+        enabled_indexing_features.descriptorBindingPartiallyBound = VK_TRUE;
+        enabled_indexing_features.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+        enabled_indexing_features.descriptorBindingStorageBufferUpdateAfterBind = VK_TRUE;
+        enabled_indexing_features.shaderSampledImageArrayNonUniformIndexing = indexing_features.shaderSampledImageArrayNonUniformIndexing;
+        enabled_indexing_features.shaderStorageBufferArrayNonUniformIndexing = indexing_features.shaderStorageBufferArrayNonUniformIndexing;
+        enabled_indexing_features.pNext = enabled_features;
+        enabled_features = &enabled_indexing_features;
+    }
+
+    //Nothing is presented headless
+    present_wait = capabilities.present_wait && !headless;
+    if(present_wait)
+    {
+        enabled_extensions.push_back(VK_KHR_PRESENT_ID_EXTENSION_NAME);
+        enabled_extensions.push_back(VK_KHR_PRESENT_WAIT_EXTENSION_NAME);
+        present_wait_features.pNext = enabled_features;
+        present_id_features.pNext = &present_wait_features;
+        enabled_features = &present_id_features;
+    }
+
+    if(gpu_cull && !capabilities.draw_indirect_first_instance)
+    {
+        std::cout << "GPU culling needs drawIndirectFirstInstance, culling disabled" << std::endl;
+        gpu_cull = false;
+    }
+
+    //Culling is the only compute work, everything else stays where it was
+    if(async_compute && !gpu_cull)
+    {
+        std::cout << "Async compute only runs the GPU cull, which is off; staying on the graphics queue" << std::endl;
+        async_compute = false;
+    }
+    else if(async_compute && indices.compute_family == indices.graphics_family)
+    {
+        std::cout << "No compute only queue family, culling on the graphics queue" << std::endl;
+        async_compute = false;
+    }
+    else if(async_compute && !capabilities.timeline_semaphore)
+    {
+        std::cout << "Timeline semaphores are not supported, culling on the graphics queue" << std::endl;
+        async_compute = false;
+    }
+
+    VkDeviceCreateInfo create_info = {};
+    create_info.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+    create_info.pNext = enabled_features;
+    create_info.pQueueCreateInfos = queue_create_infos.data();
+    create_info.queueCreateInfoCount = static_cast<uint32_t>(queue_create_infos.size());
+    create_info.pEnabledFeatures = &device_features;
+    create_info.enabledExtensionCount = static_cast<uint32_t>(enabled_extensions.size());
+    create_info.ppEnabledExtensionNames = enabled_extensions.data();
+
+    if(enable_validation_layers)
+    {
+        create_info.enabledLayerCount = static_cast<uint32_t>(validation_layers.size());
+        create_info.ppEnabledLayerNames = validation_layers.data();
+    }
+    else
+    {
+        create_info.enabledLayerCount = 0;
+    }
+
+    if(vkCreateDevice(physical_device, &create_info, nullptr, &device) != VK_SUCCESS)
+    {
+        std::cout << "Failed to create logical device!" << std::endl;
+        return false;
+    }
+
+    vkGetDeviceQueue(device, indices.graphics_family, 0, &graphics_queue);
+    vkGetDeviceQueue(device, indices.present_family, 0, &present_queue);
+    vkGetDeviceQueue(device, indices.transfer_family, indices.transfer_queue_index, &transfer_queue);
+    vkGetDeviceQueue(device, indices.compute_family, 0, &compute_queue);
+
+    if(capabilities.draw_indirect_count)
+    {
+        cmd_draw_indexed_indirect_count = (PFN_vkCmdDrawIndexedIndirectCountKHR) vkGetDeviceProcAddr(device, "vkCmdDrawIndexedIndirectCountKHR");
+        capabilities.draw_indirect_count = cmd_draw_indexed_indirect_count != nullptr;
+    }
+    if(dynamic_rendering)
+    {
+        cmd_begin_rendering = (PFN_vkCmdBeginRenderingKHR) vkGetDeviceProcAddr(device, "vkCmdBeginRenderingKHR");
+        cmd_end_rendering = (PFN_vkCmdEndRenderingKHR) vkGetDeviceProcAddr(device, "vkCmdEndRenderingKHR");
+        if(cmd_begin_rendering == nullptr || cmd_end_rendering == nullptr)
+        {
+            std::cout << "Failed to load the VK_KHR_dynamic_rendering commands!" << std::endl;
+            return false;
+        }
+    }
+    if(present_wait)
+    {
+        wait_for_present = (PFN_vkWaitForPresentKHR) vkGetDeviceProcAddr(device, "vkWaitForPresentKHR");
+        present_wait = wait_for_present != nullptr;
+    }
+
+    return true;
+}
+
+bool Renderer::findQueueFamilies()
+{
+    uint32_t queue_families_count = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(physical_device, &queue_families_count, nullptr);
+    if(queue_families_count == 0)
+    {
+        std::cout << "Physical device " << physical_device << " doesn't have any queue families!" << std::endl;
+        return false;
+    }
+
+    std::vector<VkQueueFamilyProperties> queue_families(queue_families_count);
+    vkGetPhysicalDeviceQueueFamilyProperties(physical_device, &queue_families_count, &queue_families[0]);
+    //Take the first match of every kind. A graphics family that can also present is preferred, so both
+    //usually end up on the same queue.
+    int graphics_family = -1;
+    int present_family = -1;
+    int graphics_present_family = -1;
+    //Compute only families map to the async compute engines
+    int compute_only_family = -1;
+    //Transfer only families map to the copy engines; any non graphics family is the next best thing
+    int transfer_only_family = -1;
+    int non_graphics_family = -1;
+    for(uint32_t i = 0; i < queue_families_count; i++)
+    {
+        const auto& queue_family = queue_families[i];
+        if(queue_family.queueCount == 0)
+        {
+            continue;
+        }
+        bool graphics = (queue_family.queueFlags & VK_QUEUE_GRAPHICS_BIT) != 0;
+        if(graphics && graphics_family < 0)
+        {
+            graphics_family = i;
+        }
+        if(!graphics)
+        {
+            if((queue_family.queueFlags & VK_QUEUE_COMPUTE_BIT) && compute_only_family < 0)
+            {
+                compute_only_family = i;
+            }
+            if((queue_family.queueFlags & VK_QUEUE_TRANSFER_BIT) && !(queue_family.queueFlags & VK_QUEUE_COMPUTE_BIT))
+            {
+                transfer_only_family = transfer_only_family < 0 ? i : transfer_only_family;
+            }
+            //Compute queues support transfers even when they don't advertise it
+            else if(queue_family.queueFlags & (VK_QUEUE_TRANSFER_BIT | VK_QUEUE_COMPUTE_BIT))
+            {
+                non_graphics_family = non_graphics_family < 0 ? i : non_graphics_family;
+            }
+        }
+        if(headless)
+        {
+            continue;
+        }
+        VkBool32 present_support = false;
+        vkGetPhysicalDeviceSurfaceSupportKHR(physical_device, i, surface, &present_support);
+        if(present_support && present_family < 0)
+        {
+            present_family = i;
+        }
+        if(present_support && graphics && graphics_present_family < 0)
+        {
+            graphics_present_family = i;
+        }
+    }
+
+    if(graphics_family < 0)
+    {
+        std::cout << "Physical device " << physical_device << " doesn't have a graphics queue family!" << std::endl;
+        return false;
+    }
+    if(graphics_present_family >= 0)
+    {
+        graphics_family = graphics_present_family;
+        present_family = graphics_present_family;
+    }
+    indices.graphics_family = graphics_family;
+
+    if(headless)
+    {
+        //Nothing gets presented, point the present queue at the graphics queue
+        indices.present_family = indices.graphics_family;
+    }
+    else if(present_family >= 0)
+    {
+        indices.present_family = present_family;
+    }
+    else
+    {
+        std::cout << "Physical device " << physical_device << " can't present to the window!" << std::endl;
+        return false;
+    }
+
+    indices.compute_family = compute_only_family >= 0 ? compute_only_family : indices.graphics_family;
+
+    if(transfer_only_family >= 0)
+    {
+        indices.transfer_family = transfer_only_family;
+    }
+    else if(non_graphics_family >= 0)
+    {
+        indices.transfer_family = non_graphics_family;
+    }
+    else
+    {
+        indices.transfer_family = indices.graphics_family;
+    }
+
+    //Copies and the async cull sharing a family get a queue each when the family has two
+    indices.transfer_queue_index = 0;
+    if(indices.transfer_family == indices.compute_family && indices.compute_family != indices.graphics_family
+        && queue_families[indices.transfer_family].queueCount > 1)
+    {
+        indices.transfer_queue_index = 1;
+    }
+
+    return true;
+}
+
+bool Renderer::checkDeviceExtensionSupport(VkPhysicalDevice device)
+{
+    uint32_t extension_count = 0;
+    vkEnumerateDeviceExtensionProperties(device, nullptr, &extension_count, nullptr);
+    std::vector<VkExtensionProperties> available_extensions(extension_count);
+    vkEnumerateDeviceExtensionProperties(device, nullptr, &extension_count, available_extensions.data());
+
+    std::set<std::string> required_extensions(device_extensions.begin(), device_extensions.end());
+
+    for(const auto& extension : available_extensions)
+    {
+        required_extensions.erase(extension.extensionName);
+    }
+
+    return required_extensions.empty();
+}
+
+bool Renderer::isDeviceSuitable(VkPhysicalDevice device)
+{
+    //Only what the renderer can't run without, DeviceInfo::computeScore ranks the devices that pass
+    bool extensions_supported = checkDeviceExtensionSupport(device);
+    if(headless)
+    {
+        return extensions_supported;
+    }
+    bool swap_chain_adequate = false;
+    if(extensions_supported)
+    {
+        SwapChainSupportDetails details = querySwapChainSupport(device);
+        swap_chain_adequate = !details.formats.empty() && !details.present_modes.empty();
+    }
+    return extensions_supported && swap_chain_adequate;
+}
+
+bool Renderer::pickPhysicalDevice()
+{
+    //Find all physical GPUs on host
+    uint32_t device_count = 0;
+    vkEnumeratePhysicalDevices(instance, &device_count, nullptr);
+    if(device_count == 0)
+    {
+        std::cout << "Failed to find GPUs with Vulkan support!" << std::endl;
+        return false;
+    }
+    std::vector<VkPhysicalDevice> devices(device_count);
+    vkEnumeratePhysicalDevices(instance, &device_count, devices.data());
+
+    //Evaluate GPUs, the first one didn't have to be the fastest
+    std::vector<DeviceInfo> device_infos(device_count);
+    for(uint32_t i = 0; i < device_count; i++)
+    {
+        DeviceInfo::query(devices[i], i, instance_api_version, &device_infos[i]);
+        device_infos[i].suitable = isDeviceSuitable(devices[i]);
+        device_infos[i].computeScore();
+    }
+
+    //--device beats the environment
+    std::string selector = device_selector;
+    const char* environment_selector = getenv(device_selector_variable);
+    if(selector.empty() && environment_selector != nullptr)
+    {
+        selector = environment_selector;
+    }
+    const DeviceInfo* selected = nullptr;
+    if(!selector.empty())
+    {
+        for(const auto& info : device_infos)
+        {
+            if(info.suitable && info.matches(selector))
+            {
+                selected = &info;
+                break;
+            }
+        }
+        if(selected == nullptr)
+        {
+            std::cout << "No suitable GPU matches \"" << selector << "\", picking by score" << std::endl;
+        }
+    }
+    if(selected == nullptr)
+    {
+        for(const auto& info : device_infos)
+        {
+            if(info.suitable && (selected == nullptr || info.score > selected->score))
+            {
+                selected = &info;
+            }
+        }
+    }
+
+    if(selected == nullptr)
+    {
+        std::cout << "Filed to find a suitable GPU!" << std::endl;
+        return false;
+    }
+    physical_device = selected->device;
+
+    std::cout << "GPUs (override with --device or " << device_selector_variable << "=NAME|UUID|INDEX):" << std::endl;
+    for(const auto& info : device_infos)
+    {
+        info.print(&info == selected);
+    }
+ 
+    return true;
+}
+
+void Renderer::printCapabilityReport() const
+{
+    //What the renderer ended up using on this device, after every fallback
+    std::cout << "Device capabilities: multiDrawIndirect " << (capabilities.multi_draw_indirect ? "yes" : "no")
+        << ", drawIndirectFirstInstance " << (capabilities.draw_indirect_first_instance ? "yes" : "no")
+        << ", draw indirect count " << (capabilities.draw_indirect_count ? "yes" : "no")
+        << ", timeline semaphores " << (capabilities.timeline_semaphore ? "yes" : "no")
+        << ", dynamic rendering " << (capabilities.dynamic_rendering ? "yes" : "no")
+        << ", descriptor indexing " << (capabilities.descriptor_indexing ? "yes" : "no")
+        << ", present wait " << (capabilities.present_wait ? "yes" : "no") << std::endl;
+    std::cout << "Queues: graphics family " << indices.graphics_family << ", present family " << indices.present_family
+        << ", compute family " << indices.compute_family << ", transfer family " << indices.transfer_family
+        << " (queue " << indices.transfer_queue_index << ")" << std::endl;
+    std::cout << "Enabled: draw path " << drawPathName(draw_path) << (gpu_cull ? ", gpu cull" : "")
+        << (async_compute ? ", async compute" : "") << (dynamic_rendering ? ", dynamic rendering" : "")
+        << (bindless ? ", bindless" : "") << (present_wait ? ", present wait" : "") << std::endl;
+}
+
+bool Renderer::initVulkan()
+{
+    bool result = false;
+    if(!headless)
+    {
+        result = initAndCreateSDLWindow();
+        if(!result)
+        {
+            return false;
+        }
+
+        SDL_ShowWindow(sdl_window);
+        device_extensions.push_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
+    }
+
+    result = enableValidationLayer();
+    if(!result)
+    {
+        return false;
+    }
+
+    result = queryExtensions();
+    if(!result)
+    {
+        return false;
+    }
+
+    result = createInstance();
+    if(!result)
+    {
+        return false;
+    }
+
+    result = setupDebugMessenger();
+    if(!result)
+    {
+        return false;
+    }
+
+    if(!headless)
+    {
+        result = createSurface();
+        if(!result)
+        {
+            return false;
+        }
+    }
+
+    result = pickPhysicalDevice();
+    if(!result)
+    {
+        return false;
+    }
+
+    result = findQueueFamilies();
+    if(!result)
+    {
+        return false;
+    }
+
+    result = createLogicalDevice();
+    if(!result)
+    {
+        return false;
+    }
+    printCapabilityReport();
+
+    result = allocator.init(physical_device, device);
+    if(!result)
+    {
+        return false;
+    }
+
+    result = headless ? createOffscreenTargets() : createSwapChain();
+    if(!result)
+    {
+        return false;
+    }
+
+    result = createImageViews();
+    if(!result)
+    {
+        return false;
+    }
+    result = findDepthFormat();
+    if(!result)
+    {
+        return false;
+    }
+    result = createRenderPass();
+    if(!result)
+    {
+        return false;
+    }
+    result = createPipelineCache();
+    if(!result)
+    {
+        return false;
+    }
+    result = pso_cache.init(device, pipeline_cache, pipeline_compile_threads);
+    if(!result)
+    {
+        return false;
+    }
+    if(!asset_archive_path.empty())
+    {
+        result = assets.mountArchive(asset_archive_path);
+        if(!result)
+        {
+            return false;
+        }
+    }
+    layout_cache.init(device);
+    if(bindless)
+    {
+        vert_shader_source = "shader_bindless.vert";
+        result = bindless_heap.init(device, std::min(bindless_capacity, capabilities.max_bindless_images),
+            std::min(bindless_capacity, capabilities.max_bindless_buffers),
+            [this](std::function<void()> destroy) { deferDestroy(std::move(destroy)); });
+        if(!result)
+        {
+            return false;
+        }
+    }
+    result = createGraphicsPipeline();
+    if(!result)
+    {
+        return false;
+    }
+    //Not being able to watch the sources only costs the reloading
+    if(hot_reload && !shader_manager.init("shaders", {vert_shader_source, "shader.frag"}, "shaders/cache"))
+    {
+        std::cout << "Shader hot reload disabled" << std::endl;
+        hot_reload = false;
+    }
+    if(gpu_cull)
+    {
+        //Without a draw count the culled commands stay in place and culled ones draw 0 instances
+        std::vector<uint32_t> culling_families = {indices.graphics_family};
+        if(async_compute)
+        {
+            culling_families.push_back(indices.compute_family);
+        }
+        result = culling.init(device, &allocator, &assets, &layout_cache, pipeline_cache, max_frames_in_flight, capabilities.draw_indirect_count,
+            culling_families, [this](std::function<void()> destroy) { deferDestroy(std::move(destroy)); });
+        if(!result)
+        {
+            return false;
+        }
+    }
+    if(!capture_path.empty())
+    {
+        //A slot per frame in flight is still copying, the rest give the writer room to fall behind
+        result = capture.init(device, &allocator, std::max(capture_slots, max_frames_in_flight + 1), swap_chain_image_format,
+            capture_path);
+        if(!result)
+        {
+            return false;
+        }
+    }
+    result = render_graph.init(device, &allocator, [this](std::function<void()> destroy) { deferDestroy(std::move(destroy)); });
+    if(!result)
+    {
+        return false;
+    }
+    result = buildRenderGraph();
+    if(!result)
+    {
+        return false;
+    }
+    result = createFrameBuffers();
+    if(!result)
+    {
+        return false;
+    }
+
+    result = createCommandPool();
+    if(!result)
+    {
+        return false;
+    }
+    result = createCommandBuffers();
+    if(!result)
+    {
+        return false;
+    }
+    result = upload_manager.init(device, &allocator, transfer_queue, indices.transfer_family, indices.graphics_family, staging_ring_size,
+        capabilities.timeline_semaphore);
+    if(!result)
+    {
+        return false;
+    }
+    result = createGeometryBuffers();
+    if(!result)
+    {
+        return false;
+    }
+    result = createObjectBuffers();
+    if(!result)
+    {
+        return false;
+    }
+    result = createFrameUniforms();
+    if(!result)
+    {
+        return false;
+    }
+    result = createPalettes();
+    if(!result)
+    {
+        return false;
+    }
+    if(record_threads > 0)
+    {
+        result = parallel_recorder.init(device, indices.graphics_family, max_frames_in_flight, record_threads);
+        if(!result)
+        {
+            return false;
+        }
+    }
+    result = gpu_profiler.init(device, physical_device, indices.graphics_family, max_frames_in_flight);
+    if(!result)
+    {
+        return false;
+    }
+    result = createSyncObjects();
+    if(!result)
+    {
+        return false;
+    }
+
+    return true;
+}
+
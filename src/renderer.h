@@ -0,0 +1,561 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <cstdint>
+#include <vulkan/vulkan.h>
+#include "SDL.h"
+#include "gpu_profiler.h"
+#include "memory_allocator.h"
+#include "upload_manager.h"
+#include "parallel_recorder.h"
+#include "gpu_culling.h"
+#include "render_graph.h"
+#include "pipeline_state_cache.h"
+#include "shader_manager.h"
+#include "asset_loader.h"
+#include "shader_reflection.h"
+#include "bindless_heap.h"
+#include "frame_capture.h"
+
+struct QueueFamilyIndices
+{
+    //Support is required by the spec, so it's okay to set these to 0
+    uint32_t graphics_family = 0;
+    uint32_t present_family = 0;
+    //Falls back to the graphics family when there is no separate transfer family
+    uint32_t transfer_family = 0;
+    //Compute without graphics, falls back to the graphics family as well
+    uint32_t compute_family = 0;
+    //Queue index of the transfer queue, 1 when it shares a family with the compute queue
+    uint32_t transfer_queue_index = 0;
+};
+
+//Optional device features the renderer adapts to, filled in when the logical device is created
+struct DeviceCapabilities
+{
+    bool multi_draw_indirect = false;
+    bool draw_indirect_first_instance = false;
+    uint32_t max_draw_indirect_count = 1;
+    //VK_KHR_draw_indirect_count
+    bool draw_indirect_count = false;
+    bool timeline_semaphore = false;
+    //VK_KHR_dynamic_rendering
+    bool dynamic_rendering = false;
+    //Dynamic offsets into the uniform ring have to be a multiple of this
+    VkDeviceSize min_buffer_offset_alignment = 16;
+    //VK_EXT_descriptor_indexing with runtime arrays, partially bound and update after bind bindings
+    bool descriptor_indexing = false;
+    uint32_t max_bindless_images = 0;
+    uint32_t max_bindless_buffers = 0;
+    //VK_KHR_present_id and VK_KHR_present_wait
+    bool present_wait = false;
+};
+
+enum class DrawPath
+{
+    //One vkCmdDrawIndexed per object, the CPU bound baseline
+    PerObject,
+    //One vkCmdDrawIndexedIndirect per batch of instances
+    Indirect,
+    //All batches in a single vkCmdDrawIndexedIndirect, needs multiDrawIndirect
+    MultiIndirect
+};
+
+//How frames are handed to the display
+enum class LatencyPolicy
+{
+    //IMMEDIATE, or MAILBOX without it, on as few images as the surface allows
+    LowLatency,
+    //FIFO on as few images as the surface allows, meant to be paired with a frame rate cap
+    PowerSaving,
+    //MAILBOX, or FIFO without it, with an image to spare so the GPU never waits on the display
+    Throughput
+};
+
+const char* latencyPolicyName(LatencyPolicy);
+const char* drawPathName(DrawPath);
+
+struct SwapChainSupportDetails
+{
+    VkSurfaceCapabilitiesKHR capabilities = {};
+    std::vector<VkSurfaceFormatKHR> formats = {};
+    std::vector<VkPresentModeKHR> present_modes = {};
+};
+
+void DestroyDebugUtilsMessengerEXT(VkInstance, VkDebugUtilsMessengerEXT, const VkAllocationCallbacks*);
+
+class Renderer
+{
+    public:
+        Renderer()
+       {
+            sdl_window = {};
+            instance = {};
+            validation_layers = { "VK_LAYER_KHRONOS_validation"};
+            extensions = {};
+            debug_messenger = {};
+            enable_validation_layers = false;
+            physical_device = VK_NULL_HANDLE;
+            // graphics_family = -1;
+            // present_family = -1;
+            device = {};
+            graphics_queue = {};
+            surface = {};
+            swap_chain = {};
+            swap_chain_images = {};
+            swap_chain_extent = {};
+            swap_chain_image_format = {};
+            swap_chain_image_views = {};
+            graphics_layout = {};
+            render_pass = {};
+            graphics_pipeline = {};
+            pipeline_variant_count = 1;
+            pipeline_variants = {};
+            pipeline_variant_hashes = {};
+            vert_shader_code = {};
+            frag_shader_code = {};
+            hot_reload = false;
+            pending_pipeline_variants = {};
+            pending_pipeline_variant_hashes = {};
+            pending_graphics_layout = {};
+            asset_archive_path = {};
+            swap_chain_frame_buffers = {};
+            command_pool = {};
+            command_buffers = {};
+            image_available_semaphores = {};
+            render_finished_semaphores = {};
+            in_flight_fences = {};
+            images_in_flight = {};
+            max_frames_in_flight = 2;
+            current_frame = 0;
+            headless = false;
+            window_width = 1920;
+            window_height = 1440;
+            offscreen_image_allocations = {};
+            pipeline_cache = VK_NULL_HANDLE;
+            pipeline_cache_path = "pipeline_cache.bin";
+            pipeline_cache_warm = false;
+            framebuffer_resized = false;
+            submitted_frames = 0;
+            completed_frames = 0;
+            frame_submit_indices = {};
+            deletion_queue = {};
+            transfer_queue = {};
+            vertex_buffer = VK_NULL_HANDLE;
+            vertex_buffer_allocation = {};
+            index_buffer = VK_NULL_HANDLE;
+            index_buffer_allocation = {};
+            frame_wait_semaphores = {};
+            frame_wait_stages = {};
+            capabilities = {};
+            object_count = 1;
+            instances_per_draw = 256;
+            draw_path = DrawPath::MultiIndirect;
+            instance_buffer = VK_NULL_HANDLE;
+            instance_buffer_allocation = {};
+            indirect_buffer = VK_NULL_HANDLE;
+            indirect_buffer_allocation = {};
+            indirect_draw_count = 0;
+            draw_first_instances = {};
+            frame_descriptor_pool = VK_NULL_HANDLE;
+            frame_descriptor_set_layout = VK_NULL_HANDLE;
+            frame_descriptor_set = VK_NULL_HANDLE;
+            frame_uniform_offset = 0;
+            bindless = false;
+            vert_shader_source = "shader.vert";
+            palette_buffer = VK_NULL_HANDLE;
+            palette_buffer_allocation = {};
+            palette_stride = 0;
+            palette_slots = {};
+            palette_descriptor_pool = VK_NULL_HANDLE;
+            palette_descriptor_sets = {};
+            scene_time = 0.0f;
+            draw_stats = {};
+            record_threads = 0;
+            secondary_command_buffers = {};
+            scene_extent = 1.0f;
+            gpu_cull = false;
+            cmd_draw_indexed_indirect_count = nullptr;
+            depth_format = VK_FORMAT_UNDEFINED;
+            graph_resources = {};
+            frame_image_index = 0;
+            instance_api_version = VK_API_VERSION_1_0;
+            async_compute = false;
+            compute_queue = {};
+            compute_command_pool = VK_NULL_HANDLE;
+            compute_command_buffers = {};
+            late_command_buffers = {};
+            late_graph_pass = 0;
+            graphics_timeline = VK_NULL_HANDLE;
+            compute_timeline = VK_NULL_HANDLE;
+            frame_wait_values = {};
+            dynamic_rendering = false;
+            cmd_begin_rendering = nullptr;
+            cmd_end_rendering = nullptr;
+            latency_policy = LatencyPolicy::Throughput;
+            device_selector = {};
+            present_wait = false;
+            wait_for_present = nullptr;
+            present_id = 0;
+            presented_id = 0;
+            presented_time = {};
+            capture_path = {};
+            capture_slots = 4;
+       }
+       ~Renderer()
+       {
+            //Everything has finished by now, flush whatever was still waiting on the GPU
+            for(auto& deletion : deletion_queue)
+            {
+                deletion.destroy();
+            }
+            for(size_t i = 0; i < in_flight_fences.size(); i++)
+            {
+                vkDestroySemaphore(device, image_available_semaphores[i], nullptr);
+                vkDestroySemaphore(device, render_finished_semaphores[i], nullptr);
+                vkDestroyFence(device, in_flight_fences[i], nullptr);
+            }
+            if(graphics_timeline != VK_NULL_HANDLE)
+            {
+                vkDestroySemaphore(device, graphics_timeline, nullptr);
+                vkDestroySemaphore(device, compute_timeline, nullptr);
+            }
+            gpu_profiler.destroy();
+            culling.destroy();
+            render_graph.destroy();
+            parallel_recorder.destroy();
+            upload_manager.destroy();
+            capture.destroy();
+            if(vertex_buffer != VK_NULL_HANDLE)
+            {
+                allocator.destroyBuffer(vertex_buffer, vertex_buffer_allocation);
+            }
+            if(index_buffer != VK_NULL_HANDLE)
+            {
+                allocator.destroyBuffer(index_buffer, index_buffer_allocation);
+            }
+            if(instance_buffer != VK_NULL_HANDLE)
+            {
+                allocator.destroyBuffer(instance_buffer, instance_buffer_allocation);
+            }
+            if(indirect_buffer != VK_NULL_HANDLE)
+            {
+                allocator.destroyBuffer(indirect_buffer, indirect_buffer_allocation);
+            }
+            frame_uniforms.destroy(allocator);
+            vkDestroyDescriptorPool(device, frame_descriptor_pool, nullptr);
+            if(palette_buffer != VK_NULL_HANDLE)
+            {
+                allocator.destroyBuffer(palette_buffer, palette_buffer_allocation);
+            }
+            vkDestroyDescriptorPool(device, palette_descriptor_pool, nullptr);
+            bindless_heap.destroy();
+            vkDestroyCommandPool(device, command_pool, nullptr);
+            if(compute_command_pool != VK_NULL_HANDLE)
+            {
+                vkDestroyCommandPool(device, compute_command_pool, nullptr);
+            }
+            for(auto frame_buffer : swap_chain_frame_buffers)
+            {
+                vkDestroyFramebuffer(device, frame_buffer, nullptr);
+            }
+            if(enable_validation_layers)
+            {
+                DestroyDebugUtilsMessengerEXT(instance, debug_messenger, nullptr);
+            }
+            for(auto image_view : swap_chain_image_views)
+            {
+                vkDestroyImageView(device, image_view, nullptr);
+            }
+            shader_manager.destroy();
+            pso_cache.destroy();
+            layout_cache.destroy();
+            assets.destroy();
+            savePipelineCache();
+            vkDestroyPipelineCache(device, pipeline_cache, nullptr);
+            vkDestroyRenderPass(device, render_pass, nullptr);
+            if(headless)
+            {
+                for(size_t i = 0; i < swap_chain_images.size(); i++)
+                {
+                    allocator.destroyImage(swap_chain_images[i], offscreen_image_allocations[i]);
+                }
+            }
+            else
+            {
+                vkDestroySwapchainKHR(device, swap_chain, nullptr);
+            }
+            allocator.destroy();
+            vkDestroyDevice(device, nullptr);
+            if(surface != VK_NULL_HANDLE)
+            {
+                vkDestroySurfaceKHR(instance, surface, nullptr);
+            }
+            vkDestroyInstance(instance, nullptr);
+            if(sdl_window != nullptr)
+            {
+                SDL_DestroyWindow(sdl_window);
+            }
+       }
+        //SDL
+        SDL_Window *sdl_window;
+        //Vulkan
+        VkInstance instance;
+        std::vector<const char*> validation_layers;
+        std::vector<const char*> extensions;
+        VkDebugUtilsMessengerEXT debug_messenger;
+        bool enable_validation_layers;
+        VkPhysicalDevice physical_device;
+        QueueFamilyIndices indices;
+        // uint32_t graphics_family;
+        // uint32_t present_family;
+        VkDevice device;
+        //Sub-allocates all buffer and image memory
+        DeviceAllocator allocator;
+        VkQueue graphics_queue;
+        VkSurfaceKHR surface;
+        VkQueue present_queue;
+        std::vector<const char*> device_extensions;
+        SwapChainSupportDetails swap_chain_support;
+        VkSwapchainKHR swap_chain;
+        std::vector<VkImage> swap_chain_images;
+        VkExtent2D swap_chain_extent;
+        VkFormat swap_chain_image_format;
+        std::vector<VkImageView> swap_chain_image_views;
+        //Layout of the current pipeline variants, reflected from their shaders and owned by layout_cache.
+        //Set 0 binding 0 is the frame's uniform data at a dynamic offset, push constants are DrawData.
+        LayoutCache::Layout graphics_layout;
+        LayoutCache layout_cache;
+        VkRenderPass render_pass;
+        //Fallback pipeline, the first variant, owned by pso_cache
+        VkPipeline graphics_pipeline;
+        PipelineStateCache pso_cache;
+        //The draw list is split into this many groups, each drawn with its own pipeline variant
+        uint32_t pipeline_variant_count;
+        std::vector<PipelineStateCache::PipelineState> pipeline_variants;
+        std::vector<uint64_t> pipeline_variant_hashes;
+        AssetSpan vert_shader_code;
+        AssetSpan frag_shader_code;
+        //Recompile shaders when their sources change. The new variants replace the current ones at the
+        //start of a frame, once the new fallback has compiled.
+        bool hot_reload;
+        ShaderManager shader_manager;
+        std::vector<PipelineStateCache::PipelineState> pending_pipeline_variants;
+        std::vector<uint64_t> pending_pipeline_variant_hashes;
+        LayoutCache::Layout pending_graphics_layout;
+        //Shaders are mapped from the packed archive when one is given, otherwise from loose files
+        AssetLoader assets;
+        std::string asset_archive_path;
+        std::vector<VkFramebuffer> swap_chain_frame_buffers;
+        VkCommandPool command_pool;
+        //One command buffer and set of sync objects per frame in flight
+        std::vector<VkCommandBuffer> command_buffers;
+        std::vector<VkSemaphore> image_available_semaphores;
+        std::vector<VkSemaphore> render_finished_semaphores;
+        std::vector<VkFence> in_flight_fences;
+        //Fence of the frame currently using each swap chain image, VK_NULL_HANDLE if none
+        std::vector<VkFence> images_in_flight;
+        uint32_t max_frames_in_flight;
+        uint32_t current_frame;
+        //Headless mode renders into device-local images instead of a window's swap chain.
+        //The offscreen images are kept in swap_chain_images so the rest of the renderer doesn't care.
+        bool headless;
+        //Size of the window, or of the offscreen images when headless
+        int window_width;
+        int window_height;
+        std::vector<MemoryAllocation> offscreen_image_allocations;
+        //Pipeline cache persisted between runs, empty path disables loading and saving
+        VkPipelineCache pipeline_cache;
+        std::string pipeline_cache_path;
+        bool pipeline_cache_warm;
+        //Set on window resize or an out of date/suboptimal swap chain, handled at the start of the next frame
+        bool framebuffer_resized;
+        //Submission bookkeeping for destroying objects once the GPU is done with them
+        struct DeferredDeletion
+        {
+            uint64_t last_use = 0;
+            std::function<void()> destroy = {};
+        };
+        uint64_t submitted_frames;
+        uint64_t completed_frames;
+        std::vector<uint64_t> frame_submit_indices;
+        std::deque<DeferredDeletion> deletion_queue;
+        GpuProfiler gpu_profiler;
+        //Geometry lives in device local memory and is filled through the transfer queue
+        VkQueue transfer_queue;
+        UploadManager upload_manager;
+        VkBuffer vertex_buffer;
+        MemoryAllocation vertex_buffer_allocation;
+        VkBuffer index_buffer;
+        MemoryAllocation index_buffer_allocation;
+        //Semaphores the frame's graphics submission waits on, rebuilt every frame
+        std::vector<VkSemaphore> frame_wait_semaphores;
+        std::vector<VkPipelineStageFlags> frame_wait_stages;
+        //Timeline value per wait semaphore, ignored for binary ones
+        std::vector<uint64_t> frame_wait_values;
+        DeviceCapabilities capabilities;
+        //Objects are laid out on a grid and drawn in batches of instances_per_draw instances
+        uint32_t object_count;
+        uint32_t instances_per_draw;
+        DrawPath draw_path;
+        VkBuffer instance_buffer;
+        MemoryAllocation instance_buffer_allocation;
+        VkBuffer indirect_buffer;
+        MemoryAllocation indirect_buffer_allocation;
+        uint32_t indirect_draw_count;
+        //First instance of every batch, for rebinding the instance buffer without drawIndirectFirstInstance
+        std::vector<uint32_t> draw_first_instances;
+        //Per frame shader data is bump allocated from the current frame's segment of a persistently mapped
+        //ring and bound through one dynamic uniform buffer descriptor, so nothing is created or updated per frame
+        LinearAllocator frame_uniforms;
+        VkDescriptorPool frame_descriptor_pool;
+        VkDescriptorSetLayout frame_descriptor_set_layout;
+        VkDescriptorSet frame_descriptor_set;
+        uint32_t frame_uniform_offset;
+        //Simulation time of the frame being drawn, set by the main loop
+        float scene_time;
+        //Palettes are ranges of one storage buffer. Bindless mode registers them in the heap, which is bound
+        //once per command buffer and indexed with the slot pushed in DrawData; otherwise every palette has
+        //its own set at set 1, rebound for every draw group.
+        bool bindless;
+        BindlessHeap bindless_heap;
+        std::string vert_shader_source;
+        VkBuffer palette_buffer;
+        MemoryAllocation palette_buffer_allocation;
+        VkDeviceSize palette_stride;
+        std::vector<uint32_t> palette_slots;
+        VkDescriptorPool palette_descriptor_pool;
+        std::vector<VkDescriptorSet> palette_descriptor_sets;
+        //Accumulated since the last reset, for the draw benchmark
+        struct DrawStats
+        {
+            uint64_t frames = 0;
+            uint64_t draw_calls = 0;
+            uint64_t objects = 0;
+            double record_seconds = 0.0;
+        };
+        DrawStats draw_stats;
+        //0 records on the main thread, otherwise the draw list is split across this many workers
+        uint32_t record_threads;
+        ParallelRecorder parallel_recorder;
+        std::vector<VkCommandBuffer> secondary_command_buffers;
+        //The object grid spans [-scene_extent, scene_extent], anything past 1 is outside the view
+        float scene_extent;
+        //Cull on the GPU against the frustum and last frame's depth, and draw what survives
+        bool gpu_cull;
+        GpuCulling culling;
+        PFN_vkCmdDrawIndexedIndirectCountKHR cmd_draw_indexed_indirect_count;
+        VkFormat depth_format;
+        //Orders the frame's passes and owns the depth buffer as a transient
+        RenderGraph render_graph;
+        struct GraphResources
+        {
+            uint32_t color = 0;
+            uint32_t depth = 0;
+            uint32_t instances = 0;
+            uint32_t draws = 0;
+            uint32_t draw_count = 0;
+        };
+        GraphResources graph_resources;
+        //Swap chain image the graph is recording for, read by the pass callbacks
+        uint32_t frame_image_index;
+        //Highest version both the loader and we know about, decides how timeline semaphores are enabled
+        uint32_t instance_api_version;
+        //Cull on a compute only queue family. Frame N's cull waits for frame N-1's depth pyramid on
+        //graphics_timeline, and frame N's draws wait for the cull on compute_timeline; both count frames.
+        bool async_compute;
+        VkQueue compute_queue;
+        VkCommandPool compute_command_pool;
+        std::vector<VkCommandBuffer> compute_command_buffers;
+        //The graph passes after the depth pyramid, submitted behind the signal of graphics_timeline
+        std::vector<VkCommandBuffer> late_command_buffers;
+        uint32_t late_graph_pass;
+        VkSemaphore graphics_timeline;
+        VkSemaphore compute_timeline;
+        //Render straight into the attachments with VK_KHR_dynamic_rendering, no render pass or framebuffers
+        bool dynamic_rendering;
+        PFN_vkCmdBeginRenderingKHR cmd_begin_rendering;
+        PFN_vkCmdEndRenderingKHR cmd_end_rendering;
+        //Picks the present mode and swap chain length. With present feedback every present carries an id,
+        //and drawFrame learns which one was displayed last and when: low latency and power saving wait for
+        //the last frame to reach the screen before starting the next one, throughput only checks.
+        LatencyPolicy latency_policy;
+        //Picks the GPU by name, UUID or index instead of by score, falls back to the environment
+        std::string device_selector;
+        bool present_wait;
+        PFN_vkWaitForPresentKHR wait_for_present;
+        uint64_t present_id;
+        uint64_t presented_id;
+        std::chrono::steady_clock::time_point presented_time;
+        //Copies every frame's image out to disk, empty turns capture off
+        std::string capture_path;
+        uint32_t capture_slots;
+        FrameCapture capture;
+
+        const VkDeviceSize staging_ring_size = 8 * 1024 * 1024;
+        const uint32_t pipeline_compile_threads = 2;
+        const VkDeviceSize uniform_ring_size = 64 * 1024;
+        const float frame_pulse = 0.25f;
+        //Slots per heap binding, clamped to the device's update after bind limits
+        const uint32_t bindless_capacity = 4096;
+        //Long enough for a 1 Hz display, a lost present doesn't hang the frame
+        const uint64_t present_wait_timeout = 1000000000;
+        const char* const device_selector_variable = "VULKAN_INTRO_DEVICE";
+
+        bool initAndCreateSDLWindow();
+        bool createInstance(bool, std::vector<const char*>, const std::vector<const char*>);
+        bool setupDebugMessenger();
+        bool enableValidationLayer();
+        bool createInstance();
+        bool queryExtensions();
+        bool initVulkan();
+        bool pickPhysicalDevice();
+        void printCapabilityReport() const;
+        bool isDeviceSuitable(VkPhysicalDevice);
+        bool findQueueFamilies();
+        bool createLogicalDevice();
+        bool createSurface();
+        bool checkDeviceExtensionSupport(VkPhysicalDevice);
+        SwapChainSupportDetails querySwapChainSupport(VkPhysicalDevice);
+        VkExtent2D chooseSwapExtent(const VkSurfaceCapabilitiesKHR&);
+        bool createSwapChain();
+        bool recreateSwapChain();
+        void deferDestroy(std::function<void()>);
+        void collectRetiredObjects();
+        bool createOffscreenTargets();
+        bool createImageViews();
+        bool findDepthFormat();
+        bool buildRenderGraph();
+        bool createPipelineCache();
+        bool savePipelineCache();
+        bool createGraphicsPipeline();
+        bool buildPipelineVariants(std::vector<PipelineStateCache::PipelineState>*, std::vector<uint64_t>*, LayoutCache::Layout*);
+        void updateShaders();
+        void retirePipeline(uint64_t);
+        bool createRenderPass();
+        bool createFrameBuffers();
+        bool createCommandPool();
+        bool createCommandBuffers();
+        bool createGeometryBuffers();
+        bool createObjectBuffers();
+        bool createFrameUniforms();
+        bool createPalettes();
+        bool writeFrameUniforms();
+        bool drawPathSupported(DrawPath) const;
+        bool recordCommandBuffer(VkCommandBuffer, uint32_t);
+        void beginRendering(VkCommandBuffer, bool);
+        void endRendering(VkCommandBuffer);
+        bool recordObjectsPass(VkCommandBuffer);
+        uint32_t drawListSize() const;
+        uint32_t recordDraws(VkCommandBuffer, uint32_t, uint32_t);
+        uint32_t recordDrawRange(VkCommandBuffer, uint32_t, uint32_t);
+        bool drawFrame();
+        void waitForPresents();
+        bool submitAsyncCompute();
+        bool createSyncObjects();
+
+};
@@ -0,0 +1,263 @@
+#include "shader_manager.h"
+#include "pipeline_state_cache.h"
+
+#include <iostream>
+#include <fstream>
+#include <iterator>
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <cstdio>
+#include <cstdlib> // Necessary for std::system
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <poll.h>
+#include <unistd.h>
+#endif
+
+ShaderManager::ShaderManager()
+{
+    source_directory = {};
+    cache_directory = {};
+    inotify_fd = -1;
+    stopping = false;
+    source_hashes = {};
+    updates = {};
+    stats = {};
+}
+
+ShaderManager::~ShaderManager()
+{
+    destroy();
+}
+
+bool ShaderManager::init(const std::string& source_dir, const std::vector<std::string>& sources, const std::string& cache_dir)
+{
+#ifdef __linux__
+    source_directory = source_dir;
+    cache_directory = cache_dir;
+
+    std::error_code error = {};
+    std::filesystem::create_directories(cache_directory, error);
+    if(error)
+    {
+        std::cout << "Failed to create shader cache directory " << cache_directory << "!" << std::endl;
+        return false;
+    }
+
+    //Remember what the sources look like now, so only real edits trigger a compile
+    for(const auto& source : sources)
+    {
+        std::vector<char> text = {};
+        uint64_t hash = 0;
+        readSource(source, &text, &hash);
+        source_hashes[source] = hash;
+    }
+
+    inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if(inotify_fd < 0)
+    {
+        std::cout << "Failed to create inotify instance!" << std::endl;
+        return false;
+    }
+    //Editors either write the file in place or rename a temporary file over it
+    if(inotify_add_watch(inotify_fd, source_directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0)
+    {
+        std::cout << "Failed to watch shader directory " << source_directory << "!" << std::endl;
+        close(inotify_fd);
+        inotify_fd = -1;
+        return false;
+    }
+
+    stopping = false;
+    watcher = std::thread(&ShaderManager::watchLoop, this);
+    return true;
+#else
+    (void) source_dir;
+    (void) sources;
+    (void) cache_dir;
+    std::cout << "Shader hot reload needs inotify, which is Linux only" << std::endl;
+    return false;
+#endif
+}
+
+void ShaderManager::destroy()
+{
+    stopping = true;
+    if(watcher.joinable())
+    {
+        watcher.join();
+    }
+#ifdef __linux__
+    if(inotify_fd >= 0)
+    {
+        close(inotify_fd);
+        inotify_fd = -1;
+    }
+#endif
+}
+
+std::vector<ShaderManager::Update> ShaderManager::takeUpdates()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    std::vector<Update> taken = std::move(updates);
+    updates.clear();
+    return taken;
+}
+
+void ShaderManager::printStats()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    double average_ms = stats.compiles > 0 ? stats.compile_ms / stats.compiles : 0.0;
+    std::cout << "Shader reloads: " << stats.changes << " source changes, " << stats.compiles << " compiled ("
+        << average_ms << " ms average), " << stats.cache_hits << " SPIR-V cache hits, " << stats.failures
+        << " failed" << std::endl;
+}
+
+void ShaderManager::watchLoop()
+{
+#ifdef __linux__
+    alignas(inotify_event) char buffer[4096];
+    while(!stopping)
+    {
+        //Wake up now and then to notice destroy()
+        pollfd descriptor = {};
+        descriptor.fd = inotify_fd;
+        descriptor.events = POLLIN;
+        if(poll(&descriptor, 1, 100) <= 0)
+        {
+            continue;
+        }
+        ssize_t length = read(inotify_fd, buffer, sizeof(buffer));
+        if(length <= 0)
+        {
+            continue;
+        }
+
+        //One save can produce several events, compile every changed file once
+        std::vector<std::string> changed = {};
+        for(ssize_t offset = 0; offset < length;)
+        {
+            const inotify_event* event = reinterpret_cast<const inotify_event*>(buffer + offset);
+            offset += sizeof(inotify_event) + event->len;
+            if(event->len == 0)
+            {
+                continue;
+            }
+            std::string name = event->name;
+            if(source_hashes.count(name) != 0 && std::find(changed.begin(), changed.end(), name) == changed.end())
+            {
+                changed.push_back(name);
+            }
+        }
+
+        for(const auto& name : changed)
+        {
+            AssetSpan code = {};
+            if(!compileSource(name, &code))
+            {
+                continue;
+            }
+            std::lock_guard<std::mutex> lock(mutex);
+            auto existing = std::find_if(updates.begin(), updates.end(), [&name](const Update& update) { return update.source == name; });
+            if(existing != updates.end())
+            {
+                existing->code = code;
+            }
+            else
+            {
+                Update update = {};
+                update.source = name;
+                update.code = code;
+                updates.push_back(update);
+            }
+        }
+    }
+#endif
+}
+
+bool ShaderManager::readSource(const std::string& name, std::vector<char>* text, uint64_t* hash) const
+{
+    std::ifstream file(source_directory + "/" + name, std::ios::binary);
+    if(!file.is_open())
+    {
+        return false;
+    }
+    text->assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+
+    //glslc picks the stage from the file name, so it is part of the key
+    std::vector<char> key(name.begin(), name.end());
+    key.push_back('\0');
+    key.insert(key.end(), text->begin(), text->end());
+    *hash = PipelineStateCache::hashCode(key.data(), key.size());
+    return true;
+}
+
+bool ShaderManager::compileSource(const std::string& name, AssetSpan* code)
+{
+    std::vector<char> text = {};
+    uint64_t hash = 0;
+    //Saved without changes, or gone for a moment while the editor replaces it
+    if(!readSource(name, &text, &hash) || source_hashes[name] == hash)
+    {
+        return false;
+    }
+    //A broken version isn't retried until it changes again
+    source_hashes[name] = hash;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stats.changes++;
+    }
+
+    char hash_name[17] = {};
+    snprintf(hash_name, sizeof(hash_name), "%016llx", static_cast<unsigned long long>(hash));
+    std::string spirv_path = cache_directory + "/" + hash_name + ".spv";
+    if(std::filesystem::exists(spirv_path))
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stats.cache_hits++;
+    }
+    else
+    {
+        //Compile next to the cache entry and rename it into place, a half written file is never a hit
+        std::string source_path = source_directory + "/" + name;
+        std::string temporary_path = spirv_path + ".tmp";
+        std::string command = "glslc \"" + source_path + "\" -o \"" + temporary_path + "\"";
+        auto compile_start = std::chrono::steady_clock::now();
+        int status = std::system(command.c_str());
+        double compile_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - compile_start).count();
+
+        std::error_code error = {};
+        if(status == 0)
+        {
+            std::filesystem::rename(temporary_path, spirv_path, error);
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        if(status != 0 || error)
+        {
+            std::cout << "Failed to compile " << source_path << ", keeping the previous version" << std::endl;
+            stats.failures++;
+            return false;
+        }
+        stats.compiles++;
+        stats.compile_ms += compile_ms;
+    }
+
+    std::ifstream file(spirv_path, std::ios::binary);
+    if(!file.is_open())
+    {
+        std::cout << "Failed to read " << spirv_path << "!" << std::endl;
+        return false;
+    }
+    auto spirv = std::make_shared<std::vector<char>>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    //SPIR-V is a stream of 32 bit words
+    if(spirv->empty() || spirv->size() % 4 != 0)
+    {
+        std::cout << "Cached SPIR-V " << spirv_path << " is corrupt!" << std::endl;
+        return false;
+    }
+    code->data = spirv->data();
+    code->size = spirv->size();
+    code->owner = spirv;
+    return true;
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <unordered_map>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <cstdint>
+
+#include "asset_loader.h"
+
+//Watches GLSL sources with inotify and recompiles them with glslc when they are saved. SPIR-V is cached
+//on disk by a hash of the source, so going back to an earlier version of a shader doesn't compile again.
+//Compiles run on the watcher thread, the render thread picks the results up between frames.
+//Only the watched files are hashed, #includes aren't tracked.
+class ShaderManager
+{
+    public:
+        struct Update
+        {
+            //File name inside the source directory
+            std::string source = {};
+            //Owns its memory, the SPIR-V is read rather than mapped since the file can be replaced again
+            AssetSpan code = {};
+        };
+
+        struct Stats
+        {
+            uint64_t changes = 0;
+            uint64_t compiles = 0;
+            uint64_t cache_hits = 0;
+            uint64_t failures = 0;
+            double compile_ms = 0.0;
+        };
+
+        ShaderManager();
+        ~ShaderManager();
+
+        //Watches the given sources in source_directory, SPIR-V is cached in cache_directory
+        bool init(const std::string&, const std::vector<std::string>&, const std::string&);
+        void destroy();
+
+        //Sources recompiled since the last call, only the newest version of each
+        std::vector<Update> takeUpdates();
+        void printStats();
+
+    private:
+        void watchLoop();
+        bool readSource(const std::string&, std::vector<char>*, uint64_t*) const;
+        bool compileSource(const std::string&, AssetSpan*);
+
+        std::string source_directory;
+        std::string cache_directory;
+        int inotify_fd;
+        std::thread watcher;
+        std::atomic<bool> stopping;
+        //Watcher thread only: hash of the source each file was last compiled from
+        std::unordered_map<std::string, uint64_t> source_hashes;
+        //Guards updates and stats
+        std::mutex mutex;
+        std::vector<Update> updates;
+        Stats stats;
+};
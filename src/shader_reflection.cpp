@@ -0,0 +1,685 @@
+#include "shader_reflection.h"
+#include "pipeline_state_cache.h"
+
+#include <iostream>
+#include <algorithm>
+#include <map>
+
+namespace
+{
+    //The parts of the SPIR-V specification reflection looks at
+    const uint32_t spirv_magic = 0x07230203;
+    const uint32_t no_value = ~0u;
+    enum SpirvOp : uint32_t
+    {
+        OpEntryPoint = 15,
+        OpTypeInt = 21,
+        OpTypeFloat = 22,
+        OpTypeVector = 23,
+        OpTypeMatrix = 24,
+        OpTypeImage = 25,
+        OpTypeSampler = 26,
+        OpTypeSampledImage = 27,
+        OpTypeArray = 28,
+        OpTypeRuntimeArray = 29,
+        OpTypeStruct = 30,
+        OpTypePointer = 32,
+        OpConstant = 43,
+        OpSpecConstant = 50,
+        OpVariable = 59,
+        OpDecorate = 71,
+        OpMemberDecorate = 72
+    };
+    enum SpirvDecoration : uint32_t
+    {
+        DecorationBlock = 2,
+        DecorationBufferBlock = 3,
+        DecorationArrayStride = 6,
+        DecorationMatrixStride = 7,
+        DecorationBuiltIn = 11,
+        DecorationLocation = 30,
+        DecorationBinding = 33,
+        DecorationDescriptorSet = 34,
+        DecorationOffset = 35
+    };
+    enum SpirvStorageClass : uint32_t
+    {
+        StorageUniformConstant = 0,
+        StorageInput = 1,
+        StorageUniform = 2,
+        StoragePushConstant = 9,
+        StorageStorageBuffer = 12
+    };
+    const uint32_t image_dim_buffer = 5;
+    const uint32_t image_dim_subpass_data = 6;
+
+    //Everything known about one result id
+    struct SpirvId
+    {
+        uint32_t opcode = 0;
+        //For constants and variables
+        uint32_t result_type = 0;
+        //Operands after the result id
+        const uint32_t* operands = nullptr;
+        uint32_t operand_count = 0;
+        uint32_t set = no_value;
+        uint32_t binding = no_value;
+        uint32_t location = no_value;
+        uint32_t array_stride = 0;
+        bool builtin = false;
+        bool block = false;
+        bool buffer_block = false;
+        std::vector<uint32_t> member_offsets = {};
+        std::vector<uint32_t> member_matrix_strides = {};
+    };
+
+    struct SpirvModule
+    {
+        std::vector<SpirvId> ids = {};
+        uint32_t execution_model = no_value;
+        std::vector<uint32_t> variables = {};
+
+        const SpirvId* get(uint32_t id) const
+        {
+            return id < ids.size() && ids[id].opcode != 0 ? &ids[id] : nullptr;
+        }
+    };
+
+    void setMember(std::vector<uint32_t>* members, uint32_t member, uint32_t value)
+    {
+        //An instruction has at most 0xffff words, so no struct has more members than that
+        if(member >= members->size())
+        {
+            members->resize(member + 1, 0);
+        }
+        (*members)[member] = value;
+    }
+
+    bool parseModule(const uint32_t* words, size_t word_count, SpirvModule* module)
+    {
+        if(word_count < 5 || words[0] != spirv_magic)
+        {
+            return false;
+        }
+        //Every id is below the bound, a module claiming more ids than it has words is broken
+        uint32_t bound = words[3];
+        if(bound > word_count)
+        {
+            return false;
+        }
+        module->ids.resize(bound);
+
+        for(size_t i = 5; i < word_count;)
+        {
+            uint32_t length = words[i] >> 16;
+            uint32_t opcode = words[i] & 0xffff;
+            if(length == 0 || i + length > word_count)
+            {
+                return false;
+            }
+            const uint32_t* operands = words + i + 1;
+            uint32_t operand_count = length - 1;
+            i += length;
+
+            //Result id first for types, result type then result id for constants and variables
+            uint32_t result_index = no_value;
+            switch(opcode)
+            {
+                case OpEntryPoint:
+                    if(operand_count >= 1 && module->execution_model == no_value)
+                    {
+                        module->execution_model = operands[0];
+                    }
+                    break;
+                case OpTypeInt:
+                case OpTypeFloat:
+                case OpTypeVector:
+                case OpTypeMatrix:
+                case OpTypeImage:
+                case OpTypeSampler:
+                case OpTypeSampledImage:
+                case OpTypeArray:
+                case OpTypeRuntimeArray:
+                case OpTypeStruct:
+                case OpTypePointer:
+                    result_index = 0;
+                    break;
+                case OpConstant:
+                case OpSpecConstant:
+                case OpVariable:
+                    result_index = 1;
+                    break;
+                case OpDecorate:
+                    if(operand_count >= 2 && operands[0] < bound)
+                    {
+                        SpirvId& target = module->ids[operands[0]];
+                        uint32_t value = operand_count >= 3 ? operands[2] : 0;
+                        switch(operands[1])
+                        {
+                            case DecorationBlock: target.block = true; break;
+                            case DecorationBufferBlock: target.buffer_block = true; break;
+                            case DecorationArrayStride: target.array_stride = value; break;
+                            case DecorationBuiltIn: target.builtin = true; break;
+                            case DecorationLocation: target.location = value; break;
+                            case DecorationBinding: target.binding = value; break;
+                            case DecorationDescriptorSet: target.set = value; break;
+                        }
+                    }
+                    break;
+                case OpMemberDecorate:
+                    if(operand_count >= 3 && operands[0] < bound)
+                    {
+                        SpirvId& target = module->ids[operands[0]];
+                        if(operands[2] == DecorationBuiltIn)
+                        {
+                            target.builtin = true;
+                        }
+                        else if(operand_count >= 4 && operands[2] == DecorationOffset && operands[1] < 0xffff)
+                        {
+                            setMember(&target.member_offsets, operands[1], operands[3]);
+                        }
+                        else if(operand_count >= 4 && operands[2] == DecorationMatrixStride && operands[1] < 0xffff)
+                        {
+                            setMember(&target.member_matrix_strides, operands[1], operands[3]);
+                        }
+                    }
+                    break;
+            }
+
+            if(result_index != no_value)
+            {
+                if(operand_count <= result_index || operands[result_index] >= bound)
+                {
+                    return false;
+                }
+                SpirvId& id = module->ids[operands[result_index]];
+                id.opcode = opcode;
+                id.result_type = result_index == 1 ? operands[0] : 0;
+                id.operands = operands + result_index + 1;
+                id.operand_count = operand_count - result_index - 1;
+                if(opcode == OpVariable)
+                {
+                    module->variables.push_back(operands[result_index]);
+                }
+            }
+        }
+        return module->execution_model != no_value;
+    }
+
+    //Element count of an array type, 0 for runtime sized arrays
+    uint32_t arrayLength(const SpirvModule& module, const SpirvId& array)
+    {
+        if(array.opcode != OpTypeArray || array.operand_count < 2)
+        {
+            return 0;
+        }
+        const SpirvId* length = module.get(array.operands[1]);
+        if(length == nullptr || (length->opcode != OpConstant && length->opcode != OpSpecConstant) || length->operand_count < 1)
+        {
+            return 0;
+        }
+        return length->operands[0];
+    }
+
+    //Size in bytes as laid out in a block, for push constant ranges
+    uint32_t typeSize(const SpirvModule& module, uint32_t type, uint32_t matrix_stride, uint32_t depth)
+    {
+        const SpirvId* id = module.get(type);
+        if(id == nullptr || depth > 16)
+        {
+            return 0;
+        }
+        switch(id->opcode)
+        {
+            case OpTypeInt:
+            case OpTypeFloat:
+                return id->operand_count >= 1 ? id->operands[0] / 8 : 0;
+            case OpTypeVector:
+                return id->operand_count >= 2 ? id->operands[1] * typeSize(module, id->operands[0], 0, depth + 1) : 0;
+            case OpTypeMatrix:
+                if(id->operand_count < 2)
+                {
+                    return 0;
+                }
+                return id->operands[1] * (matrix_stride != 0 ? matrix_stride : typeSize(module, id->operands[0], 0, depth + 1));
+            case OpTypeArray:
+                return arrayLength(module, *id) * id->array_stride;
+            case OpTypeStruct:
+            {
+                uint32_t size = 0;
+                for(uint32_t member = 0; member < id->operand_count; member++)
+                {
+                    uint32_t offset = member < id->member_offsets.size() ? id->member_offsets[member] : 0;
+                    uint32_t stride = member < id->member_matrix_strides.size() ? id->member_matrix_strides[member] : 0;
+                    size = std::max(size, offset + typeSize(module, id->operands[member], stride, depth + 1));
+                }
+                return size;
+            }
+        }
+        return 0;
+    }
+
+    bool inputFormat(const SpirvModule& module, uint32_t type, VkFormat* format, uint32_t* size)
+    {
+        const SpirvId* id = module.get(type);
+        if(id == nullptr)
+        {
+            return false;
+        }
+        uint32_t components = 1;
+        if(id->opcode == OpTypeVector && id->operand_count >= 2)
+        {
+            components = id->operands[1];
+            id = module.get(id->operands[0]);
+        }
+        if(id == nullptr || id->operand_count < 1 || id->operands[0] != 32 || components < 1 || components > 4)
+        {
+            return false;
+        }
+
+        const VkFormat float_formats[] = {VK_FORMAT_R32_SFLOAT, VK_FORMAT_R32G32_SFLOAT, VK_FORMAT_R32G32B32_SFLOAT, VK_FORMAT_R32G32B32A32_SFLOAT};
+        const VkFormat sint_formats[] = {VK_FORMAT_R32_SINT, VK_FORMAT_R32G32_SINT, VK_FORMAT_R32G32B32_SINT, VK_FORMAT_R32G32B32A32_SINT};
+        const VkFormat uint_formats[] = {VK_FORMAT_R32_UINT, VK_FORMAT_R32G32_UINT, VK_FORMAT_R32G32B32_UINT, VK_FORMAT_R32G32B32A32_UINT};
+        if(id->opcode == OpTypeFloat)
+        {
+            *format = float_formats[components - 1];
+        }
+        else if(id->opcode == OpTypeInt && id->operand_count >= 2)
+        {
+            *format = id->operands[1] != 0 ? sint_formats[components - 1] : uint_formats[components - 1];
+        }
+        else
+        {
+            return false;
+        }
+        *size = components * 4;
+        return true;
+    }
+
+    bool descriptorType(uint32_t storage_class, const SpirvId& type, VkDescriptorType* descriptor_type)
+    {
+        if(storage_class == StorageStorageBuffer)
+        {
+            *descriptor_type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            return true;
+        }
+        if(storage_class == StorageUniform)
+        {
+            *descriptor_type = type.buffer_block ? VK_DESCRIPTOR_TYPE_STORAGE_BUFFER : VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+            return true;
+        }
+        switch(type.opcode)
+        {
+            case OpTypeSampler:
+                *descriptor_type = VK_DESCRIPTOR_TYPE_SAMPLER;
+                return true;
+            case OpTypeSampledImage:
+                *descriptor_type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+                return true;
+            case OpTypeImage:
+            {
+                if(type.operand_count < 6)
+                {
+                    return false;
+                }
+                //Sampled is 2 for images only used with load and store
+                bool storage = type.operands[5] == 2;
+                if(type.operands[1] == image_dim_buffer)
+                {
+                    *descriptor_type = storage ? VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER : VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER;
+                }
+                else if(type.operands[1] == image_dim_subpass_data)
+                {
+                    *descriptor_type = VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+                }
+                else
+                {
+                    *descriptor_type = storage ? VK_DESCRIPTOR_TYPE_STORAGE_IMAGE : VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+                }
+                return true;
+            }
+        }
+        return false;
+    }
+}
+
+bool ShaderReflection::reflect(const AssetSpan& code, ShaderReflection* reflection)
+{
+    *reflection = {};
+    SpirvModule module = {};
+    if(code.size % 4 != 0 || !parseModule(code.words(), code.size / 4, &module))
+    {
+        std::cout << "Failed to parse SPIR-V module!" << std::endl;
+        return false;
+    }
+
+    const VkShaderStageFlagBits stages[] = {VK_SHADER_STAGE_VERTEX_BIT, VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT,
+        VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT, VK_SHADER_STAGE_GEOMETRY_BIT, VK_SHADER_STAGE_FRAGMENT_BIT, VK_SHADER_STAGE_COMPUTE_BIT};
+    if(module.execution_model >= sizeof(stages) / sizeof(stages[0]))
+    {
+        std::cout << "Unsupported SPIR-V execution model " << module.execution_model << "!" << std::endl;
+        return false;
+    }
+    reflection->stage = stages[module.execution_model];
+
+    for(uint32_t variable_id : module.variables)
+    {
+        const SpirvId& variable = module.ids[variable_id];
+        const SpirvId* pointer = module.get(variable.result_type);
+        const SpirvId* type = pointer != nullptr && pointer->opcode == OpTypePointer && pointer->operand_count >= 2
+            ? module.get(pointer->operands[1]) : nullptr;
+        if(type == nullptr || variable.operand_count < 1)
+        {
+            continue;
+        }
+        uint32_t storage_class = variable.operands[0];
+
+        if(storage_class == StorageInput)
+        {
+            //Built-ins and block inputs of later stages aren't fed from vertex buffers
+            if(reflection->stage != VK_SHADER_STAGE_VERTEX_BIT || variable.builtin || type->builtin || variable.location == no_value)
+            {
+                continue;
+            }
+            uint32_t columns = 1;
+            uint32_t column_type = pointer->operands[1];
+            if(type->opcode == OpTypeMatrix && type->operand_count >= 2)
+            {
+                columns = type->operands[1];
+                column_type = type->operands[0];
+            }
+            Input input = {};
+            if(!inputFormat(module, column_type, &input.format, &input.size))
+            {
+                std::cout << "Unsupported type for vertex input " << variable.location << "!" << std::endl;
+                return false;
+            }
+            for(uint32_t column = 0; column < columns; column++)
+            {
+                input.location = variable.location + column;
+                reflection->inputs.push_back(input);
+            }
+        }
+        else if(storage_class == StoragePushConstant)
+        {
+            uint32_t offset = type->member_offsets.empty() ? 0 : *std::min_element(type->member_offsets.begin(), type->member_offsets.end());
+            reflection->push_constants.stageFlags = reflection->stage;
+            reflection->push_constants.offset = offset;
+            reflection->push_constants.size = typeSize(module, pointer->operands[1], 0, 0) - offset;
+        }
+        else if(storage_class == StorageUniformConstant || storage_class == StorageUniform || storage_class == StorageStorageBuffer)
+        {
+            Binding binding = {};
+            binding.set = variable.set != no_value ? variable.set : 0;
+            binding.binding = variable.binding != no_value ? variable.binding : 0;
+            if(type->opcode == OpTypeArray || type->opcode == OpTypeRuntimeArray)
+            {
+                binding.count = arrayLength(module, *type);
+                type = type->operand_count >= 1 ? module.get(type->operands[0]) : nullptr;
+            }
+            if(type == nullptr || !descriptorType(storage_class, *type, &binding.type))
+            {
+                std::cout << "Unsupported type for descriptor set " << binding.set << " binding " << binding.binding << "!" << std::endl;
+                return false;
+            }
+            reflection->bindings.push_back(binding);
+        }
+    }
+
+    std::sort(reflection->inputs.begin(), reflection->inputs.end(), [](const Input& a, const Input& b) { return a.location < b.location; });
+    return true;
+}
+
+void ShaderReflection::makeDynamic(uint32_t set, uint32_t binding)
+{
+    for(auto& reflected : bindings)
+    {
+        if(reflected.set != set || reflected.binding != binding)
+        {
+            continue;
+        }
+        if(reflected.type == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER)
+        {
+            reflected.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+        }
+        else if(reflected.type == VK_DESCRIPTOR_TYPE_STORAGE_BUFFER)
+        {
+            reflected.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+        }
+    }
+}
+
+bool ShaderReflection::buildVertexInput(const std::vector<VertexStream>& streams, std::vector<VkVertexInputBindingDescription>* bindings,
+    std::vector<VkVertexInputAttributeDescription>* attributes) const
+{
+    bindings->clear();
+    attributes->clear();
+    for(size_t i = 0; i < streams.size(); i++)
+    {
+        uint32_t end_location = i + 1 < streams.size() ? streams[i + 1].first_location : ~0u;
+        VkVertexInputBindingDescription binding = {};
+        binding.binding = streams[i].binding;
+        binding.inputRate = streams[i].input_rate;
+        for(const auto& input : inputs)
+        {
+            if(input.location < streams[i].first_location || input.location >= end_location)
+            {
+                continue;
+            }
+            VkVertexInputAttributeDescription attribute = {};
+            attribute.binding = binding.binding;
+            attribute.location = input.location;
+            attribute.format = input.format;
+            attribute.offset = binding.stride;
+            attributes->push_back(attribute);
+            binding.stride += input.size;
+        }
+        bindings->push_back(binding);
+    }
+    if(!inputs.empty() && (streams.empty() || inputs.front().location < streams.front().first_location))
+    {
+        std::cout << "Vertex input " << inputs.front().location << " isn't fed by any vertex buffer!" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+LayoutCache::LayoutCache()
+{
+    device = VK_NULL_HANDLE;
+    set_layouts = {};
+    pipeline_layouts = {};
+    stats = {};
+}
+
+LayoutCache::~LayoutCache()
+{
+    destroy();
+}
+
+void LayoutCache::init(VkDevice logical_device)
+{
+    device = logical_device;
+}
+
+void LayoutCache::destroy()
+{
+    for(auto& entry : pipeline_layouts)
+    {
+        vkDestroyPipelineLayout(device, entry.second.layout, nullptr);
+    }
+    pipeline_layouts.clear();
+    for(auto& entry : set_layouts)
+    {
+        vkDestroyDescriptorSetLayout(device, entry.second.layout, nullptr);
+    }
+    set_layouts.clear();
+}
+
+bool LayoutCache::getLayout(const std::vector<const ShaderReflection*>& stages, Layout* layout,
+    const std::vector<VkDescriptorSetLayout>& external_set_layouts)
+{
+    *layout = {};
+
+    //Bindings by set, then binding number
+    std::map<uint32_t, std::map<uint32_t, VkDescriptorSetLayoutBinding>> sets = {};
+    uint32_t push_end = 0;
+    for(const ShaderReflection* stage : stages)
+    {
+        for(const auto& binding : stage->bindings)
+        {
+            if(binding.set < external_set_layouts.size() && external_set_layouts[binding.set] != VK_NULL_HANDLE)
+            {
+                continue;
+            }
+            if(binding.count == 0)
+            {
+                std::cout << "Runtime sized descriptor arrays need a set layout from the caller (set " << binding.set << " binding " << binding.binding << ")!" << std::endl;
+                return false;
+            }
+            auto& set = sets[binding.set];
+            auto existing = set.find(binding.binding);
+            if(existing == set.end())
+            {
+                VkDescriptorSetLayoutBinding layout_binding = {};
+                layout_binding.binding = binding.binding;
+                layout_binding.descriptorType = binding.type;
+                layout_binding.descriptorCount = binding.count;
+                layout_binding.stageFlags = stage->stage;
+                set[binding.binding] = layout_binding;
+            }
+            else if(existing->second.descriptorType != binding.type || existing->second.descriptorCount != binding.count)
+            {
+                std::cout << "Shader stages disagree on descriptor set " << binding.set << " binding " << binding.binding << "!" << std::endl;
+                return false;
+            }
+            else
+            {
+                existing->second.stageFlags |= stage->stage;
+            }
+        }
+
+        //One range covering every stage's block, so one vkCmdPushConstants call updates all of them
+        if(stage->push_constants.size > 0)
+        {
+            if(layout->push_constants.stageFlags == 0 || stage->push_constants.offset < layout->push_constants.offset)
+            {
+                layout->push_constants.offset = stage->push_constants.offset;
+            }
+            layout->push_constants.stageFlags |= stage->push_constants.stageFlags;
+            push_end = std::max(push_end, stage->push_constants.offset + stage->push_constants.size);
+        }
+    }
+    if(layout->push_constants.stageFlags != 0)
+    {
+        layout->push_constants.size = push_end - layout->push_constants.offset;
+    }
+
+    uint32_t set_count = sets.empty() ? 0 : sets.rbegin()->first + 1;
+    for(uint32_t set = 0; set < external_set_layouts.size(); set++)
+    {
+        if(external_set_layouts[set] != VK_NULL_HANDLE)
+        {
+            set_count = std::max(set_count, set + 1);
+        }
+    }
+    for(uint32_t set = 0; set < set_count; set++)
+    {
+        if(set < external_set_layouts.size() && external_set_layouts[set] != VK_NULL_HANDLE)
+        {
+            layout->set_layouts.push_back(external_set_layouts[set]);
+            continue;
+        }
+        std::vector<VkDescriptorSetLayoutBinding> bindings = {};
+        auto found = sets.find(set);
+        if(found != sets.end())
+        {
+            for(const auto& binding : found->second)
+            {
+                bindings.push_back(binding.second);
+            }
+        }
+        VkDescriptorSetLayout set_layout = VK_NULL_HANDLE;
+        if(!getSetLayout(bindings, &set_layout))
+        {
+            return false;
+        }
+        layout->set_layouts.push_back(set_layout);
+    }
+
+    uint64_t hash = PipelineStateCache::hashCode(reinterpret_cast<const char*>(layout->set_layouts.data()),
+        layout->set_layouts.size() * sizeof(VkDescriptorSetLayout));
+    hash ^= PipelineStateCache::hashCode(reinterpret_cast<const char*>(&layout->push_constants), sizeof(layout->push_constants)) * 31;
+    auto range = pipeline_layouts.equal_range(hash);
+    for(auto entry = range.first; entry != range.second; entry++)
+    {
+        const VkPushConstantRange& push = entry->second.push_constants;
+        if(entry->second.set_layouts == layout->set_layouts && push.stageFlags == layout->push_constants.stageFlags
+            && push.offset == layout->push_constants.offset && push.size == layout->push_constants.size)
+        {
+            layout->pipeline_layout = entry->second.layout;
+            stats.hits++;
+            return true;
+        }
+    }
+
+    VkPipelineLayoutCreateInfo pipeline_layout_info = {};
+    pipeline_layout_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipeline_layout_info.setLayoutCount = static_cast<uint32_t>(layout->set_layouts.size());
+    pipeline_layout_info.pSetLayouts = layout->set_layouts.data();
+    pipeline_layout_info.pushConstantRangeCount = layout->push_constants.size > 0 ? 1 : 0;
+    pipeline_layout_info.pPushConstantRanges = &layout->push_constants;
+    if(vkCreatePipelineLayout(device, &pipeline_layout_info, nullptr, &layout->pipeline_layout) != VK_SUCCESS)
+    {
+        std::cout << "Failed to create pipeline layout!" << std::endl;
+        return false;
+    }
+    PipelineLayoutEntry entry = {};
+    entry.set_layouts = layout->set_layouts;
+    entry.push_constants = layout->push_constants;
+    entry.layout = layout->pipeline_layout;
+    pipeline_layouts.emplace(hash, entry);
+    stats.pipeline_layouts++;
+    return true;
+}
+
+void LayoutCache::printStats() const
+{
+    std::cout << "Layouts: " << stats.pipeline_layouts << " pipeline layouts and " << stats.set_layouts
+        << " descriptor set layouts created, " << stats.hits << " shared" << std::endl;
+}
+
+bool LayoutCache::getSetLayout(const std::vector<VkDescriptorSetLayoutBinding>& bindings, VkDescriptorSetLayout* set_layout)
+{
+    std::vector<uint32_t> key = {};
+    for(const auto& binding : bindings)
+    {
+        key.insert(key.end(), {binding.binding, static_cast<uint32_t>(binding.descriptorType), binding.descriptorCount, binding.stageFlags});
+    }
+    uint64_t hash = PipelineStateCache::hashCode(reinterpret_cast<const char*>(key.data()), key.size() * sizeof(uint32_t));
+    auto range = set_layouts.equal_range(hash);
+    for(auto entry = range.first; entry != range.second; entry++)
+    {
+        if(entry->second.key == key)
+        {
+            *set_layout = entry->second.layout;
+            return true;
+        }
+    }
+
+    VkDescriptorSetLayoutCreateInfo layout_info = {};
+    layout_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layout_info.bindingCount = static_cast<uint32_t>(bindings.size());
+    layout_info.pBindings = bindings.data();
+    if(vkCreateDescriptorSetLayout(device, &layout_info, nullptr, set_layout) != VK_SUCCESS)
+    {
+        std::cout << "Failed to create descriptor set layout!" << std::endl;
+        return false;
+    }
+    SetLayoutEntry entry = {};
+    entry.key = std::move(key);
+    entry.layout = *set_layout;
+    set_layouts.emplace(hash, entry);
+    stats.set_layouts++;
+    return true;
+}
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+#include <vulkan/vulkan.h>
+
+#include "asset_loader.h"
+
+//What a SPIR-V module declares to the outside: descriptor bindings, its push constant block and, for
+//vertex shaders, the vertex inputs. Read straight from the module's instructions, without SPIRV-Cross.
+struct ShaderReflection
+{
+    struct Binding
+    {
+        uint32_t set = 0;
+        uint32_t binding = 0;
+        VkDescriptorType type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+        //0 for a runtime sized array
+        uint32_t count = 1;
+    };
+    struct Input
+    {
+        uint32_t location = 0;
+        VkFormat format = VK_FORMAT_UNDEFINED;
+        uint32_t size = 0;
+    };
+    //A vertex buffer binding. It takes the inputs from first_location up to the next stream's first_location,
+    //packed tightly in location order.
+    struct VertexStream
+    {
+        uint32_t binding = 0;
+        VkVertexInputRate input_rate = VK_VERTEX_INPUT_RATE_VERTEX;
+        uint32_t first_location = 0;
+    };
+
+    VkShaderStageFlagBits stage = VK_SHADER_STAGE_VERTEX_BIT;
+    std::vector<Binding> bindings = {};
+    //size is 0 without a push constant block
+    VkPushConstantRange push_constants = {};
+    //Sorted by location, built-ins left out. Matrices take one location per column.
+    std::vector<Input> inputs = {};
+
+    static bool reflect(const AssetSpan&, ShaderReflection*);
+    //SPIR-V can't say a buffer is bound with a dynamic offset, the caller marks the ones that are
+    void makeDynamic(uint32_t, uint32_t);
+    bool buildVertexInput(const std::vector<VertexStream>&, std::vector<VkVertexInputBindingDescription>*,
+        std::vector<VkVertexInputAttributeDescription>*) const;
+};
+
+//Descriptor set layouts and pipeline layouts built from the reflection of a pipeline's stages. Equal
+//layouts are created once and shared, so pipelines of the same shader interface stay compatible and
+//bound descriptor sets survive pipeline switches. Everything lives until destroy().
+class LayoutCache
+{
+    public:
+        struct Layout
+        {
+            VkPipelineLayout pipeline_layout = VK_NULL_HANDLE;
+            //One per set number up to the highest one used, unused numbers get an empty layout
+            std::vector<VkDescriptorSetLayout> set_layouts = {};
+            VkPushConstantRange push_constants = {};
+        };
+
+        struct Stats
+        {
+            uint64_t hits = 0;
+            uint32_t set_layouts = 0;
+            uint32_t pipeline_layouts = 0;
+        };
+
+        LayoutCache();
+        ~LayoutCache();
+
+        void init(VkDevice);
+        void destroy();
+
+        //Merges the stages' bindings and push constants, a binding declared differently by two stages fails.
+        //Sets with a layout in the last argument take that layout instead of a reflected one, for layouts
+        //reflection can't describe such as update after bind arrays.
+        bool getLayout(const std::vector<const ShaderReflection*>&, Layout*, const std::vector<VkDescriptorSetLayout>& = {});
+        void printStats() const;
+
+    private:
+        struct SetLayoutEntry
+        {
+            std::vector<uint32_t> key = {};
+            VkDescriptorSetLayout layout = VK_NULL_HANDLE;
+        };
+        struct PipelineLayoutEntry
+        {
+            std::vector<VkDescriptorSetLayout> set_layouts = {};
+            VkPushConstantRange push_constants = {};
+            VkPipelineLayout layout = VK_NULL_HANDLE;
+        };
+
+        bool getSetLayout(const std::vector<VkDescriptorSetLayoutBinding>&, VkDescriptorSetLayout*);
+
+        VkDevice device;
+        //Keyed by hash, the full key is compared too since a collision would hand out the wrong layout
+        std::unordered_multimap<uint64_t, SetLayoutEntry> set_layouts;
+        std::unordered_multimap<uint64_t, PipelineLayoutEntry> pipeline_layouts;
+        Stats stats;
+};
@@ -0,0 +1,521 @@
+#include "upload_manager.h"
+
+#include <iostream>
+#include <algorithm>
+#include <cstring>
+
+//Keeps copy source offsets friendly to every transfer engine
+static constexpr VkDeviceSize staging_alignment = 16;
+
+UploadManager::UploadManager()
+{
+    stats = {};
+    device = VK_NULL_HANDLE;
+    allocator = nullptr;
+    transfer_queue = VK_NULL_HANDLE;
+    transfer_family = 0;
+    graphics_family = 0;
+    command_pool = VK_NULL_HANDLE;
+    timeline_semaphore = VK_NULL_HANDLE;
+    timeline_value = 0;
+    staging_buffer = VK_NULL_HANDLE;
+    staging_allocation = {};
+    staging_size = 0;
+    head = 0;
+    tail = 0;
+    used = 0;
+    open_copies = {};
+    open_bytes = 0;
+    open_ring_bytes = 0;
+    in_flight = {};
+    free_batches = {};
+    last_completed_frame = 0;
+}
+
+bool UploadManager::init(VkDevice logical_device, DeviceAllocator* device_allocator, VkQueue queue,
+    uint32_t queue_family, uint32_t graphics_queue_family, VkDeviceSize ring_size, bool use_timeline)
+{
+    device = logical_device;
+    allocator = device_allocator;
+    transfer_queue = queue;
+    transfer_family = queue_family;
+    graphics_family = graphics_queue_family;
+    staging_size = ring_size;
+
+    VkCommandPoolCreateInfo pool_info = {};
+    pool_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    pool_info.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT | VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+    pool_info.queueFamilyIndex = transfer_family;
+    if(vkCreateCommandPool(device, &pool_info, nullptr, &command_pool) != VK_SUCCESS)
+    {
+        std::cout << "Failed to create transfer command pool!" << std::endl;
+        return false;
+    }
+
+    if(use_timeline)
+    {
+        VkSemaphoreTypeCreateInfo type_info = {};
+        type_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+        type_info.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+        type_info.initialValue = 0;
+        VkSemaphoreCreateInfo semaphore_info = {};
+        semaphore_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+        semaphore_info.pNext = &type_info;
+        if(vkCreateSemaphore(device, &semaphore_info, nullptr, &timeline_semaphore) != VK_SUCCESS)
+        {
+            std::cout << "Failed to create upload timeline semaphore!" << std::endl;
+            return false;
+        }
+    }
+
+    VkBufferCreateInfo buffer_info = {};
+    buffer_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    buffer_info.size = staging_size;
+    buffer_info.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+    buffer_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    if(!allocator->createBuffer(buffer_info, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+        0, &staging_buffer, &staging_allocation))
+    {
+        std::cout << "Failed to create staging buffer!" << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+void UploadManager::destroy()
+{
+    if(device == VK_NULL_HANDLE)
+    {
+        return;
+    }
+
+    for(auto& batch : in_flight)
+    {
+        vkWaitForFences(device, 1, &batch.fence, VK_TRUE, UINT64_MAX);
+        free_batches.push_back(batch);
+    }
+    in_flight.clear();
+    for(auto& batch : free_batches)
+    {
+        vkDestroyFence(device, batch.fence, nullptr);
+        if(batch.semaphore != VK_NULL_HANDLE)
+        {
+            vkDestroySemaphore(device, batch.semaphore, nullptr);
+        }
+    }
+    free_batches.clear();
+    if(timeline_semaphore != VK_NULL_HANDLE)
+    {
+        vkDestroySemaphore(device, timeline_semaphore, nullptr);
+        timeline_semaphore = VK_NULL_HANDLE;
+    }
+
+    //Frees the command buffers along with it
+    vkDestroyCommandPool(device, command_pool, nullptr);
+    if(staging_buffer != VK_NULL_HANDLE)
+    {
+        allocator->destroyBuffer(staging_buffer, staging_allocation);
+    }
+    device = VK_NULL_HANDLE;
+}
+
+bool UploadManager::reserve(VkDeviceSize size, VkDeviceSize* offset)
+{
+    if(used == 0)
+    {
+        head = 0;
+        tail = 0;
+    }
+
+    VkDeviceSize aligned = (head + staging_alignment - 1) & ~(staging_alignment - 1);
+    VkDeviceSize start = 0;
+    if(used == 0 || head > tail)
+    {
+        //Free space is [head, end) followed by [0, tail)
+        if(aligned + size <= staging_size)
+        {
+            start = aligned;
+        }
+        else if(size <= tail)
+        {
+            start = 0;
+        }
+        else
+        {
+            return false;
+        }
+    }
+    else if(head < tail && aligned + size <= tail)
+    {
+        start = aligned;
+    }
+    else
+    {
+        return false;
+    }
+
+    //Padding and the skipped end of the ring count as used until the batch retires
+    VkDeviceSize new_head = start + size;
+    VkDeviceSize consumed = start >= head ? new_head - head : (staging_size - head) + new_head;
+    used += consumed;
+    open_ring_bytes += consumed;
+    head = new_head;
+    *offset = start;
+    return true;
+}
+
+bool UploadManager::uploadBuffer(VkBuffer dst, VkDeviceSize dst_offset, const void* data, VkDeviceSize size,
+    VkPipelineStageFlags dst_stage, VkAccessFlags dst_access, bool shared)
+{
+    const char* bytes = static_cast<const char*>(data);
+    VkDeviceSize done = 0;
+    while(done < size)
+    {
+        //Anything bigger than the ring goes through in ring sized pieces
+        VkDeviceSize chunk = std::min(size - done, staging_size);
+        VkDeviceSize offset = 0;
+        while(!reserve(chunk, &offset))
+        {
+            if(!open_copies.empty() && !flush())
+            {
+                return false;
+            }
+            if(!waitForOldestBatch())
+            {
+                std::cout << "Failed to reserve staging memory!" << std::endl;
+                return false;
+            }
+            stats.stalls++;
+        }
+
+        memcpy(static_cast<char*>(staging_allocation.mapped) + offset, bytes + done, chunk);
+
+        PendingCopy copy = {};
+        copy.dst = dst;
+        copy.region.srcOffset = offset;
+        copy.region.dstOffset = dst_offset + done;
+        copy.region.size = chunk;
+        copy.dst_stage = dst_stage;
+        copy.dst_access = dst_access;
+        copy.shared = shared;
+        open_copies.push_back(copy);
+        open_bytes += chunk;
+        done += chunk;
+    }
+
+    return true;
+}
+
+bool UploadManager::newBatch(Batch* batch_out)
+{
+    Batch& batch = *batch_out;
+    if(!free_batches.empty())
+    {
+        batch = free_batches.back();
+        free_batches.pop_back();
+        vkResetFences(device, 1, &batch.fence);
+        vkResetCommandBuffer(batch.command_buffer, 0);
+    }
+    else
+    {
+        VkCommandBufferAllocateInfo alloc_info = {};
+        alloc_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        alloc_info.commandPool = command_pool;
+        alloc_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        alloc_info.commandBufferCount = 1;
+
+        VkFenceCreateInfo fence_info = {};
+        fence_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+
+        VkSemaphoreCreateInfo semaphore_info = {};
+        semaphore_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+        if(vkAllocateCommandBuffers(device, &alloc_info, &batch.command_buffer) != VK_SUCCESS
+            || vkCreateFence(device, &fence_info, nullptr, &batch.fence) != VK_SUCCESS)
+        {
+            std::cout << "Failed to create upload batch!" << std::endl;
+            return false;
+        }
+        //Only a separate queue family needs the graphics queue to wait on the copies
+        if(transfer_family != graphics_family && timeline_semaphore == VK_NULL_HANDLE
+            && vkCreateSemaphore(device, &semaphore_info, nullptr, &batch.semaphore) != VK_SUCCESS)
+        {
+            std::cout << "Failed to create upload semaphore!" << std::endl;
+            return false;
+        }
+    }
+
+    batch.copies.clear();
+    batch.bytes = 0;
+    batch.ring_end = 0;
+    batch.ring_bytes = 0;
+    batch.acquired = false;
+    batch.acquire_frame = 0;
+    batch.timeline_value = 0;
+    batch.transfer_done = false;
+    return true;
+}
+
+bool UploadManager::flush()
+{
+    if(open_copies.empty())
+    {
+        return true;
+    }
+
+    //Only tracked once submitted, a batch that fails to record goes back to the free list
+    Batch batch = {};
+    if(!newBatch(&batch))
+    {
+        return false;
+    }
+
+    VkCommandBufferBeginInfo begin_info = {};
+    begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    if(vkBeginCommandBuffer(batch.command_buffer, &begin_info) != VK_SUCCESS)
+    {
+        std::cout << "Failed to begin recording upload command buffer!" << std::endl;
+        free_batches.push_back(batch);
+        return false;
+    }
+
+    for(const auto& copy : open_copies)
+    {
+        vkCmdCopyBuffer(batch.command_buffer, staging_buffer, copy.dst, 1, &copy.region);
+    }
+
+    //Release half of the queue family ownership transfer, the graphics queue acquires it
+    if(transfer_family != graphics_family)
+    {
+        std::vector<VkBufferMemoryBarrier> barriers = {};
+        for(const auto& copy : open_copies)
+        {
+            if(copy.shared)
+            {
+                continue;
+            }
+            VkBufferMemoryBarrier barrier = {};
+            barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+            barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            barrier.dstAccessMask = 0;
+            barrier.srcQueueFamilyIndex = transfer_family;
+            barrier.dstQueueFamilyIndex = graphics_family;
+            barrier.buffer = copy.dst;
+            barrier.offset = copy.region.dstOffset;
+            barrier.size = copy.region.size;
+            barriers.push_back(barrier);
+        }
+        if(!barriers.empty())
+        {
+            vkCmdPipelineBarrier(batch.command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                0, 0, nullptr, static_cast<uint32_t>(barriers.size()), barriers.data(), 0, nullptr);
+        }
+    }
+
+    if(vkEndCommandBuffer(batch.command_buffer) != VK_SUCCESS)
+    {
+        std::cout << "Failed to record upload command buffer!" << std::endl;
+        free_batches.push_back(batch);
+        return false;
+    }
+
+    VkSubmitInfo submit_info = {};
+    submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submit_info.commandBufferCount = 1;
+    submit_info.pCommandBuffers = &batch.command_buffer;
+    submit_info.signalSemaphoreCount = batch.semaphore != VK_NULL_HANDLE ? 1 : 0;
+    submit_info.pSignalSemaphores = &batch.semaphore;
+    VkTimelineSemaphoreSubmitInfo timeline_info = {};
+    uint64_t signal_value = timeline_value + 1;
+    if(timeline_semaphore != VK_NULL_HANDLE)
+    {
+        timeline_info.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+        timeline_info.signalSemaphoreValueCount = 1;
+        timeline_info.pSignalSemaphoreValues = &signal_value;
+        submit_info.pNext = &timeline_info;
+        submit_info.signalSemaphoreCount = 1;
+        submit_info.pSignalSemaphores = &timeline_semaphore;
+    }
+    if(vkQueueSubmit(transfer_queue, 1, &submit_info, batch.fence) != VK_SUCCESS)
+    {
+        std::cout << "Failed to submit upload command buffer!" << std::endl;
+        free_batches.push_back(batch);
+        return false;
+    }
+
+    if(timeline_semaphore != VK_NULL_HANDLE)
+    {
+        timeline_value = signal_value;
+        batch.timeline_value = signal_value;
+    }
+    batch.submit_time = std::chrono::steady_clock::now();
+    batch.copies = std::move(open_copies);
+    batch.bytes = open_bytes;
+    batch.ring_end = head;
+    batch.ring_bytes = open_ring_bytes;
+    open_copies = {};
+    open_bytes = 0;
+    open_ring_bytes = 0;
+    in_flight.push_back(std::move(batch));
+    stats.batches++;
+
+    return true;
+}
+
+bool UploadManager::recordAcquireBarriers(VkCommandBuffer command_buffer, uint64_t frame_index,
+    std::vector<VkSemaphore>& wait_semaphores, std::vector<VkPipelineStageFlags>& wait_stages,
+    std::vector<uint64_t>& wait_values)
+{
+    //Anything queued since the last frame goes out now, ahead of the graphics submission
+    if(!flush())
+    {
+        return false;
+    }
+
+    bool ownership_transfer = transfer_family != graphics_family;
+    std::vector<VkBufferMemoryBarrier> barriers = {};
+    VkPipelineStageFlags dst_stages = 0;
+    //A timeline wait on the newest batch covers every older one
+    uint64_t timeline_wait = 0;
+    VkPipelineStageFlags timeline_stages = 0;
+    for(auto& batch : in_flight)
+    {
+        if(batch.acquired)
+        {
+            continue;
+        }
+
+        VkPipelineStageFlags batch_stages = 0;
+        for(const auto& copy : batch.copies)
+        {
+            VkBufferMemoryBarrier barrier = {};
+            barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+            barrier.srcAccessMask = ownership_transfer ? 0 : VK_ACCESS_TRANSFER_WRITE_BIT;
+            barrier.dstAccessMask = copy.dst_access;
+            barrier.srcQueueFamilyIndex = ownership_transfer && !copy.shared ? transfer_family : VK_QUEUE_FAMILY_IGNORED;
+            barrier.dstQueueFamilyIndex = ownership_transfer && !copy.shared ? graphics_family : VK_QUEUE_FAMILY_IGNORED;
+            barrier.buffer = copy.dst;
+            barrier.offset = copy.region.dstOffset;
+            barrier.size = copy.region.size;
+            barriers.push_back(barrier);
+            batch_stages |= copy.dst_stage;
+        }
+        dst_stages |= batch_stages;
+
+        if(batch.semaphore != VK_NULL_HANDLE)
+        {
+            wait_semaphores.push_back(batch.semaphore);
+            wait_stages.push_back(batch_stages);
+            wait_values.push_back(0);
+        }
+        if(ownership_transfer && batch.timeline_value != 0)
+        {
+            timeline_wait = std::max(timeline_wait, batch.timeline_value);
+            timeline_stages |= batch_stages;
+        }
+        batch.acquired = true;
+        batch.acquire_frame = frame_index;
+    }
+
+    if(timeline_wait != 0)
+    {
+        wait_semaphores.push_back(timeline_semaphore);
+        wait_stages.push_back(timeline_stages);
+        wait_values.push_back(timeline_wait);
+    }
+
+    if(barriers.empty())
+    {
+        return true;
+    }
+
+    //With an ownership transfer the semaphore wait already orders the copies, the barrier only
+    //has to chain onto it. On a shared queue the copies were submitted earlier on the same queue.
+    VkPipelineStageFlags src_stages = VK_PIPELINE_STAGE_TRANSFER_BIT;
+    if(ownership_transfer)
+    {
+        src_stages = dst_stages;
+    }
+    vkCmdPipelineBarrier(command_buffer, src_stages, dst_stages, 0, 0, nullptr,
+        static_cast<uint32_t>(barriers.size()), barriers.data(), 0, nullptr);
+    return true;
+}
+
+VkSemaphore UploadManager::timelineSemaphore() const
+{
+    return timeline_semaphore;
+}
+
+uint64_t UploadManager::submittedValue() const
+{
+    return timeline_value;
+}
+
+bool UploadManager::waitForOldestBatch()
+{
+    for(auto& batch : in_flight)
+    {
+        if(!batch.transfer_done)
+        {
+            vkWaitForFences(device, 1, &batch.fence, VK_TRUE, UINT64_MAX);
+            retireBatches(last_completed_frame);
+            return true;
+        }
+    }
+    return false;
+}
+
+void UploadManager::collect(uint64_t completed_frame)
+{
+    last_completed_frame = completed_frame;
+    retireBatches(completed_frame);
+}
+
+void UploadManager::retireBatches(uint64_t completed_frame)
+{
+    //Transfers finish in submission order, so ring space is handed back from the tail
+    for(auto& batch : in_flight)
+    {
+        if(batch.transfer_done)
+        {
+            continue;
+        }
+        if(vkGetFenceStatus(device, batch.fence) != VK_SUCCESS)
+        {
+            break;
+        }
+        batch.transfer_done = true;
+        tail = batch.ring_end;
+        used -= batch.ring_bytes;
+        stats.bytes_uploaded += batch.bytes;
+        stats.transfer_seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - batch.submit_time).count();
+    }
+
+    //The semaphore can only be signaled again once the frame that waited on it has finished
+    for(auto it = in_flight.begin(); it != in_flight.end();)
+    {
+        //Timeline batches own no semaphore of their own
+        bool semaphore_free = it->semaphore == VK_NULL_HANDLE || it->acquire_frame <= completed_frame;
+        if(it->transfer_done && it->acquired && semaphore_free)
+        {
+            free_batches.push_back(*it);
+            it = in_flight.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+}
+
+void UploadManager::printStats() const
+{
+    //Time is measured from submission until the fence is seen signaled, so this is a lower bound
+    double bandwidth = stats.transfer_seconds > 0.0 ? stats.bytes_uploaded / stats.transfer_seconds / (1024.0 * 1024.0) : 0.0;
+    std::cout << "Uploads (" << (transfer_family != graphics_family ? "dedicated transfer queue" : "graphics queue") << "): "
+        << stats.bytes_uploaded / 1024 << " KiB in " << stats.batches << " batches, "
+        << bandwidth << " MiB/s, " << stats.stalls << " staging stalls, "
+        << staging_size / 1024 << " KiB staging ring" << std::endl;
+}
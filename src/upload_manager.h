@@ -0,0 +1,107 @@
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <chrono>
+#include <cstdint>
+#include <vulkan/vulkan.h>
+#include "memory_allocator.h"
+
+//Streams data into device local buffers through a host visible staging ring. Copies are recorded and
+//submitted on the transfer queue, so big uploads don't occupy the graphics queue. When the transfer
+//queue belongs to a different family, ownership is released on the transfer side and acquired in the
+//next graphics command buffer, which also waits on the batch's semaphore. With timeline semaphores every
+//batch signals the next value of one semaphore, so any number of queues can wait on the same upload.
+class UploadManager
+{
+    public:
+        struct Stats
+        {
+            uint64_t bytes_uploaded = 0;
+            uint64_t batches = 0;
+            double transfer_seconds = 0.0;
+            //Uploads that had to wait for the ring to drain
+            uint64_t stalls = 0;
+        };
+
+        UploadManager();
+
+        bool init(VkDevice, DeviceAllocator*, VkQueue, uint32_t, uint32_t, VkDeviceSize, bool);
+        void destroy();
+
+        //Queue a copy into dst. dst_stage/dst_access describe the first use on the graphics queue. Buffers
+        //created with VK_SHARING_MODE_CONCURRENT are marked shared and skip the ownership transfer.
+        bool uploadBuffer(VkBuffer, VkDeviceSize, const void*, VkDeviceSize, VkPipelineStageFlags, VkAccessFlags, bool);
+        //Submit everything queued so far on the transfer queue
+        bool flush();
+        //Record the graphics side of finished transfers into a command buffer that will be submitted as
+        //frame frame_index; the returned semaphores must be waited on by that submission. Values are
+        //timeline values, 0 for binary semaphores. Fails if what was still queued couldn't be submitted.
+        bool recordAcquireBarriers(VkCommandBuffer, uint64_t, std::vector<VkSemaphore>&, std::vector<VkPipelineStageFlags>&,
+            std::vector<uint64_t>&);
+        //Timeline semaphore and the value of the last submitted batch, for other queues reading shared buffers
+        VkSemaphore timelineSemaphore() const;
+        uint64_t submittedValue() const;
+        //Reclaim staging space and batches whose copies and graphics acquires have completed
+        void collect(uint64_t);
+
+        void printStats() const;
+        Stats stats;
+
+    private:
+        struct PendingCopy
+        {
+            VkBuffer dst = VK_NULL_HANDLE;
+            VkBufferCopy region = {};
+            VkPipelineStageFlags dst_stage = 0;
+            VkAccessFlags dst_access = 0;
+            bool shared = false;
+        };
+        struct Batch
+        {
+            VkCommandBuffer command_buffer = VK_NULL_HANDLE;
+            VkFence fence = VK_NULL_HANDLE;
+            VkSemaphore semaphore = VK_NULL_HANDLE;
+            uint64_t timeline_value = 0;
+            std::vector<PendingCopy> copies = {};
+            //Staging ring range used by the batch
+            VkDeviceSize ring_end = 0;
+            VkDeviceSize ring_bytes = 0;
+            uint64_t bytes = 0;
+            std::chrono::steady_clock::time_point submit_time = {};
+            bool acquired = false;
+            //Graphics frame whose submission waits on the semaphore, 0 if not yet recorded
+            uint64_t acquire_frame = 0;
+            bool transfer_done = false;
+        };
+
+        bool reserve(VkDeviceSize, VkDeviceSize*);
+        bool waitForOldestBatch();
+        bool newBatch(Batch*);
+        void retireBatches(uint64_t);
+
+        VkDevice device;
+        DeviceAllocator* allocator;
+        VkQueue transfer_queue;
+        uint32_t transfer_family;
+        uint32_t graphics_family;
+        VkCommandPool command_pool;
+        //Replaces the per batch semaphores when the device supports timeline semaphores
+        VkSemaphore timeline_semaphore;
+        uint64_t timeline_value;
+
+        VkBuffer staging_buffer;
+        MemoryAllocation staging_allocation;
+        VkDeviceSize staging_size;
+        //Ring space between tail and head is owned by submitted batches
+        VkDeviceSize head;
+        VkDeviceSize tail;
+        VkDeviceSize used;
+
+        std::vector<PendingCopy> open_copies;
+        uint64_t open_bytes;
+        VkDeviceSize open_ring_bytes;
+        std::deque<Batch> in_flight;
+        std::vector<Batch> free_batches;
+        uint64_t last_completed_frame;
+};
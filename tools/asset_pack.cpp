@@ -0,0 +1,220 @@
+#include "asset_loader.h"
+
+#include <iostream>
+#include <fstream>
+#include <iterator>
+#include <algorithm>
+#include <chrono>
+#include <vector>
+#include <string>
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+
+//Packs assets into the archive AssetLoader mounts, and times loading them the old way (ifstream into a
+//vector), as mapped loose files and from the archive.
+//  asset-pack pack ARCHIVE FILE...
+//  asset-pack bench ARCHIVE [ITERATIONS] FILE...
+//Files are stored under the path given on the command line, so run it from where the renderer runs.
+
+static bool packArchive(const std::string& archive_path, std::vector<std::string> names)
+{
+    std::sort(names.begin(), names.end());
+    names.erase(std::unique(names.begin(), names.end()), names.end());
+
+    std::string temp_path = archive_path + ".tmp";
+    std::ofstream archive(temp_path, std::ios::binary | std::ios::trunc);
+    if(!archive.is_open())
+    {
+        std::cout << "Failed to create " << temp_path << "!" << std::endl;
+        return false;
+    }
+
+    //The header is written last, once the table of contents has a place
+    AssetLoader::ArchiveHeader header = {};
+    archive.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    uint64_t offset = sizeof(header);
+    auto pad = [&archive, &offset]()
+    {
+        static const char zeros[AssetLoader::archive_alignment] = {};
+        uint64_t padding = (AssetLoader::archive_alignment - offset % AssetLoader::archive_alignment) % AssetLoader::archive_alignment;
+        archive.write(zeros, static_cast<std::streamsize>(padding));
+        offset += padding;
+    };
+
+    std::vector<AssetLoader::ArchiveEntry> entries = {};
+    for(const auto& name : names)
+    {
+        AssetLoader::ArchiveEntry entry = {};
+        if(name.size() >= sizeof(entry.name))
+        {
+            std::cout << "Asset name " << name << " is longer than " << sizeof(entry.name) - 1 << " characters!" << std::endl;
+            return false;
+        }
+        std::ifstream file(name, std::ios::binary);
+        if(!file.is_open())
+        {
+            std::cout << "Failed to open file: " << name << std::endl;
+            return false;
+        }
+        std::vector<char> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+        pad();
+        memcpy(entry.name, name.c_str(), name.size());
+        entry.offset = offset;
+        entry.size = data.size();
+        entries.push_back(entry);
+        archive.write(data.data(), static_cast<std::streamsize>(data.size()));
+        offset += data.size();
+    }
+
+    pad();
+    memcpy(header.magic, "VKPK", 4);
+    header.version = AssetLoader::archive_version;
+    header.entry_count = static_cast<uint32_t>(entries.size());
+    header.toc_offset = offset;
+    archive.write(reinterpret_cast<const char*>(entries.data()), static_cast<std::streamsize>(entries.size() * sizeof(entries[0])));
+    archive.seekp(0);
+    archive.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    archive.close();
+    if(archive.fail())
+    {
+        std::cout << "Failed to write " << temp_path << "!" << std::endl;
+        return false;
+    }
+
+    //Replace the old archive in one step, a renderer starting meanwhile never mounts half of one
+    if(std::rename(temp_path.c_str(), archive_path.c_str()) != 0)
+    {
+        std::cout << "Failed to replace " << archive_path << "!" << std::endl;
+        return false;
+    }
+    std::cout << "Packed " << entries.size() << " assets into " << archive_path << " (" << offset + entries.size() * sizeof(entries[0])
+        << " bytes)" << std::endl;
+    return true;
+}
+
+//Every byte is read so the mapped paths pay for their page faults like the copy pays for its reads
+static uint64_t touchBytes(const char* data, size_t size)
+{
+    uint64_t sum = 0;
+    for(size_t i = 0; i < size; i++)
+    {
+        sum += static_cast<unsigned char>(data[i]);
+    }
+    return sum;
+}
+
+static bool benchArchive(const std::string& archive_path, uint32_t iterations, const std::vector<std::string>& names)
+{
+    enum class Method
+    {
+        Stream,
+        Loose,
+        Archive
+    };
+    const Method methods[] = {Method::Stream, Method::Loose, Method::Archive};
+    const char* method_names[] = {"ifstream copy", "mapped loose files", "mapped archive"};
+
+    uint64_t total_bytes = 0;
+    uint64_t expected_sum = 0;
+    for(uint32_t m = 0; m < 3; m++)
+    {
+        std::vector<double> times = {};
+        for(uint32_t iteration = 0; iteration < iterations; iteration++)
+        {
+            uint64_t sum = 0;
+            uint64_t bytes = 0;
+            auto start = std::chrono::steady_clock::now();
+            //A new loader each time, mounting and mapping are part of the cost
+            AssetLoader assets;
+            if(methods[m] == Method::Archive && !assets.mountArchive(archive_path))
+            {
+                return false;
+            }
+            for(const auto& name : names)
+            {
+                if(methods[m] == Method::Stream)
+                {
+                    std::ifstream file(name, std::ios::ate | std::ios::binary);
+                    if(!file.is_open())
+                    {
+                        std::cout << "Failed to open file: " << name << std::endl;
+                        return false;
+                    }
+                    std::vector<char> buffer((size_t) file.tellg());
+                    file.seekg(0);
+                    file.read(buffer.data(), buffer.size());
+                    sum += touchBytes(buffer.data(), buffer.size());
+                    bytes += buffer.size();
+                }
+                else
+                {
+                    AssetSpan span = {};
+                    if(!assets.load(name, &span))
+                    {
+                        return false;
+                    }
+                    if(methods[m] == Method::Archive && assets.stats.loose_loads != 0)
+                    {
+                        std::cout << name << " is not in " << archive_path << "!" << std::endl;
+                        return false;
+                    }
+                    sum += touchBytes(span.data, span.size);
+                    bytes += span.size;
+                }
+            }
+            assets.destroy();
+            times.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+
+            if(m == 0 && iteration == 0)
+            {
+                expected_sum = sum;
+                total_bytes = bytes;
+            }
+            else if(sum != expected_sum)
+            {
+                std::cout << method_names[m] << " loaded different bytes, rebuild the archive!" << std::endl;
+                return false;
+            }
+        }
+
+        std::sort(times.begin(), times.end());
+        std::cout << method_names[m] << ": median " << times[times.size() / 2] << " ms, min " << times.front()
+            << " ms, max " << times.back() << " ms" << std::endl;
+    }
+    std::cout << names.size() << " assets, " << total_bytes << " bytes, " << iterations
+        << " iterations. Files are in the page cache after the first load, drop it to time cold loads" << std::endl;
+    return true;
+}
+
+int main(int argc, char** argv)
+{
+    if(argc < 4 || (strcmp(argv[1], "pack") != 0 && strcmp(argv[1], "bench") != 0))
+    {
+        std::cout << "Usage: asset-pack pack ARCHIVE FILE...\n       asset-pack bench ARCHIVE [ITERATIONS] FILE..." << std::endl;
+        return 1;
+    }
+
+    std::string archive_path = argv[2];
+    int first_file = 3;
+    if(strcmp(argv[1], "pack") == 0)
+    {
+        return packArchive(archive_path, std::vector<std::string>(argv + first_file, argv + argc)) ? 0 : 1;
+    }
+
+    uint32_t iterations = 20;
+    char* end = nullptr;
+    long parsed = strtol(argv[first_file], &end, 10);
+    if(end != argv[first_file] && *end == '\0')
+    {
+        iterations = static_cast<uint32_t>(std::max(parsed, 1L));
+        first_file++;
+    }
+    if(first_file >= argc)
+    {
+        std::cout << "Nothing to benchmark, list the files to load" << std::endl;
+        return 1;
+    }
+    return benchArchive(archive_path, iterations, std::vector<std::string>(argv + first_file, argv + argc)) ? 0 : 1;
+}
@@ -0,0 +1,334 @@
+#define SDL_MAIN_HANDLED
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <string>
+#include <cstring>
+#include <cstdint>
+#include <cstdlib>
+#include <algorithm>
+#include <chrono>
+#include "renderer.h"
+#include "frame_trace.h"
+
+//Scripted workloads, each scaling one thing against the default scene. Always rendered headless so the
+//same scenes run on a machine without a display and on a software ICD such as lavapipe.
+struct Scene
+{
+    const char* name;
+    uint32_t object_count;
+    uint32_t instances_per_draw;
+    DrawPath draw_path;
+    uint32_t pipeline_variants;
+    int width;
+    int height;
+};
+
+static const Scene scenes[] = {
+    {"baseline", 1000, 256, DrawPath::Indirect, 1, 1280, 720},
+    {"triangles", 100000, 256, DrawPath::Indirect, 1, 1280, 720},
+    {"draws", 10000, 1, DrawPath::PerObject, 1, 1280, 720},
+    //The objects of "draws" batched into a few multi draws, the two differ only in draw call count
+    {"instances", 10000, 4096, DrawPath::MultiIndirect, 1, 1280, 720},
+    {"pipelines", 10000, 256, DrawPath::Indirect, 16, 1280, 720},
+    {"resolution", 1000, 256, DrawPath::Indirect, 1, 3840, 2160},
+};
+
+struct SceneResult
+{
+    std::string name = {};
+    uint64_t frames = 0;
+    double fps = 0.0;
+    double cpu_ms = 0.0;
+    double gpu_ms = 0.0;
+    //Device memory the allocator got from the driver, and how much of it is in use
+    uint64_t memory_bytes = 0;
+    uint64_t memory_used_bytes = 0;
+};
+
+static bool runScene(const Scene& scene, uint32_t warmup_frames, uint32_t measured_frames, SceneResult* result,
+    std::string* device_name)
+{
+    Renderer renderer;
+    renderer.headless = true;
+    renderer.object_count = scene.object_count;
+    renderer.instances_per_draw = scene.instances_per_draw;
+    renderer.draw_path = scene.draw_path;
+    renderer.pipeline_variant_count = scene.pipeline_variants;
+    renderer.window_width = scene.width;
+    renderer.window_height = scene.height;
+    if(!renderer.initVulkan())
+    {
+        return false;
+    }
+    //Variants compile in the background and draw with the fallback until they are done, which would make
+    //the measured frames depend on how fast the compile threads were
+    for(size_t i = 0; i < renderer.pipeline_variants.size(); i++)
+    {
+        if(renderer.pso_cache.getBlocking(renderer.pipeline_variants[i], renderer.pipeline_variant_hashes[i]) == VK_NULL_HANDLE)
+        {
+            std::cout << "Failed to compile pipeline variant " << i << " of scene " << scene.name << "!" << std::endl;
+            return false;
+        }
+    }
+
+    VkPhysicalDeviceProperties properties = {};
+    vkGetPhysicalDeviceProperties(renderer.physical_device, &properties);
+    *device_name = properties.deviceName;
+
+    double cpu_ms = 0.0;
+    auto start = std::chrono::steady_clock::now();
+    for(uint32_t frame = 0; frame < warmup_frames + measured_frames; frame++)
+    {
+        if(frame == warmup_frames)
+        {
+            //GPU times cover the same frames as the CPU times
+            renderer.gpu_profiler.resetStats();
+            start = std::chrono::steady_clock::now();
+        }
+        if(!renderer.drawFrame())
+        {
+            std::cout << "Failed to draw frame " << frame << " of scene " << scene.name << "!" << std::endl;
+            vkDeviceWaitIdle(renderer.device);
+            return false;
+        }
+        FrameTrace::get().endFrame();
+        if(frame >= warmup_frames)
+        {
+            cpu_ms += FrameTrace::get().lastFrame().cpu_ms;
+        }
+    }
+    vkDeviceWaitIdle(renderer.device);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    result->name = scene.name;
+    result->frames = measured_frames;
+    result->fps = seconds > 0.0 ? measured_frames / seconds : 0.0;
+    result->cpu_ms = cpu_ms / measured_frames;
+
+    for(const auto& stats : renderer.gpu_profiler.getStats())
+    {
+        if(stats.name == "frame")
+        {
+            result->gpu_ms = stats.avg_ms;
+        }
+    }
+    for(const auto& heap : renderer.allocator.getHeapStats())
+    {
+        result->memory_bytes += heap.block_bytes;
+        result->memory_used_bytes += heap.used_bytes;
+    }
+    return true;
+}
+
+//One scene per line, so the baseline can be read back without a JSON library
+static bool writeResults(const std::string& path, const std::string& device_name, const std::vector<SceneResult>& results)
+{
+    std::ofstream file(path);
+    if(!file.is_open())
+    {
+        std::cout << "Failed to open " << path << "!" << std::endl;
+        return false;
+    }
+    file << "{\n  \"device\": \"" << device_name << "\",\n  \"scenes\": [\n";
+    for(size_t i = 0; i < results.size(); i++)
+    {
+        const SceneResult& result = results[i];
+        file << "    {\"name\": \"" << result.name << "\", \"frames\": " << result.frames << ", \"fps\": " << result.fps
+            << ", \"cpu_ms\": " << result.cpu_ms << ", \"gpu_ms\": " << result.gpu_ms << ", \"memory_bytes\": "
+            << result.memory_bytes << ", \"memory_used_bytes\": " << result.memory_used_bytes << "}"
+            << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    file << "  ]\n}\n";
+    return true;
+}
+
+static bool readNumber(const std::string& line, const char* key, double* value)
+{
+    std::string pattern = std::string("\"") + key + "\": ";
+    size_t position = line.find(pattern);
+    if(position == std::string::npos)
+    {
+        return false;
+    }
+    *value = strtod(line.c_str() + position + pattern.size(), nullptr);
+    return true;
+}
+
+//Reads back what writeResults wrote
+static bool readResults(const std::string& path, std::string* device_name, std::vector<SceneResult>* results)
+{
+    std::ifstream file(path);
+    if(!file.is_open())
+    {
+        std::cout << "Failed to open " << path << "!" << std::endl;
+        return false;
+    }
+    std::string line;
+    while(std::getline(file, line))
+    {
+        const std::string device_key = "\"device\": \"";
+        size_t device_start = line.find(device_key);
+        if(device_start != std::string::npos)
+        {
+            device_start += device_key.size();
+            size_t device_end = line.find('"', device_start);
+            if(device_end != std::string::npos)
+            {
+                *device_name = line.substr(device_start, device_end - device_start);
+            }
+            continue;
+        }
+
+        const std::string name_key = "{\"name\": \"";
+        size_t name_start = line.find(name_key);
+        if(name_start == std::string::npos)
+        {
+            continue;
+        }
+        name_start += name_key.size();
+        size_t name_end = line.find('"', name_start);
+        if(name_end == std::string::npos)
+        {
+            continue;
+        }
+
+        SceneResult result = {};
+        result.name = line.substr(name_start, name_end - name_start);
+        double frames = 0.0;
+        double memory_bytes = 0.0;
+        double memory_used_bytes = 0.0;
+        readNumber(line, "frames", &frames);
+        readNumber(line, "fps", &result.fps);
+        readNumber(line, "cpu_ms", &result.cpu_ms);
+        readNumber(line, "gpu_ms", &result.gpu_ms);
+        readNumber(line, "memory_bytes", &memory_bytes);
+        readNumber(line, "memory_used_bytes", &memory_used_bytes);
+        result.frames = static_cast<uint64_t>(frames);
+        result.memory_bytes = static_cast<uint64_t>(memory_bytes);
+        result.memory_used_bytes = static_cast<uint64_t>(memory_used_bytes);
+        results->push_back(result);
+    }
+    return true;
+}
+
+//Prints every metric that got worse by more than the threshold, a fraction of the baseline value, and
+//returns how many did
+static uint32_t compareResults(const std::vector<SceneResult>& baseline, const std::vector<SceneResult>& results, double threshold)
+{
+    uint32_t regressions = 0;
+    auto check = [&](const std::string& scene, const char* metric, double before, double after, bool higher_is_better)
+    {
+        if(before <= 0.0)
+        {
+            return;
+        }
+        double change = (after - before) / before;
+        bool regressed = higher_is_better ? change < -threshold : change > threshold;
+        std::cout << "  " << scene << " " << metric << ": " << before << " -> " << after << " (" << (change >= 0.0 ? "+" : "")
+            << change * 100.0 << "%)" << (regressed ? " REGRESSION" : "") << std::endl;
+        regressions += regressed ? 1 : 0;
+    };
+
+    std::cout << "Compared against baseline, threshold " << threshold * 100.0 << "%" << std::endl;
+    for(const auto& result : results)
+    {
+        auto before = std::find_if(baseline.begin(), baseline.end(), [&result](const SceneResult& b) { return b.name == result.name; });
+        if(before == baseline.end())
+        {
+            std::cout << "  " << result.name << ": not in the baseline" << std::endl;
+            continue;
+        }
+        check(result.name, "fps", before->fps, result.fps, true);
+        check(result.name, "cpu ms", before->cpu_ms, result.cpu_ms, false);
+        check(result.name, "gpu ms", before->gpu_ms, result.gpu_ms, false);
+        check(result.name, "memory", static_cast<double>(before->memory_bytes), static_cast<double>(result.memory_bytes), false);
+    }
+    return regressions;
+}
+
+int main(int argc, char* argv[])
+{
+    uint32_t warmup_frames = 20;
+    uint32_t measured_frames = 200;
+    std::string output_path = {};
+    std::string baseline_path = {};
+    double threshold = 0.05;
+    std::vector<std::string> scene_filter = {};
+    for(int i = 1; i < argc; i++)
+    {
+        if(strcmp(argv[i], "--frames") == 0 && i + 1 < argc)
+        {
+            measured_frames = static_cast<uint32_t>(std::max(atoi(argv[++i]), 1));
+        }
+        else if(strcmp(argv[i], "--warmup") == 0 && i + 1 < argc)
+        {
+            warmup_frames = static_cast<uint32_t>(std::max(atoi(argv[++i]), 0));
+        }
+        else if(strcmp(argv[i], "--scene") == 0 && i + 1 < argc)
+        {
+            scene_filter.push_back(argv[++i]);
+        }
+        else if(strcmp(argv[i], "--output") == 0 && i + 1 < argc)
+        {
+            output_path = argv[++i];
+        }
+        else if(strcmp(argv[i], "--baseline") == 0 && i + 1 < argc)
+        {
+            baseline_path = argv[++i];
+        }
+        else if(strcmp(argv[i], "--threshold") == 0 && i + 1 < argc)
+        {
+            threshold = std::max(atof(argv[++i]), 0.0);
+        }
+    }
+
+    std::string device_name = {};
+    std::vector<SceneResult> results = {};
+    std::cout << "scene, objects, instances/draw, pipelines, resolution, fps, cpu ms/frame, gpu ms/frame, device memory MiB" << std::endl;
+    for(const Scene& scene : scenes)
+    {
+        if(!scene_filter.empty() && std::find(scene_filter.begin(), scene_filter.end(), scene.name) == scene_filter.end())
+        {
+            continue;
+        }
+        SceneResult result = {};
+        if(!runScene(scene, warmup_frames, measured_frames, &result, &device_name))
+        {
+            return 1;
+        }
+        std::cout << scene.name << ", " << scene.object_count << ", " << scene.instances_per_draw << ", " << scene.pipeline_variants
+            << ", " << scene.width << "x" << scene.height << ", " << result.fps << ", " << result.cpu_ms << ", " << result.gpu_ms
+            << ", " << result.memory_bytes / (1024.0 * 1024.0) << std::endl;
+        results.push_back(result);
+    }
+
+    if(!output_path.empty() && !writeResults(output_path, device_name, results))
+    {
+        return 1;
+    }
+    if(!baseline_path.empty())
+    {
+        std::string baseline_device = {};
+        std::vector<SceneResult> baseline = {};
+        if(!readResults(baseline_path, &baseline_device, &baseline))
+        {
+            return 1;
+        }
+        //Numbers from another GPU say nothing about a regression
+        if(baseline_device != device_name)
+        {
+            std::cout << "Baseline was recorded on \"" << baseline_device << "\", not \"" << device_name << "\"!" << std::endl;
+            return 1;
+        }
+        uint32_t regressions = compareResults(baseline, results, threshold);
+        if(regressions != 0)
+        {
+            std::cout << regressions << " metrics regressed" << std::endl;
+            return 1;
+        }
+    }
+    return 0;
+}